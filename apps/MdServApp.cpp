@@ -21,6 +21,7 @@
 #include "ft/core/Instrument.hpp"
 #include "ft/core/InstrumentsCache.hpp"
 #include "ft/core/BestPriceCache.hpp"
+#include "ft/core/Checkpoint.hpp"
 #include "ft/core/Client.hpp"
 #include "ft/core/Server.hpp"
 #include "ft/core/Parameters.hpp"
@@ -46,6 +47,7 @@
 
 #ifdef USE_QSH
 #include "ft/qsh/QshMdClient.hpp"
+#include "ft/qsh/QshSink.hpp"
 #endif
 
 #include "ft/spb/SpbProtocol.hpp"
@@ -57,6 +59,7 @@
 #include "toolbox/io/DgramSocket.hpp"
 #include "ft/io/MdServer.hpp"
 #include "ft/tbricks/TbricksProtocol.hpp"
+#include "ft/matching/MatchingProtocol.hpp"
 #include "toolbox/util/RobinHood.hpp"
 #include "ft/io/Csv.hpp"
 #ifdef USE_CLICKHOUSECPP
@@ -114,6 +117,11 @@ class MdClientFactory : public BasicServiceFactory {
   using Base = BasicServiceFactory;
 public:
   using Base::Base;
+
+  /// "pcap": captures are read on calling thread, "replay": they are paced by capture time on reactor thread
+  void pcap_mode(std::string_view val) {
+    pcap_mode_ = val;
+  }
  
   std::unique_ptr<core::IService> make_service(const core::Parameters& params) override {
     return std::unique_ptr<core::IService>(make_client(params).release());
@@ -151,7 +159,10 @@ public:
 #ifdef USE_PCAP
     else if(transport=="pcap") {
       using Proxy = core::Proxy<io::PcapMdClient<ProtocolM>, core::IClient::Impl>;
-      return make_proxy<core::IClient, Proxy>();
+      auto* proxy = new Proxy(parent()->reactor(), parent());
+      proxy->impl()->sync(pcap_mode_=="pcap");
+      proxy->impl()->replay_mode(pcap_mode_=="replay");
+      return std::unique_ptr<core::IClient>(proxy);
     } 
 #endif  
     else {
@@ -159,6 +170,8 @@ public:
       return nullptr;
     }
   }  
+private:
+  std::string pcap_mode_;
 
 };
 
@@ -176,6 +189,8 @@ public:
     TOOLBOX_INFO<<"make_server protocol:"<<protocol<<", transport:"<<this->transport(params);
     if(protocol=="TB1") {
         return make_server<tbricks::TbricksProtocol>(params);
+    } else if(protocol=="SIM") {
+        return make_server<matching::MatchingProtocol>(params);
     } else {
       fail("unsupported server protocol", protocol, TOOLBOX_FILE_LINE);
       return nullptr;
@@ -260,8 +275,11 @@ public:
   void on_tick(const core::Tick& e) {
     //auto& ins = instruments_[e.venue_instrument_id()];
     TOOLBOX_DUMP << e;
+    if(!resume_.empty() && is_restored(e))
+      return;
     if(out_.is_open())
       out_ << e << std::endl;
+    bestprice_.update(e); // servers share the cache to answer subscriptions
     forward(mdservers_, e, forward_tick_to_servers_);
     forward(mdsinks_, e, forward_tick_to_sinks_);
   }
@@ -295,6 +313,7 @@ public:
     auto &s = *server;
     s.parameters(params);
     s.instruments_cache(&instruments_);
+    s.bestprice_cache(&bestprice_);
     s.subscription()
       .connect(tb::bind([serv=&s](PeerId peer, const core::SubscriptionRequest& req) {
             Self* self = static_cast<Self*>(serv->parent());
@@ -316,6 +335,16 @@ public:
       return svc;
     } else 
 #endif    
+#ifdef USE_QSH
+    if(protocol=="qsh") {
+      using ValuesL = mp::mp_list<core::Tick>;
+      using Service = io::MultiSinkService<ValuesL, io::Service, qsh::QshSink>;
+      using Proxy = core::Proxy<Service, core::IService::Impl>;
+      auto* proxy = new Proxy(&instruments_, reactor(), self());
+      svc = std::unique_ptr<core::IService>(proxy);
+      return svc;
+    } else
+#endif
     if(protocol=="csv") {
       using ValuesL = mp::mp_list<core::Tick, core::InstrumentUpdate>;
       using Service = io::MultiSinkService<ValuesL, io::Service, io::CsvSink>;
@@ -333,7 +362,18 @@ public:
     TOOLBOX_INFO << "subscribe:"<<req;
     switch(req.request()) {
       case Request::Subscribe: {
-        
+        // acknowledge with snapshot of the last known price (if any)
+        core::StatusResponse res;
+        res.reset();
+        res.response(core::Response::Subscribe);
+        res.topic(req.topic());
+        res.request_id(req.request_id());
+        res.instrument_id(req.instrument_id());
+        res.status(instruments_.find(req.symbol()) ? core::Status::Ok : core::Status::Pending);
+        serv.async_write_to(peer, res, tb::bind([this](ssize_t size, std::error_code ec) {
+          if(ec)
+            on_io_error(ec);
+        }));
       } break;
       default: {
         TOOLBOX_ERROR<<"request not supported: "<<req.request();
@@ -354,6 +394,12 @@ public:
   }
 
   void stop() {
+    if(checkpointer_.running()) {
+      checkpoint_timer_.cancel();
+      checkpointer_.wait();   // final capture would be skipped while periodic one is written
+      checkpoint();
+      checkpointer_.stop();
+    }
     for(auto& it: mdservers_) {
       it.second->stop();
     }
@@ -400,6 +446,9 @@ public:
         //bestprice_csv_.open(output_path+"-bbo.csv");
         //instrument_csv_.open(output_path+"-ins.csv");
       }
+
+      if(params.find("checkpoint")!=params.end() && mode()!="pcap" && mode()!="replay")
+        open_checkpoint(params["checkpoint"]);   // captured history is not checkpointed
       
       for(auto pa: params["sinks"]) {
         bool enabled = is_service_enabled(pa, mode());
@@ -422,8 +471,10 @@ public:
         }
       }
       
-      if(mode()=="pcap") {
+      if(mode()=="pcap" || mode()=="replay") {
+        // pcap mode reads captures before returning, replay mode paces captured packets on reactor thread
         mdclient_factory_.transport("pcap");
+        mdclient_factory_.pcap_mode(mode());
       }
 
       for(auto pa : params["clients"]) {
@@ -443,6 +494,62 @@ public:
       }
   }
 
+  /// "checkpoint": { "path": file of the latest checkpoint, "interval_s": how often caches are saved
+  ///              , "max_age_s": older checkpoint is not loaded, since sequences could be reset by then }
+  /// Caches are restored from the checkpoint before clients start, then saved periodically in background.
+  void open_checkpoint(const core::Parameters& params) {
+    std::string path = params.str("path", "");
+    if(path.empty())
+      return;
+    auto max_age = std::chrono::seconds(params.value_or("max_age_s", 600));
+    try {
+      auto start = tb::MonoClock::now();
+      core::CheckpointReader reader(path);
+      auto age = tb::WallClock::now() - reader.time();
+      if(age > max_age) {
+        TOOLBOX_WARNING << "checkpoint: '"<<path<<"' is "<<std::chrono::duration_cast<std::chrono::seconds>(age).count()<<"s old, not loaded";
+      } else {
+        std::size_t n = reader.read(bestprice_);
+        for(auto& [id, bp]: bestprice_) {
+          if(bp.sequence())
+            resume_[id] = bp.sequence();
+        }
+        auto elapsed = std::chrono::duration_cast<tb::Micros>(tb::MonoClock::now() - start);
+        TOOLBOX_INFO << "checkpoint: restored "<<n<<" instruments from '"<<path<<"' in "<<elapsed.count()<<"us";
+      }
+    } catch(std::system_error& e) {
+      TOOLBOX_INFO << "checkpoint: no checkpoint loaded, "<<e.what();
+    } catch(std::runtime_error& e) {
+      TOOLBOX_ERROR << e.what();
+      bestprice_.clear();
+      resume_.clear();
+    }
+    auto interval = std::chrono::seconds(params.value_or("interval_s", 10));
+    checkpointer_.path(path);
+    checkpointer_.start();
+    checkpoint_timer_ = reactor()->timer(tb::MonoClock::now()+interval, interval, tb::Priority::Low,
+      tb::bind([this](tb::CyclTime now, tb::Timer& timer) {
+        checkpoint();
+      }));
+  }
+
+  /// copies caches on reactor thread, file is written by checkpointer thread
+  void checkpoint() {
+    if(!checkpointer_.capture(tb::WallClock::now(), bestprice_))
+      TOOLBOX_WARNING << "checkpoint: previous one is still being written, skipped";
+  }
+
+  /// ticks already applied to restored cache are dropped until the instrument gets a newer one
+  bool is_restored(const core::Tick& e) {
+    auto it = resume_.find(e.venue_instrument_id());
+    if(it==resume_.end())
+      return false;
+    if(e.sequence()!=0 && e.sequence()<=it->second)
+      return true;
+    resume_.erase(it);
+    return false;
+  }
+
   void on_client_open(core::IClient& client) {
     async_subscribe(client, client.parameters()["subscriptions"], tb::bind([this](ssize_t size, std::error_code ec) {
       if(ec) {
@@ -493,7 +600,7 @@ public:
       ('v', "verbose", tb::Value{log_level}, "log level")
       ('l', "logfile", tb::Value{parameters(), "logfile", std::string{}}, "log file")
       ('o', "outfile", tb::Value{parameters(), "outfile", std::string{}}, "out file")
-      ('m', "mode", tb::Value{mode_}, "pcap, prod, test")
+      ('m', "mode", tb::Value{mode_}, "pcap, replay, prod, test")
       (tb::Value{config_file}.required(), "config.json file");
     try {
       parser.parse(argc, argv);
@@ -536,6 +643,9 @@ private:
   tb::MonoTime start_timestamp_;
   core::InstrumentsCache instruments_;
   core::BestPriceCache bestprice_;
+  core::Checkpointer checkpointer_;
+  tb::Timer checkpoint_timer_;
+  tb::unordered_map<core::Identifier, ft_seq_t> resume_;  // sequences of restored instruments
   // csv sink
   tb::unordered_map<core::Identifier, std::unique_ptr<core::IService>> mdsinks_;
   tb::unordered_map<core::Identifier, std::unique_ptr<core::IClient>> mdclients_;
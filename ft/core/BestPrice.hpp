@@ -41,6 +41,12 @@ public:
         fields_.set(Field::LocalTime);
     }
     Timestamp recv_time() const { return recv_time_; }
+    /// sequence of the last tick applied
+    ft_seq_t sequence() const { return sequence_; }
+    void sequence(ft_seq_t val) {
+        sequence_ = val;
+        fields_.set(Field::Seq);
+    }
 
     auto& bid_price(Price val) { 
         bid_.price = val;
@@ -156,6 +162,7 @@ protected:
     VenueInstrumentId venue_instrument_id_ {};
     Timestamp send_time_;
     Timestamp recv_time_;
+    ft_seq_t sequence_ {0};
     PriceQtyTime bid_ {};
     PriceQtyTime ask_ {};
     PriceQtyTime last_ {};
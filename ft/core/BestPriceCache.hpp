@@ -26,6 +26,13 @@ public:
     BestPrice& operator[](VenueInstrumentId id) { 
         return data_[id]; 
     }
+    /// @returns last known best price or nullptr if nothing was received for the instrument
+    const BestPrice* find(VenueInstrumentId id) const {
+        auto it = data_.find(id);
+        if(it==data_.end())
+            return nullptr;
+        return &it->second;
+    }
 
     template<class TickT>
     auto& update(const TickT& tick) { 
@@ -34,11 +41,16 @@ public:
         bp.venue_instrument_id(id);
         bp.send_time(tick.send_time());
         bp.recv_time(tick.recv_time());
+        bp.sequence(tick.sequence());
         for(int i=0; i<tick.size(); i++) {
             bp.update(tick[i]);
         }
         return bp;
     }
+    auto begin() const { return data_.begin(); }
+    auto end() const { return data_.end(); }
+    std::size_t size() const { return data_.size(); }
+    void clear() { data_.clear(); }
 private:
     ft::unordered_map<VenueInstrumentId, BestPrice> data_;
 };
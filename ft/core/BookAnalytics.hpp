@@ -0,0 +1,179 @@
+#pragma once
+
+#include "ft/core/L2Book.hpp"
+#include "ft/core/Stream.hpp"
+#include "ft/core/Tick.hpp"
+#include "ft/utils/Common.hpp"
+#include <algorithm>
+#include <cstdint>
+
+namespace ft { inline namespace core {
+
+/// Order book features of instruments, kept incrementally on L2 level updates:
+///   Spread, MicroPrice - from best levels, in price();
+///   BidDepth, AskDepth - sum of qty of top N levels of side, in qty();
+///   Imbalance - (BidDepth-AskDepth)/(BidDepth+AskDepth) of top N levels, in price() scaled like prices.
+/// Each level change costs O(1) on top of the book update. Changed features are published
+/// as Modify elements of Statistics ticks, one field per element.
+/// Input is L2 level ticks by price (QSH Quotes, OrderLogBook levels), not order log itself,
+/// QshMdClient runs it on replayed files when "analytics" is configured.
+class BookAnalytics {
+public:
+    using Side = core::TickSide;
+    using StatsTick = Ticks<8>;
+
+    struct Features {
+        Price spread {0};
+        Price microprice {0};
+        Price imbalance {0};
+        Qty depth[2] {};    // bid, ask
+    };
+
+    /// @param levels N of top N levels depth and imbalance are computed over
+    explicit BookAnalytics(std::size_t levels = 5, std::size_t reserve = 64)
+    : levels_(std::max<std::size_t>(levels, 1))
+    , reserve_(reserve)
+    {}
+
+    std::size_t levels() const { return levels_; }
+
+    template<class TickT>
+    void update(const TickT& tick) {
+        auto id = tick.venue_instrument_id();
+        auto it = data_.find(id);
+        if(it==data_.end())
+            it = data_.emplace(id, Instrument(reserve_)).first;
+        auto& ins = it->second;
+        ins.book.venue_instrument_id(id);
+        ins.book.send_time(tick.send_time());
+        ins.book.recv_time(tick.recv_time());
+        bool changed = false;
+        for(std::size_t i=0; i<tick.size(); i++) {
+            auto& e = tick[i];
+            switch(e.event()) {
+                case TickEvent::Add:
+                case TickEvent::Modify:
+                    changed |= apply(ins, e.side(), ins.book.set(e.side(), e.price(), e.qty()));
+                    break;
+                case TickEvent::Delete:
+                    changed |= apply(ins, e.side(), ins.book.set(e.side(), e.price(), 0));
+                    break;
+                case TickEvent::Clear:
+                    ins.book.clear(e.side());
+                    for(Side side: {Side::Buy, Side::Sell})
+                        ins.depth[index(side)] = depth(ins.book, side);
+                    changed = true;
+                    break;
+                default:
+                    break;
+            }
+        }
+        if(changed)
+            publish(ins, tick);
+    }
+
+    /// @returns last published features or nullptr if nothing was received for the instrument
+    const Features* find(VenueInstrumentId id) const {
+        auto it = data_.find(id);
+        return it!=data_.end() ? &it->second.features : nullptr;
+    }
+    const L2Book* book(VenueInstrumentId id) const {
+        auto it = data_.find(id);
+        return it!=data_.end() ? &it->second.book : nullptr;
+    }
+
+    core::Stream::Signal<const Tick&>& statistics() { return statistics_; }
+private:
+    struct Instrument {
+        explicit Instrument(std::size_t reserve)
+        : book(reserve) {}
+        L2Book book;
+        Qty depth[2] {};        // bid, ask; top N levels
+        Features features;      // last published
+    };
+
+    static std::size_t index(Side side) { return side==Side::Sell; }
+
+    /// keeps top N depth of side after level change
+    bool apply(Instrument& ins, Side side, const L2Book::Change& c) {
+        if(c.prev==c.qty)
+            return false;
+        if(c.index >= levels_)
+            return false;
+        auto levels = ins.book.levels(side);
+        Qty& depth = ins.depth[index(side)];
+        if(c.prev==0) {
+            depth += c.qty;
+            if(levels.size() > levels_)
+                depth -= levels[levels_].qty;          // pushed out of top N
+        } else if(c.qty==0) {
+            depth -= c.prev;
+            if(levels.size() >= levels_)
+                depth += levels[levels_ - 1].qty;      // pulled into top N
+        } else {
+            depth += c.qty - c.prev;
+        }
+        return true;
+    }
+    Qty depth(const L2Book& book, Side side) const {
+        auto levels = book.levels(side);
+        Qty sum = 0;
+        for(std::size_t i=0; i<std::min(levels_, levels.size()); i++)
+            sum += levels[i].qty;
+        return sum;
+    }
+
+    template<class TickT>
+    void publish(Instrument& ins, const TickT& tick) {
+        Features now;
+        auto* bid = ins.book.best(Side::Buy);
+        auto* ask = ins.book.best(Side::Sell);
+        if(bid && ask) {
+            now.spread = ask->price - bid->price;
+            Qty qty = bid->qty + ask->qty;
+            // (bid*ask_qty + ask*bid_qty) / (bid_qty + ask_qty), leans towards the thinner side
+            now.microprice = qty ? bid->price + now.spread * bid->qty / qty : bid->price + now.spread / 2;
+        }
+        now.depth[0] = ins.depth[0];
+        now.depth[1] = ins.depth[1];
+        Qty total = now.depth[0] + now.depth[1];
+        if(total)
+            now.imbalance = static_cast<Price>(static_cast<__int128>(now.depth[0] - now.depth[1]) * CorePriceMultiplier / total);
+        auto& last = ins.features;
+        StatsTick ti {};
+        std::size_t n = 0;
+        auto add = [&](Field field) -> TickElement& {
+            auto& e = ti[n++];
+            e = TickElement {};
+            e.event(TickEvent::Modify).field(field);
+            return e;
+        };
+        if(now.spread!=last.spread)
+            add(Field::Spread).price(now.spread);
+        if(now.microprice!=last.microprice)
+            add(Field::MicroPrice).price(now.microprice);
+        if(now.imbalance!=last.imbalance)
+            add(Field::Imbalance).price(now.imbalance);
+        if(now.depth[0]!=last.depth[0])
+            add(Field::BidDepth).qty(now.depth[0]);
+        if(now.depth[1]!=last.depth[1])
+            add(Field::AskDepth).qty(now.depth[1]);
+        last = now;
+        if(n==0)
+            return;
+        ti.resize(n);
+        ti.topic(StreamTopic::Statistics);
+        ti.event(Event::Update);
+        ti.venue_instrument_id(tick.venue_instrument_id());
+        ti.send_time(tick.send_time());
+        ti.recv_time(tick.recv_time());
+        statistics_.invoke(ti.as_size<1>());
+    }
+private:
+    std::size_t levels_;
+    std::size_t reserve_;
+    ft::unordered_map<VenueInstrumentId, Instrument> data_;
+    core::Stream::Signal<const Tick&> statistics_;
+};
+
+}} // ft::core
@@ -0,0 +1,150 @@
+#include "BookAnalytics.hpp"
+#include "ft/utils/UnitTest.hpp"
+#include "toolbox/sys/Log.hpp"
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace ft;
+using namespace ft::core;
+
+namespace {
+
+constexpr std::size_t BENCH = 0;
+
+TickElement element(TickEvent event, TickSide side, Price price, Qty qty) {
+    TickElement e {};
+    e.event(event);
+    e.side(side);
+    e.price(price);
+    e.qty(qty);
+    return e;
+}
+
+Ticks<4> tick(VenueInstrumentId id, std::initializer_list<TickElement> elements) {
+    Ticks<4> ti {};
+    ti.venue_instrument_id(id);
+    ti.event(Event::Update);
+    std::size_t n = 0;
+    for(auto& e: elements)
+        ti[n++] = e;
+    ti.resize(n);
+    return ti;
+}
+
+/// last value of each field published
+struct Collector {
+    std::map<Field, TickElement> fields;
+    std::size_t ticks {0};
+    void operator()(const Tick& tick) {
+        BOOST_CHECK(tick.topic()==StreamTopic::Statistics);
+        ticks++;
+        for(std::size_t i=0; i<tick.size(); i++)
+            fields[tick[i].field()] = tick[i];
+    }
+};
+
+Qty depth(const L2Book& book, TickSide side, std::size_t n) {
+    Qty sum = 0;
+    auto levels = book.levels(side);
+    for(std::size_t i=0; i<std::min(n, levels.size()); i++)
+        sum += levels[i].qty;
+    return sum;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(BookAnalyticsSuite)
+
+BOOST_AUTO_TEST_CASE(Features)
+{
+    BookAnalytics analytics(2);
+    Collector stats;
+    analytics.statistics().connect(tb::bind([&stats](const Tick& tick) { stats(tick); }));
+
+    analytics.update(tick(VenueInstrumentId(7), {
+        element(TickEvent::Add, TickSide::Buy, 100, 30),
+        element(TickEvent::Add, TickSide::Buy, 99, 10),
+        element(TickEvent::Add, TickSide::Buy, 98, 50),
+        element(TickEvent::Add, TickSide::Sell, 104, 10)
+    }).as_size<1>());
+    BOOST_CHECK_EQUAL(stats.ticks, 1);
+    BOOST_CHECK_EQUAL(stats.fields[Field::Spread].price(), 4);
+    BOOST_CHECK_EQUAL(stats.fields[Field::MicroPrice].price(), 103);     // 100 + 4*30/40
+    BOOST_CHECK_EQUAL(stats.fields[Field::BidDepth].qty(), 40);          // 98 is out of top 2
+    BOOST_CHECK_EQUAL(stats.fields[Field::AskDepth].qty(), 10);
+    BOOST_CHECK_EQUAL(stats.fields[Field::Imbalance].price(), CorePriceMultiplier * 3 / 5);
+    auto* features = analytics.find(VenueInstrumentId(7));
+    BOOST_REQUIRE(features);
+    BOOST_CHECK_EQUAL(features->depth[0], 40);
+
+    // level below top 2 changes nothing
+    analytics.update(tick(VenueInstrumentId(7), {element(TickEvent::Modify, TickSide::Buy, 98, 5)}).as_size<1>());
+    BOOST_CHECK_EQUAL(stats.ticks, 1);
+
+    // removed level pulls the next one into top 2, only depth and imbalance are published
+    stats.fields.clear();
+    analytics.update(tick(VenueInstrumentId(7), {element(TickEvent::Delete, TickSide::Buy, 99, 0)}).as_size<1>());
+    BOOST_CHECK_EQUAL(stats.ticks, 2);
+    BOOST_CHECK_EQUAL(stats.fields.size(), 2);
+    BOOST_CHECK_EQUAL(stats.fields[Field::BidDepth].qty(), 35);
+    BOOST_CHECK_EQUAL(stats.fields[Field::Imbalance].price(), CorePriceMultiplier * 25 / 45);
+
+    // new best ask pushes 104 down, spread narrows
+    analytics.update(tick(VenueInstrumentId(7), {element(TickEvent::Add, TickSide::Sell, 102, 30)}).as_size<1>());
+    BOOST_CHECK_EQUAL(stats.fields[Field::Spread].price(), 2);
+    BOOST_CHECK_EQUAL(stats.fields[Field::MicroPrice].price(), 101);
+    BOOST_CHECK_EQUAL(stats.fields[Field::AskDepth].qty(), 40);
+
+    analytics.update(tick(VenueInstrumentId(7), {element(TickEvent::Clear, TickSide::Sell, 0, 0)}).as_size<1>());
+    BOOST_CHECK_EQUAL(stats.fields[Field::Spread].price(), 0);
+    BOOST_CHECK_EQUAL(stats.fields[Field::AskDepth].qty(), 0);
+    BOOST_CHECK_EQUAL(stats.fields[Field::Imbalance].price(), CorePriceMultiplier);
+    BOOST_CHECK(analytics.find(VenueInstrumentId(8))==nullptr);
+}
+
+/// random level updates, incremental features checked against ones computed from the book
+BOOST_AUTO_TEST_CASE(Benchmark)
+{
+    constexpr std::size_t N = BENCH ? 10000000 : 100000;
+    constexpr std::size_t Levels = 5;
+    std::vector<Ticks<4>> updates;
+    updates.reserve(N);
+    std::mt19937_64 gen(1);
+    for(std::size_t i=0; i<N; i++) {
+        bool buy = gen() & 1;
+        Price depth = (gen()%8) * (gen()%8);
+        Price price = buy ? 1000 - depth : 1001 + depth;
+        Qty qty = (gen()%4) ? 1 + gen()%100 : 0;
+        auto side = buy ? TickSide::Buy : TickSide::Sell;
+        updates.push_back(tick(VenueInstrumentId(1 + gen()%4), {element(qty ? TickEvent::Modify : TickEvent::Delete, side, price, qty)}));
+    }
+    BookAnalytics analytics(Levels);
+    std::size_t published = 0;
+    analytics.statistics().connect(tb::bind([&published](const Tick& tick) { published += tick.size(); }));
+    std::size_t runs = 0;
+    maybe_bench("analytics_update", BENCH, [&] {
+        for(auto& ti: updates)
+            analytics.update(ti.as_size<1>());
+        runs++;
+    });
+    if(runs>1)
+        TOOLBOX_INFO << "analytics_update: "<<N<<" updates, "<<published<<" features published";
+    BOOST_CHECK(published > 0);
+    // incremental features match the ones recomputed from the book after every update
+    BookAnalytics checked(Levels);
+    for(auto& ti: updates) {
+        checked.update(ti.as_size<1>());
+        auto id = ti.venue_instrument_id();
+        auto& book = *checked.book(id);
+        auto& features = *checked.find(id);
+        BOOST_REQUIRE_EQUAL(features.depth[0], depth(book, TickSide::Buy, Levels));
+        BOOST_REQUIRE_EQUAL(features.depth[1], depth(book, TickSide::Sell, Levels));
+        auto* bid = book.best(TickSide::Buy);
+        auto* ask = book.best(TickSide::Sell);
+        BOOST_REQUIRE_EQUAL(features.spread, bid && ask ? ask->price - bid->price : 0);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,439 @@
+#pragma once
+#include "ft/core/BestPriceCache.hpp"
+#include "ft/core/L2Book.hpp"
+#include "ft/utils/MappedFile.hpp"
+#include "toolbox/sys/Log.hpp"
+#include "toolbox/sys/Time.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace ft { inline namespace core {
+
+/// Checkpoint file is a flat sequence of fixed size records, so it could be read in place from mapping:
+///   CheckpointHeader, then per section CheckpointSection followed by its records.
+/// Records are 8-byte aligned, integers are in host byte order.
+enum class CheckpointKind : std::uint32_t {
+    Empty = 0,
+    BestPrice = 1,      // BestPriceRecord per instrument
+    L2Book = 2          // L2BookRecord per book, followed by its levels
+};
+
+struct CheckpointHeader {
+    static constexpr std::uint32_t Magic = 0x4e535446;    // "FTSN"
+    static constexpr std::uint32_t Version = 1;
+    std::uint32_t magic {Magic};
+    std::uint32_t version {Version};
+    std::uint64_t size {0};         // of the whole file
+    std::uint64_t checksum {0};     // of everything after the header
+    std::int64_t time {0};          // when caches were copied, ns since epoch
+    std::uint64_t sections {0};
+};
+
+struct CheckpointSection {
+    CheckpointKind kind {CheckpointKind::Empty};
+    std::uint32_t reserved {0};
+    std::uint64_t count {0};        // of records
+    std::uint64_t size {0};         // bytes of records following the section
+};
+
+struct BestPriceRecord {
+    /// bit i of fields is set when Fields[i] was set in BestPrice
+    static constexpr Field Fields[] = {
+        Field::InstrumentId, Field::VenueInstrumentId, Field::Time, Field::LocalTime, Field::Seq,
+        Field::BidPrice, Field::BidQty, Field::AskPrice, Field::AskQty, Field::LastPrice, Field::LastQty, Field::LastTime
+    };
+    ft_id_t venue_instrument_id;
+    ft_id_t instrument_id;
+    std::int64_t send_time;
+    std::int64_t recv_time;
+    std::uint64_t sequence;
+    std::uint64_t fields;
+    PriceQty bid;
+    PriceQty ask;
+    PriceQty last;
+    std::int64_t last_time;
+};
+
+struct L2BookRecord {
+    ft_id_t venue_instrument_id;
+    std::int64_t send_time;
+    std::int64_t recv_time;
+    std::uint32_t bids;     // levels follow the record: bids, then asks, the worst level first
+    std::uint32_t asks;
+};
+
+static_assert(sizeof(CheckpointHeader)%8==0 && sizeof(CheckpointSection)%8==0);
+static_assert(sizeof(BestPriceRecord)%8==0 && sizeof(L2BookRecord)%8==0 && sizeof(PriceQty)%8==0);
+static_assert(std::is_trivially_copyable_v<BestPriceRecord> && std::is_trivially_copyable_v<PriceQty>);
+
+/// FNV-1a
+inline std::uint64_t checkpoint_checksum(const char* data, std::size_t size) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for(std::size_t i=0; i<size; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/// Serializes caches into flat buffer, which is reused between checkpoints, so it does not allocate once grown
+class CheckpointWriter {
+public:
+    void begin(Timestamp time) {
+        size_ = 0;
+        CheckpointHeader header;
+        header.time = time.time_since_epoch().count();
+        append(&header, sizeof(header));
+    }
+
+    template<typename PolicyT>
+    void write(const BasicBestPriceCache<PolicyT>& cache) {
+        std::size_t pos = begin_section(CheckpointKind::BestPrice);
+        for(auto& [id, bp]: cache) {
+            BestPriceRecord r {};
+            r.venue_instrument_id = id;
+            r.instrument_id = bp.instrument_id();
+            r.send_time = bp.send_time().time_since_epoch().count();
+            r.recv_time = bp.recv_time().time_since_epoch().count();
+            r.sequence = bp.sequence();
+            for(std::size_t i=0; i<std::size(BestPriceRecord::Fields); i++)
+                if(bp.test(BestPriceRecord::Fields[i]))
+                    r.fields |= 1ull<<i;
+            r.bid = {bp.bid_price(), bp.bid_qty()};
+            r.ask = {bp.ask_price(), bp.ask_qty()};
+            r.last = {bp.last_price(), bp.last_qty()};
+            r.last_time = bp.last_time().time_since_epoch().count();
+            append(&r, sizeof(r));
+        }
+        end_section(pos, cache.size());
+    }
+
+    void write(const L2BookCache& cache) {
+        std::size_t pos = begin_section(CheckpointKind::L2Book);
+        for(auto& [id, book]: cache) {
+            L2BookRecord r {};
+            r.venue_instrument_id = id;
+            r.send_time = book.send_time().time_since_epoch().count();
+            r.recv_time = book.recv_time().time_since_epoch().count();
+            r.bids = book.bids().size();
+            r.asks = book.asks().size();
+            append(&r, sizeof(r));
+            for(auto side: {TickSide::Buy, TickSide::Sell}) {
+                auto levels = book.levels(side);
+                if(!levels.empty())
+                    append(&levels[levels.size()-1], levels.size()*sizeof(PriceQty));  // worst level first
+            }
+        }
+        end_section(pos, cache.size());
+    }
+
+    /// fills size and checksum of the header
+    void finish() {
+        auto& h = header();
+        h.size = size_;
+        h.checksum = checkpoint_checksum(buf_.data() + sizeof(CheckpointHeader), size_ - sizeof(CheckpointHeader));
+    }
+
+    const char* data() const { return buf_.data(); }
+    std::size_t size() const { return size_; }
+
+    /// Writes buffer to temporary file, syncs and renames it over path,
+    /// so path is always either the previous checkpoint or the new one.
+    /// Directory is synced too, otherwise the rename itself could be lost on crash.
+    /// @throws std::system_error
+    void save(const std::string& path) const {
+        std::string tmp = path + ".tmp";
+        int fd = ::open(tmp.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+        if(fd<0)
+            throw std::system_error(errno, std::generic_category(), "open "+tmp);
+        const char* ptr = buf_.data();
+        std::size_t left = size_;
+        while(left>0) {
+            ssize_t n = ::write(fd, ptr, left);
+            if(n<0 && errno==EINTR)
+                continue;
+            if(n<0) {
+                int ec = errno;
+                ::close(fd);
+                throw std::system_error(ec, std::generic_category(), "write "+tmp);
+            }
+            ptr += n;
+            left -= n;
+        }
+        if(::fsync(fd)<0) {
+            int ec = errno;
+            ::close(fd);
+            throw std::system_error(ec, std::generic_category(), "fsync "+tmp);
+        }
+        ::close(fd);
+        if(std::rename(tmp.c_str(), path.c_str())<0)
+            throw std::system_error(errno, std::generic_category(), "rename "+tmp);
+        auto slash = path.rfind('/');
+        std::string dir = slash==std::string::npos ? "." : slash==0 ? "/" : path.substr(0, slash);
+        fd = ::open(dir.c_str(), O_RDONLY|O_DIRECTORY);
+        if(fd<0)
+            throw std::system_error(errno, std::generic_category(), "open "+dir);
+        if(::fsync(fd)<0) {
+            int ec = errno;
+            ::close(fd);
+            throw std::system_error(ec, std::generic_category(), "fsync "+dir);
+        }
+        ::close(fd);
+    }
+private:
+    CheckpointHeader& header() { return *reinterpret_cast<CheckpointHeader*>(buf_.data()); }
+    void append(const void* data, std::size_t size) {
+        if(size_ + size > buf_.size())
+            buf_.resize(std::max(2*buf_.size(), size_ + size));
+        std::memcpy(buf_.data() + size_, data, size);
+        size_ += size;
+    }
+    std::size_t begin_section(CheckpointKind kind) {
+        std::size_t pos = size_;
+        CheckpointSection section;
+        section.kind = kind;
+        append(&section, sizeof(section));
+        header().sections++;
+        return pos;
+    }
+    void end_section(std::size_t pos, std::size_t count) {
+        auto& section = *reinterpret_cast<CheckpointSection*>(buf_.data() + pos);
+        section.count = count;
+        section.size = size_ - pos - sizeof(CheckpointSection);
+    }
+private:
+    std::vector<char> buf_;
+    std::size_t size_ {0};     // used part of buf_
+};
+
+/// Maps checkpoint file, validates it and restores caches from it
+class CheckpointReader {
+public:
+    /// @throws std::system_error if file could not be mapped, std::runtime_error if it is not a valid checkpoint
+    explicit CheckpointReader(const std::string& path)
+    : file_(path) {
+        validate(path);
+    }
+
+    const CheckpointHeader& header() const { return *reinterpret_cast<const CheckpointHeader*>(file_.data()); }
+    Timestamp time() const { return Timestamp(tb::Nanos(header().time)); }
+
+    /// @returns section of kind or nullptr
+    const CheckpointSection* find(CheckpointKind kind) const {
+        const char* ptr = file_.data() + sizeof(CheckpointHeader);
+        for(std::size_t i=0; i<header().sections; i++) {
+            auto* section = reinterpret_cast<const CheckpointSection*>(ptr);
+            if(section->kind==kind)
+                return section;
+            ptr += sizeof(CheckpointSection) + section->size;
+        }
+        return nullptr;
+    }
+
+    /// @returns number of instruments restored
+    template<typename PolicyT>
+    std::size_t read(BasicBestPriceCache<PolicyT>& cache) const {
+        auto* section = find(CheckpointKind::BestPrice);
+        if(!section)
+            return 0;
+        if(section->size!=section->count*sizeof(BestPriceRecord))
+            throw std::runtime_error("checkpoint: bad BestPrice section");
+        auto* records = reinterpret_cast<const BestPriceRecord*>(section + 1);
+        for(std::size_t n=0; n<section->count; n++) {
+            auto& r = records[n];
+            auto& bp = cache[r.venue_instrument_id];
+            bp = {};
+            for(std::size_t i=0; i<std::size(BestPriceRecord::Fields); i++) {
+                if(!(r.fields & (1ull<<i)))
+                    continue;
+                switch(BestPriceRecord::Fields[i]) {
+                    case Field::InstrumentId: bp.instrument_id(r.instrument_id); break;
+                    case Field::VenueInstrumentId: bp.venue_instrument_id(r.venue_instrument_id); break;
+                    case Field::Time: bp.send_time(Timestamp(tb::Nanos(r.send_time))); break;
+                    case Field::LocalTime: bp.recv_time(Timestamp(tb::Nanos(r.recv_time))); break;
+                    case Field::Seq: bp.sequence(r.sequence); break;
+                    case Field::BidPrice: bp.bid_price(r.bid.price); break;
+                    case Field::BidQty: bp.bid_qty(r.bid.qty); break;
+                    case Field::AskPrice: bp.ask_price(r.ask.price); break;
+                    case Field::AskQty: bp.ask_qty(r.ask.qty); break;
+                    case Field::LastPrice: bp.last_price(r.last.price); break;
+                    case Field::LastQty: bp.last_qty(r.last.qty); break;
+                    case Field::LastTime: bp.last_time(Timestamp(tb::Nanos(r.last_time))); break;
+                    default: break;
+                }
+            }
+        }
+        return section->count;
+    }
+
+    /// @returns number of books restored
+    std::size_t read(L2BookCache& cache) const {
+        auto* section = find(CheckpointKind::L2Book);
+        if(!section)
+            return 0;
+        const char* ptr = reinterpret_cast<const char*>(section + 1);
+        const char* end = ptr + section->size;
+        for(std::size_t n=0; n<section->count; n++) {
+            if(end - ptr < (ssize_t)sizeof(L2BookRecord))
+                throw std::runtime_error("checkpoint: bad L2Book section");
+            auto& r = *reinterpret_cast<const L2BookRecord*>(ptr);
+            auto* levels = reinterpret_cast<const PriceQty*>(&r + 1);
+            ptr += sizeof(L2BookRecord) + (std::size_t(r.bids) + r.asks)*sizeof(PriceQty);
+            if(ptr > end)
+                throw std::runtime_error("checkpoint: bad L2Book section");
+            auto& book = cache[r.venue_instrument_id];
+            book.venue_instrument_id(r.venue_instrument_id);
+            book.send_time(Timestamp(tb::Nanos(r.send_time)));
+            book.recv_time(Timestamp(tb::Nanos(r.recv_time)));
+            book.assign(TickSide::Buy, levels, levels + r.bids);
+            book.assign(TickSide::Sell, levels + r.bids, levels + r.bids + r.asks);
+        }
+        return section->count;
+    }
+private:
+    void validate(const std::string& path) const {
+        auto fail = [&](const char* what) {
+            throw std::runtime_error("checkpoint: "+path+": "+what);
+        };
+        if(file_.size() < sizeof(CheckpointHeader))
+            fail("too short");
+        auto& h = header();
+        if(h.magic!=CheckpointHeader::Magic)
+            fail("bad magic");
+        if(h.version!=CheckpointHeader::Version)
+            fail("unsupported version");
+        if(h.size!=file_.size())
+            fail("truncated");
+        if(h.checksum!=checkpoint_checksum(file_.data() + sizeof(CheckpointHeader), file_.size() - sizeof(CheckpointHeader)))
+            fail("bad checksum");
+        std::size_t left = file_.size() - sizeof(CheckpointHeader);
+        const char* ptr = file_.data() + sizeof(CheckpointHeader);
+        for(std::size_t i=0; i<h.sections; i++) {
+            if(left < sizeof(CheckpointSection))
+                fail("bad section");
+            auto* section = reinterpret_cast<const CheckpointSection*>(ptr);
+            if(left - sizeof(CheckpointSection) < section->size)
+                fail("bad section");
+            ptr += sizeof(CheckpointSection) + section->size;
+            left -= sizeof(CheckpointSection) + section->size;
+        }
+    }
+private:
+    MappedFile file_;
+};
+
+/// Writes checkpoints from its own thread.
+/// capture() copies caches into a flat buffer on the caller thread, that copy is the consistent view of caches.
+/// Checksum and file io are done in background on the other buffer, so the caller never waits for disk.
+class Checkpointer {
+public:
+    explicit Checkpointer(std::string path = {})
+    : path_(std::move(path)) {}
+    Checkpointer(const Checkpointer&) = delete;
+    Checkpointer& operator=(const Checkpointer&) = delete;
+    ~Checkpointer() { stop(); }
+
+    const std::string& path() const { return path_; }
+    /// should be set before start()
+    void path(std::string val) { path_ = std::move(val); }
+
+    void start() {
+        stop();
+        stop_ = false;
+        thread_ = std::thread([this] { run(); });
+    }
+    /// checkpoint being written is finished first
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cond_.notify_all();
+        if(thread_.joinable())
+            thread_.join();
+    }
+    bool running() const { return thread_.joinable(); }
+
+    /// blocks until checkpoint being written is on disk, so the next capture() is not skipped
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this] { return !busy_.load(std::memory_order_acquire) || !running(); });
+    }
+
+    /// @returns false if previous checkpoint is still being written, caches are not copied then
+    template<class...CachesT>
+    bool capture(Timestamp now, const CachesT&... caches) {
+        assert(running());
+        if(busy_.load(std::memory_order_acquire)) {
+            skipped_++;
+            return false;
+        }
+        front_.begin(now);
+        (front_.write(caches), ...);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::swap(front_, back_);
+            busy_.store(true, std::memory_order_release);
+        }
+        cond_.notify_one();
+        return true;
+    }
+
+    std::size_t written() const { return written_.load(std::memory_order_relaxed); }
+    std::size_t skipped() const { return skipped_; }
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while(true) {
+            cond_.wait(lock, [this] { return stop_ || busy_.load(std::memory_order_acquire); });
+            if(!busy_.load(std::memory_order_acquire))
+                return;     // stopped
+            lock.unlock();  // back_ is not touched by capture() while busy
+            write(back_);
+            lock.lock();
+            busy_.store(false, std::memory_order_release);
+            idle_.notify_all();
+        }
+    }
+    void write(CheckpointWriter& writer) {
+        try {
+            writer.finish();
+            writer.save(path_);
+            written_.fetch_add(1, std::memory_order_relaxed);
+            TOOLBOX_DEBUG << "checkpoint: "<<writer.size()<<" bytes to '"<<path_<<"'";
+        } catch(std::exception& e) {
+            TOOLBOX_ERROR << "checkpoint: "<<e.what();
+        }
+    }
+private:
+    std::string path_;
+    CheckpointWriter front_;    // filled by capture()
+    CheckpointWriter back_;     // being written
+    std::atomic<bool> busy_ {false};
+    std::atomic<std::size_t> written_ {0};
+    std::size_t skipped_ {0};
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::condition_variable idle_;  // notified when checkpoint is written
+    bool stop_ {false};
+};
+
+}} // ft::core
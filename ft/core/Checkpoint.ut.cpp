@@ -0,0 +1,219 @@
+#include "Checkpoint.hpp"
+#include "ft/utils/UnitTest.hpp"
+#include "toolbox/sys/Log.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace ft;
+using namespace ft::core;
+
+namespace {
+
+constexpr std::size_t BENCH = 0;
+
+Timestamp ns(std::int64_t val) { return Timestamp(tb::Nanos(val)); }
+
+std::string temp_path(const char* name) {
+    std::string path = std::string("/tmp/") + name + "_XXXXXX";
+    int fd = ::mkstemp(path.data());
+    BOOST_REQUIRE(fd>=0);
+    ::close(fd);
+    return path;
+}
+
+std::vector<PriceQty> levels(const L2Book& book, TickSide side) {
+    auto view = book.levels(side);
+    return {view.begin(), view.end()};
+}
+
+bool same(const std::vector<PriceQty>& lhs, const std::vector<PriceQty>& rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](auto& l, auto& r) {
+        return l.price==r.price && l.qty==r.qty;
+    });
+}
+
+/// instruments with best prices and few levels on each side
+void fill(BestPriceCache& bestprice, L2BookCache& books, std::size_t n, std::size_t depth) {
+    std::mt19937_64 gen(1);
+    for(std::size_t i=0; i<n; i++) {
+        VenueInstrumentId id(i+1);
+        auto& bp = bestprice[id];
+        bp.venue_instrument_id(id);
+        bp.send_time(ns(1000 + i));
+        bp.sequence(100 + i);
+        bp.bid_price(1000).bid_qty(1 + gen()%10);
+        bp.ask_price(1001).ask_qty(1 + gen()%10);
+        auto& book = books[id];
+        book.venue_instrument_id(id);
+        for(std::size_t j=0; j<depth; j++) {
+            book.set(TickSide::Buy, 1000 - j, 1 + gen()%100);
+            book.set(TickSide::Sell, 1001 + j, 1 + gen()%100);
+        }
+    }
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(CheckpointSuite)
+
+BOOST_AUTO_TEST_CASE(RoundTrip)
+{
+    BestPriceCache bestprice;
+    auto& bp = bestprice[VenueInstrumentId(7)];
+    bp.venue_instrument_id(VenueInstrumentId(7));
+    bp.send_time(ns(10));
+    bp.recv_time(ns(12));
+    bp.sequence(42);
+    bp.bid_price(100).bid_qty(3);
+    bp.last_price(101).last_qty(1).last_time(ns(9));
+    auto& empty = bestprice[VenueInstrumentId(8)];
+    empty.venue_instrument_id(VenueInstrumentId(8));
+
+    L2BookCache books;
+    auto& book = books[VenueInstrumentId(7)];
+    book.venue_instrument_id(VenueInstrumentId(7));
+    book.send_time(ns(10));
+    book.set(TickSide::Buy, 100, 3);
+    book.set(TickSide::Buy, 98, 5);
+    book.set(TickSide::Sell, 102, 1);
+    books[VenueInstrumentId(8)];
+
+    CheckpointWriter writer;
+    writer.begin(ns(1000));
+    writer.write(bestprice);
+    writer.write(books);
+    writer.finish();
+    auto path = temp_path("checkpoint");
+    writer.save(path);
+
+    CheckpointReader reader(path);
+    BOOST_CHECK(reader.time()==ns(1000));
+    BOOST_CHECK_EQUAL(reader.header().size, writer.size());
+    BestPriceCache bestprice2;
+    L2BookCache books2;
+    BOOST_CHECK_EQUAL(reader.read(bestprice2), 2);
+    BOOST_CHECK_EQUAL(reader.read(books2), 2);
+
+    auto* bp2 = bestprice2.find(VenueInstrumentId(7));
+    BOOST_REQUIRE(bp2);
+    BOOST_CHECK_EQUAL(bp2->sequence(), 42);
+    BOOST_CHECK(bp2->send_time()==ns(10));
+    BOOST_CHECK(bp2->recv_time()==ns(12));
+    BOOST_CHECK_EQUAL(bp2->bid_price(), 100);
+    BOOST_CHECK_EQUAL(bp2->bid_qty(), 3);
+    BOOST_CHECK_EQUAL(bp2->last_price(), 101);
+    BOOST_CHECK(bp2->last_time()==ns(9));
+    // fields which were not set stay unset
+    BOOST_CHECK(bp2->test(Field::BidPrice));
+    BOOST_CHECK(!bp2->test(Field::AskPrice));
+    BOOST_CHECK(!bp2->test(Field::InstrumentId));
+    auto* empty2 = bestprice2.find(VenueInstrumentId(8));
+    BOOST_REQUIRE(empty2);
+    BOOST_CHECK(!empty2->test(Field::Seq));
+
+    auto* book2 = books2.find(VenueInstrumentId(7));
+    BOOST_REQUIRE(book2);
+    BOOST_CHECK(book2->send_time()==ns(10));
+    BOOST_CHECK(same(levels(*book2, TickSide::Buy), levels(book, TickSide::Buy)));
+    BOOST_CHECK(same(levels(*book2, TickSide::Sell), levels(book, TickSide::Sell)));
+    BOOST_CHECK_EQUAL(book2->best(TickSide::Buy)->price, 100);
+    BOOST_REQUIRE(books2.find(VenueInstrumentId(8)));
+    BOOST_CHECK(books2.find(VenueInstrumentId(8))->empty());
+
+    // corrupted or truncated checkpoint is not loaded
+    {
+        std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(writer.size() - 1);
+        f.put(~writer.data()[writer.size() - 1]);
+    }
+    BOOST_CHECK_THROW(CheckpointReader{path}, std::runtime_error);
+    BOOST_REQUIRE_EQUAL(::truncate(path.c_str(), writer.size() - 8), 0);
+    BOOST_CHECK_THROW(CheckpointReader{path}, std::runtime_error);
+    std::remove(path.c_str());
+    BOOST_CHECK_THROW(CheckpointReader{path}, std::system_error);
+}
+
+BOOST_AUTO_TEST_CASE(Background)
+{
+    BestPriceCache bestprice;
+    L2BookCache books;
+    fill(bestprice, books, 100, 5);
+    auto path = temp_path("checkpointer");
+    Checkpointer checkpointer(path);
+    checkpointer.start();
+    BOOST_CHECK(checkpointer.capture(ns(1), bestprice, books));
+    // caches could change as soon as they are copied
+    bestprice[VenueInstrumentId(1)].bid_price(1);
+    books[VenueInstrumentId(1)].clear();
+    checkpointer.wait();
+    BOOST_CHECK_EQUAL(checkpointer.written(), 1);
+    // nothing is being written after wait, so capture is not skipped
+    bestprice[VenueInstrumentId(1)].bid_price(1000);
+    books[VenueInstrumentId(1)].set(TickSide::Buy, 1000, 1);
+    BOOST_CHECK(checkpointer.capture(ns(2), bestprice, books));
+    checkpointer.stop();
+    BOOST_CHECK_EQUAL(checkpointer.written(), 2);
+    BOOST_CHECK_EQUAL(checkpointer.skipped(), 0);
+
+    CheckpointReader reader(path);
+    BestPriceCache bestprice2;
+    L2BookCache books2;
+    BOOST_CHECK(reader.time()==ns(2));
+    BOOST_CHECK_EQUAL(reader.read(bestprice2), 100);
+    BOOST_CHECK_EQUAL(reader.read(books2), 100);
+    BOOST_CHECK_EQUAL(bestprice2.find(VenueInstrumentId(1))->bid_price(), 1000);
+    BOOST_CHECK_EQUAL(books2.find(VenueInstrumentId(1))->bids().size(), 1);
+    std::remove(path.c_str());
+}
+
+/// copy of caches on the caller thread and restore from mapped file
+BOOST_AUTO_TEST_CASE(Benchmark)
+{
+    constexpr std::size_t N = BENCH ? 100000 : 1000;
+    constexpr std::size_t Depth = 20;
+    BestPriceCache bestprice;
+    L2BookCache books;
+    fill(bestprice, books, N, Depth);
+    CheckpointWriter writer;
+    auto path = temp_path("checkpoint_bench");
+    maybe_bench("checkpoint_capture", BENCH, [&] {
+        writer.begin(ns(1));
+        writer.write(bestprice);
+        writer.write(books);
+    });
+    writer.finish();
+    writer.save(path);
+    std::size_t restored = 0;
+    maybe_bench("checkpoint_restore", BENCH, [&] {
+        BestPriceCache bestprice2;
+        L2BookCache books2;
+        CheckpointReader reader(path);
+        restored = reader.read(bestprice2) + reader.read(books2);
+    });
+    if(BENCH>0)
+        TOOLBOX_INFO << "checkpoint: "<<N<<" instruments, "<<writer.size()<<" bytes";
+    BOOST_CHECK_EQUAL(restored, 2*N);
+    CheckpointReader reader(path);
+    BestPriceCache bestprice2;
+    L2BookCache books2;
+    BOOST_CHECK_EQUAL(reader.read(bestprice2), N);
+    BOOST_CHECK_EQUAL(reader.read(books2), N);
+    std::size_t mismatches = 0;
+    for(auto& [id, book]: books) {
+        auto* book2 = books2.find(id);
+        mismatches += !book2 || !same(levels(book, TickSide::Buy), levels(*book2, TickSide::Buy))
+            || !same(levels(book, TickSide::Sell), levels(*book2, TickSide::Sell));
+        auto* bp2 = bestprice2.find(id);
+        mismatches += !bp2 || bp2->sequence()!=bestprice.find(id)->sequence();
+    }
+    BOOST_CHECK_EQUAL(mismatches, 0);
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
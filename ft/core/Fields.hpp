@@ -78,7 +78,19 @@ enum class Field: uint8_t {
     LastQty,
     LastTime,
     Event,
-    Topic
+    Topic,
+    // Statistics fields
+    OpenInterest,
+    BidTotal,
+    AskTotal,
+    HighLimit,
+    LowLimit,
+    // Book analytics
+    Spread,
+    MicroPrice,
+    Imbalance,
+    BidDepth,
+    AskDepth
 };
 
 inline std::ostream& operator<<(std::ostream& os, Field self) {
@@ -103,6 +115,16 @@ inline std::ostream& operator<<(std::ostream& os, Field self) {
         case Field::Side: return os << "Side";
         case Field::Event: return os <<"Event";
         case Field::Topic: return os <<"Topic";
+        case Field::OpenInterest: return os <<"OpenInterest";
+        case Field::BidTotal: return os <<"BidTotal";
+        case Field::AskTotal: return os <<"AskTotal";
+        case Field::HighLimit: return os <<"HighLimit";
+        case Field::LowLimit: return os <<"LowLimit";
+        case Field::Spread: return os <<"Spread";
+        case Field::MicroPrice: return os <<"MicroPrice";
+        case Field::Imbalance: return os <<"Imbalance";
+        case Field::BidDepth: return os <<"BidDepth";
+        case Field::AskDepth: return os <<"AskDepth";
         case Field::Empty: return os <<"<empty>";
         default: return os << "F"<<(std::size_t)toolbox::unbox(self);
     }
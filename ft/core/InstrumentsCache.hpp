@@ -23,9 +23,19 @@ public:
     void update(const core::InstrumentUpdate& val) { 
         auto id = val.venue_instrument_id();
         auto &ins = instruments_[id];
-        ins.instrument().symbol(strpool_.intern(val.symbol()));
+        auto symbol = strpool_.intern(val.symbol());
+        ins.instrument().symbol(symbol);
         ins.exchange(strpool_.intern(val.exchange()));
         ins.instrument_id(val.instrument_id());
+        ins.venue_instrument_id(id);
+        symbols_[symbol] = id;
+    }
+    /// @returns instrument by its symbol or nullptr if it is not known yet
+    core::VenueInstrument* find(std::string_view symbol) {
+        auto it = symbols_.find(symbol);
+        if(it==symbols_.end())
+            return nullptr;
+        return &instruments_[it->second];
     }
     template<typename GatewayT>
     void connect(GatewayT &gw) {
@@ -46,6 +56,7 @@ public:
     }
 private:
     ft::unordered_map<VenueInstrumentId, core::VenueInstrument> instruments_;
+    ft::unordered_map<std::string_view, VenueInstrumentId> symbols_;   // keys are interned in strpool_
     tb::InternedStrings strpool_;
 };
 
@@ -0,0 +1,242 @@
+#pragma once
+
+#include "ft/core/Tick.hpp"
+#include "ft/core/Fields.hpp"
+#include "ft/utils/Common.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <ostream>
+#include <vector>
+
+namespace ft { inline namespace core {
+
+/// Aggregated price levels of one instrument.
+/// Levels of each side are kept sorted in contiguous array from the worst to the best one,
+/// so updates near the top of the book move only a few levels and the best one is the last.
+/// Levels are reserved up front, update path allocates only when a side grows deeper than that.
+class L2Book {
+public:
+    using Side = core::TickSide;
+    using Levels = std::vector<PriceQty>;
+
+    /// levels of side from the best one, valid until the next update
+    class LevelsView {
+    public:
+        using iterator = std::reverse_iterator<const PriceQty*>;
+        LevelsView() = default;
+        LevelsView(const PriceQty* begin, const PriceQty* end)
+        : begin_(begin), end_(end) {}
+        iterator begin() const { return iterator(end_); }
+        iterator end() const { return iterator(begin_); }
+        std::size_t size() const { return end_ - begin_; }
+        bool empty() const { return begin_==end_; }
+        /// level i from the best one
+        const PriceQty& operator[](std::size_t i) const { return *(end_ - 1 - i); }
+    private:
+        const PriceQty* begin_ {};
+        const PriceQty* end_ {};
+    };
+
+    /// what set() did to level
+    struct Change {
+        std::size_t index {0};  // from the best level
+        Qty prev {0};           // 0 if level was inserted
+        Qty qty {0};            // 0 if level was removed
+    };
+
+    explicit L2Book(std::size_t depth = 64) {
+        for(auto& levels: levels_)
+            levels.reserve(depth);
+    }
+
+    VenueInstrumentId venue_instrument_id() const { return venue_instrument_id_; }
+    void venue_instrument_id(VenueInstrumentId val) { venue_instrument_id_ = val; }
+    Timestamp send_time() const { return send_time_; }
+    void send_time(Timestamp val) { send_time_ = val; }
+    Timestamp recv_time() const { return recv_time_; }
+    void recv_time(Timestamp val) { recv_time_ = val; }
+
+    LevelsView levels(Side side) const {
+        auto& levels = levels_[index(side)];
+        return {levels.data(), levels.data() + levels.size()};
+    }
+    LevelsView bids() const { return levels(Side::Buy); }
+    LevelsView asks() const { return levels(Side::Sell); }
+    /// best level or nullptr if side is empty
+    const PriceQty* best(Side side) const {
+        auto& levels = levels_[index(side)];
+        return levels.empty() ? nullptr : &levels.back();
+    }
+    bool empty() const { return levels_[0].empty() && levels_[1].empty(); }
+
+    /// applies element to level of its price: Add and Modify set qty of level, Delete removes it,
+    /// Clear removes levels of side or both sides when side is Empty. Other events are ignored.
+    template<class ElementT>
+    void update(const ElementT& e) {
+        switch(e.event()) {
+            case TickEvent::Add:
+            case TickEvent::Modify:
+                set(e.side(), e.price(), e.qty());
+                break;
+            case TickEvent::Delete:
+                set(e.side(), e.price(), 0);
+                break;
+            case TickEvent::Clear:
+                clear(e.side());
+                break;
+            default:
+                break;
+        }
+    }
+
+    /// applies element to level by its index from the best one, for protocols maintaining levels by index:
+    /// Add inserts level pushing deeper ones down, Delete removes it pulling deeper ones up, Modify overwrites it.
+    /// Levels deeper than max_depth (if not 0) are dropped.
+    template<class ElementT>
+    void update_level(const ElementT& e, std::size_t max_depth = 0) {
+        if(e.event()==TickEvent::Clear) {
+            clear(e.side());
+            return;
+        }
+        if(e.side()!=Side::Buy && e.side()!=Side::Sell)
+            return;
+        auto& levels = levels_[index(e.side())];
+        std::size_t i = e.level();
+        switch(e.event()) {
+            case TickEvent::Add: {
+                auto pos = levels.end() - std::min(i, levels.size());
+                levels.insert(pos, PriceQty{e.price(), e.qty()});
+                if(max_depth && levels.size() > max_depth)
+                    levels.erase(levels.begin(), levels.end() - max_depth);
+            } break;
+            case TickEvent::Modify:
+                if(i < levels.size())
+                    levels[levels.size() - 1 - i] = PriceQty{e.price(), e.qty()};
+                break;
+            case TickEvent::Delete:
+                if(i < levels.size())
+                    levels.erase(levels.end() - 1 - i);
+                break;
+            default:
+                break;
+        }
+    }
+
+    /// sets qty of price level, 0 removes it
+    Change set(Side side, Price price, Qty qty) {
+        if(side!=Side::Buy && side!=Side::Sell)
+            return {};
+        auto& levels = levels_[index(side)];
+        // scan from the best level since most updates are near the top, worse prices are first
+        auto sign = (ssize_t)side;
+        auto it = levels.end();
+        while(it!=levels.begin() && sign*(std::prev(it)->price - price) > 0)
+            --it;
+        if(it!=levels.begin() && std::prev(it)->price==price)
+            --it;
+        bool found = it!=levels.end() && it->price==price;
+        Change change {static_cast<std::size_t>(levels.end() - it) - found, found ? it->qty : 0, qty};
+        if(qty==0) {
+            if(found)
+                levels.erase(it);
+        } else if(found) {
+            it->qty = qty;
+        } else {
+            levels.insert(it, PriceQty{price, qty});
+        }
+        return change;
+    }
+    /// replaces levels of side, given from the worst level to the best one
+    void assign(Side side, const PriceQty* begin, const PriceQty* end) {
+        if(side!=Side::Buy && side!=Side::Sell)
+            return;
+        levels_[index(side)].assign(begin, end);
+    }
+    void clear(Side side = Side::Empty) {
+        if(side!=Side::Sell)
+            levels_[0].clear();
+        if(side!=Side::Buy)
+            levels_[1].clear();
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const L2Book& self) {
+        os << "t:'L2Book', asks:[";
+        auto asks = self.asks();
+        for(std::size_t i = asks.size(); i-- > 0;)
+            os << (i+1<asks.size() ? ", " : "") << asks[i].price << ":" << asks[i].qty;
+        os << "], bids:[";
+        const char* sep = "";
+        for(auto& l: self.bids()) {
+            os << sep << l.price << ":" << l.qty;
+            sep = ", ";
+        }
+        return os << "]";
+    }
+private:
+    /// Buy => 0, Sell => 1
+    static std::size_t index(Side side) { return side==Side::Sell; }
+private:
+    VenueInstrumentId venue_instrument_id_ {};
+    Timestamp send_time_ {};
+    Timestamp recv_time_ {};
+    Levels levels_[2];  // bids, asks; worst level first
+};
+
+/// L2 books by venue instrument, kept next to BestPriceCache and updated by the same ticks
+class L2BookCache {
+public:
+    /// levels reserved for each side of a new book
+    explicit L2BookCache(std::size_t depth = 64)
+    : depth_(depth) {}
+
+    L2Book& operator[](VenueInstrumentId id) {
+        auto it = data_.find(id);
+        if(it==data_.end())
+            it = data_.emplace(id, L2Book(depth_)).first;
+        return it->second;
+    }
+    /// @returns book or nullptr if nothing was received for the instrument
+    const L2Book* find(VenueInstrumentId id) const {
+        auto it = data_.find(id);
+        if(it==data_.end())
+            return nullptr;
+        return &it->second;
+    }
+
+    /// updates levels by price
+    template<class TickT>
+    L2Book& update(const TickT& tick) {
+        auto& book = prepare(tick);
+        for(std::size_t i=0; i<tick.size(); i++)
+            book.update(tick[i]);
+        return book;
+    }
+    /// updates levels by their index, see L2Book::update_level
+    template<class TickT>
+    L2Book& update_levels(const TickT& tick, std::size_t max_depth = 0) {
+        auto& book = prepare(tick);
+        for(std::size_t i=0; i<tick.size(); i++)
+            book.update_level(tick[i], max_depth);
+        return book;
+    }
+    std::size_t size() const { return data_.size(); }
+    auto begin() const { return data_.begin(); }
+    auto end() const { return data_.end(); }
+    void clear() { data_.clear(); }
+private:
+    template<class TickT>
+    L2Book& prepare(const TickT& tick) {
+        auto id = tick.venue_instrument_id();
+        auto& book = (*this)[id];
+        book.venue_instrument_id(id);
+        book.send_time(tick.send_time());
+        book.recv_time(tick.recv_time());
+        return book;
+    }
+private:
+    std::size_t depth_;
+    ft::unordered_map<VenueInstrumentId, L2Book> data_;
+};
+
+}} // ft::core
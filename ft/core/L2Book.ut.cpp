@@ -0,0 +1,159 @@
+#include "L2Book.hpp"
+#include "ft/utils/UnitTest.hpp"
+#include "toolbox/sys/Log.hpp"
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace ft;
+using namespace ft::core;
+
+namespace {
+
+constexpr std::size_t BENCH = 0;
+
+TickElement element(TickEvent event, TickSide side, Price price, Qty qty, std::size_t level=0) {
+    TickElement e {};
+    e.event(event);
+    e.side(side);
+    e.price(price);
+    e.qty(qty);
+    e.level(level);
+    return e;
+}
+
+std::vector<Price> prices(L2Book::LevelsView view) {
+    std::vector<Price> result;
+    for(auto& l: view)
+        result.push_back(l.price);
+    return result;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(L2BookSuite)
+
+BOOST_AUTO_TEST_CASE(ByPrice)
+{
+    L2Book book;
+    book.update(element(TickEvent::Add, TickSide::Buy, 100, 10));
+    book.update(element(TickEvent::Add, TickSide::Buy, 102, 5));
+    book.update(element(TickEvent::Add, TickSide::Buy, 101, 7));
+    book.update(element(TickEvent::Add, TickSide::Sell, 105, 1));
+    book.update(element(TickEvent::Add, TickSide::Sell, 103, 2));
+    BOOST_CHECK(prices(book.bids())==(std::vector<Price>{102, 101, 100}));
+    BOOST_CHECK(prices(book.asks())==(std::vector<Price>{103, 105}));
+    BOOST_CHECK_EQUAL(book.best(TickSide::Buy)->price, 102);
+    BOOST_CHECK_EQUAL(book.asks()[1].qty, 1);
+
+    book.update(element(TickEvent::Modify, TickSide::Buy, 101, 8));
+    BOOST_CHECK_EQUAL(book.bids()[1].qty, 8);
+    book.update(element(TickEvent::Delete, TickSide::Buy, 102, 0));
+    book.update(element(TickEvent::Modify, TickSide::Sell, 103, 0));    // zero qty removes level
+    book.update(element(TickEvent::Delete, TickSide::Sell, 104, 0));    // unknown level
+    book.update(element(TickEvent::Fill, TickSide::Sell, 105, 1));      // not a level update
+    BOOST_CHECK(prices(book.bids())==(std::vector<Price>{101, 100}));
+    BOOST_CHECK(prices(book.asks())==(std::vector<Price>{105}));
+    BOOST_CHECK_EQUAL(book.best(TickSide::Sell)->qty, 1);
+
+    book.update(element(TickEvent::Clear, TickSide::Buy, 0, 0));
+    BOOST_CHECK(book.bids().empty());
+    BOOST_CHECK(book.best(TickSide::Buy)==nullptr);
+    BOOST_CHECK_EQUAL(book.asks().size(), 1);
+    book.update(element(TickEvent::Clear, TickSide::Empty, 0, 0));
+    BOOST_CHECK(book.empty());
+}
+
+BOOST_AUTO_TEST_CASE(ByLevel)
+{
+    L2Book book;
+    book.update_level(element(TickEvent::Add, TickSide::Sell, 101, 1, 0), 3);
+    book.update_level(element(TickEvent::Add, TickSide::Sell, 103, 3, 1), 3);
+    book.update_level(element(TickEvent::Add, TickSide::Sell, 102, 2, 1), 3);
+    BOOST_CHECK(prices(book.asks())==(std::vector<Price>{101, 102, 103}));
+    // new best pushes the deepest level out
+    book.update_level(element(TickEvent::Add, TickSide::Sell, 100, 5, 0), 3);
+    BOOST_CHECK(prices(book.asks())==(std::vector<Price>{100, 101, 102}));
+    book.update_level(element(TickEvent::Modify, TickSide::Sell, 101, 4, 1), 3);
+    BOOST_CHECK_EQUAL(book.asks()[1].qty, 4);
+    book.update_level(element(TickEvent::Delete, TickSide::Sell, 100, 0, 0), 3);
+    BOOST_CHECK(prices(book.asks())==(std::vector<Price>{101, 102}));
+    book.update_level(element(TickEvent::Delete, TickSide::Sell, 0, 0, 5), 3);   // out of range
+    book.update_level(element(TickEvent::Add, TickSide::Sell, 110, 1, 9), 3);    // appended as the deepest
+    BOOST_CHECK(prices(book.asks())==(std::vector<Price>{101, 102, 110}));
+    BOOST_CHECK(book.bids().empty());
+}
+
+BOOST_AUTO_TEST_CASE(Cache)
+{
+    L2BookCache cache;
+    Ticks<4> ti {};
+    ti.venue_instrument_id(VenueInstrumentId(7));
+    ti.event(Event::Update);
+    ti[0] = element(TickEvent::Add, TickSide::Buy, 100, 10);
+    ti[1] = element(TickEvent::Add, TickSide::Sell, 101, 3);
+    ti[2] = element(TickEvent::Add, TickSide::Buy, 99, 4);
+    ti.resize(3);
+    auto& book = cache.update(ti.as_size<1>());
+    BOOST_CHECK_EQUAL(book.venue_instrument_id(), VenueInstrumentId(7));
+    BOOST_CHECK(cache.find(VenueInstrumentId(8))==nullptr);
+    auto* found = cache.find(VenueInstrumentId(7));
+    BOOST_REQUIRE(found);
+    BOOST_CHECK(prices(found->bids())==(std::vector<Price>{100, 99}));
+    BOOST_CHECK_EQUAL(found->best(TickSide::Sell)->qty, 3);
+    BOOST_CHECK_EQUAL(cache.size(), 1);
+}
+
+/// random level updates near the top of the book checked against std::map
+BOOST_AUTO_TEST_CASE(Benchmark)
+{
+    constexpr std::size_t N = BENCH ? 10000000 : 100000;
+    std::vector<TickElement> updates;
+    updates.reserve(N);
+    std::mt19937_64 gen(1);
+    std::map<Price, Qty, std::greater<Price>> bids;
+    std::map<Price, Qty> asks;
+    for(std::size_t i=0; i<N; i++) {
+        bool buy = gen() & 1;
+        // closer to the top is more frequent
+        Price depth = (gen()%8) * (gen()%8);
+        Price price = buy ? 1000 - depth : 1001 + depth;
+        Qty qty = (gen()%4) ? 1 + gen()%100 : 0;
+        auto side = buy ? TickSide::Buy : TickSide::Sell;
+        updates.push_back(element(qty ? TickEvent::Modify : TickEvent::Delete, side, price, qty));
+        auto set = [&](auto& levels) {
+            if(qty)
+                levels[price] = qty;
+            else
+                levels.erase(price);
+        };
+        buy ? set(bids) : set(asks);
+    }
+    L2Book book;
+    auto apply = [&] {
+        for(auto& e: updates)
+            book.update(e);
+    };
+    std::size_t runs = 0;
+    maybe_bench("l2book_update", BENCH, [&] {
+        apply();
+        runs++;
+    });
+    if(runs>1)
+        TOOLBOX_INFO << "l2book_update: "<<N<<" updates per iteration";
+    // levels are set to absolute qty, so replays end in the same book
+    auto check = [](auto view, auto& expected) {
+        BOOST_REQUIRE_EQUAL(view.size(), expected.size());
+        std::size_t i = 0;
+        for(auto& [price, qty]: expected) {
+            BOOST_CHECK_EQUAL(view[i].price, price);
+            BOOST_CHECK_EQUAL(view[i].qty, qty);
+            i++;
+        }
+    };
+    check(book.bids(), bids);
+    check(book.asks(), asks);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
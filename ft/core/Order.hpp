@@ -0,0 +1,169 @@
+#pragma once
+#include "ft/capi/ft-types.h"
+#include "ft/core/Fields.hpp"
+#include "ft/core/Identifiable.hpp"
+#include "ft/core/Requests.hpp"
+#include "ft/core/Stream.hpp"
+#include "ft/core/Tick.hpp"
+#include <cassert>
+#include <cstring>
+#include <ostream>
+#include <string_view>
+
+namespace ft { inline namespace core {
+
+enum class OrderEvent : ft_event_t {
+    Empty = 0,
+    Add = FT_ORDER_ADD,         // new order
+    Delete = FT_ORDER_DEL,      // cancel order
+    Modify = FT_ORDER_MOD       // replace price and qty of order
+};
+
+inline std::ostream& operator<<(std::ostream& os, const OrderEvent self) {
+    switch(self) {
+        case OrderEvent::Empty: return os << "Empty";
+        case OrderEvent::Add: return os << "Add";
+        case OrderEvent::Delete: return os << "Delete";
+        case OrderEvent::Modify: return os << "Modify";
+        default: return os << (int)tb::unbox(self);
+    }
+}
+
+#pragma pack(push, 1)
+
+using OrderId = Identifier;
+
+/// Order request, symbol follows fixed part of the message.
+/// Delete and Modify refer to the order by server order id or by client order id of the order in linked order id.
+template<std::size_t SymbolI=0>
+class BasicOrderRequest : public ft_order_t {
+    using Base = ft_order_t;
+public:
+    BasicOrderRequest() {
+        static_cast<Base&>(*this) = Base{};
+        topic(StreamTopic::OrderStatus);
+        update_hdr();
+    }
+
+    OrderEvent event() const { return OrderEvent(ft_hdr.ft_type.ft_event); }
+    void event(OrderEvent val) { ft_hdr.ft_type.ft_event = tb::unbox(val); }
+
+    StreamTopic topic() const { return StreamTopic(ft_hdr.ft_type.ft_topic); }
+    void topic(StreamTopic val) { ft_hdr.ft_type.ft_topic = tb::unbox(val); }
+
+    ft_seq_t sequence() const { return ft_hdr.ft_seq; }
+    void sequence(ft_seq_t val) { ft_hdr.ft_seq = val; }
+
+    Timestamp send_time() const { return Timestamp(tb::Nanos(ft_hdr.ft_send_time)); }
+    void send_time(Timestamp val) { ft_hdr.ft_send_time = val.time_since_epoch().count(); }
+
+    InstrumentId instrument_id() const { return ft_instrument_id; }
+    void instrument_id(InstrumentId val) { ft_instrument_id = val; }
+
+    OrderId client_order_id() const { return ft_client_order_id; }
+    void client_order_id(OrderId val) { ft_client_order_id = val; }
+    OrderId server_order_id() const { return ft_server_order_id; }
+    void server_order_id(OrderId val) { ft_server_order_id = val; }
+    /// client order id of the order to delete or modify
+    OrderId linked_order_id() const { return ft_linked_order_id; }
+    void linked_order_id(OrderId val) { ft_linked_order_id = val; }
+
+    TickSide side() const { return TickSide(ft_side); }
+    void side(TickSide val) { ft_side = tb::unbox(val); }
+    Price price() const { return ft_price; }
+    void price(Price val) { ft_price = val; }
+    Qty qty() const { return ft_qty; }
+    void qty(Qty val) { ft_qty = val; }
+
+    std::string_view symbol() const { return std::string_view(ft_symbol, ft_symbol_len); }
+    void symbol(std::string_view val) {
+        assert(val.size()<=SymbolI);
+        ft_symbol_len = val.size();
+        std::memcpy(ft_symbol, val.data(), val.size());
+    }
+
+    /// fixed part of the message
+    std::size_t length() const { return ft_hdr.ft_len; }
+    std::size_t bytesize() const { return ft_hdr.ft_len + ft_symbol_len; }
+    void update_hdr() { ft_hdr.ft_len = sizeof(Base); }
+
+    template<std::size_t NewSizeI>
+    const BasicOrderRequest<NewSizeI>& as_size() const {
+        return *reinterpret_cast<const BasicOrderRequest<NewSizeI>*>(this);
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const BasicOrderRequest& self) {
+        return os << "e:'"<<self.event()<<"', sym:'"<<self.symbol()<<"', iid:"<<self.instrument_id()
+            << ", coid:"<<self.client_order_id()<<", soid:"<<self.server_order_id()<<", loid:"<<self.linked_order_id()
+            << ", side:'"<<self.side()<<"', price:"<<self.price()<<", qty:"<<self.qty();
+    }
+private:
+    ft_char_t data_[SymbolI];
+};
+
+using OrderRequest = BasicOrderRequest<0>;
+
+/// Order status update, sent on each change of order: accepted, filled, canceled or request failed
+class Execution : public ft_execution_t {
+    using Base = ft_execution_t;
+public:
+    Execution() {
+        static_cast<Base&>(*this) = Base{};
+        topic(StreamTopic::OrderStatus);
+        ft_hdr.ft_len = sizeof(Base);
+    }
+
+    OrderStatusEvent status() const { return OrderStatusEvent(ft_hdr.ft_type.ft_event); }
+    void status(OrderStatusEvent val) { ft_hdr.ft_type.ft_event = tb::unbox(val); }
+
+    StreamTopic topic() const { return StreamTopic(ft_hdr.ft_type.ft_topic); }
+    void topic(StreamTopic val) { ft_hdr.ft_type.ft_topic = tb::unbox(val); }
+
+    ft_seq_t sequence() const { return ft_hdr.ft_seq; }
+    void sequence(ft_seq_t val) { ft_hdr.ft_seq = val; }
+
+    Timestamp send_time() const { return Timestamp(tb::Nanos(ft_hdr.ft_send_time)); }
+    void send_time(Timestamp val) { ft_hdr.ft_send_time = val.time_since_epoch().count(); }
+
+    InstrumentId instrument_id() const { return ft_instrument_id; }
+    void instrument_id(InstrumentId val) { ft_instrument_id = val; }
+
+    OrderId client_order_id() const { return ft_client_order_id; }
+    void client_order_id(OrderId val) { ft_client_order_id = val; }
+    OrderId server_order_id() const { return ft_server_order_id; }
+    void server_order_id(OrderId val) { ft_server_order_id = val; }
+    OrderId linked_order_id() const { return ft_linked_order_id; }
+    void linked_order_id(OrderId val) { ft_linked_order_id = val; }
+
+    TickSide side() const { return TickSide(ft_side); }
+    void side(TickSide val) { ft_side = tb::unbox(val); }
+    Price price() const { return ft_price; }
+    void price(Price val) { ft_price = val; }
+    /// qty still active in the book
+    Qty qty() const { return ft_qty; }
+    void qty(Qty val) { ft_qty = val; }
+    Qty orig_qty() const { return ft_orig_qty; }
+    void orig_qty(Qty val) { ft_orig_qty = val; }
+    /// qty of this fill, 0 if update is not a fill
+    Qty fill_qty() const { return ft_fill_qty; }
+    void fill_qty(Qty val) { ft_fill_qty = val; }
+    Identifier fill_id() const { return ft_fill_id; }
+    void fill_id(Identifier val) { ft_fill_id = val; }
+
+    /// exchange time of the change
+    Timestamp timestamp() const { return Timestamp(tb::Nanos(ft_timestamp)); }
+    void timestamp(Timestamp val) { ft_timestamp = val.time_since_epoch().count(); }
+
+    std::size_t bytesize() const { return ft_hdr.ft_len; }
+
+    friend std::ostream& operator<<(std::ostream& os, const Execution& self) {
+        return os << "e:'"<<self.status()<<"', iid:"<<self.instrument_id()
+            << ", coid:"<<self.client_order_id()<<", soid:"<<self.server_order_id()
+            << ", side:'"<<self.side()<<"', price:"<<self.price()<<", qty:"<<self.qty()
+            << ", orig_qty:"<<self.orig_qty()<<", fill_qty:"<<self.fill_qty()<<", fill_id:"<<self.fill_id();
+    }
+};
+
+#pragma pack(pop)
+
+}} // ft::core
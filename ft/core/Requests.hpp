@@ -128,7 +128,7 @@ public:
         std::memset(this, 0, sizeof(*this));
     }
     core::Status status() const { return core::Status(Base::ft_status);}
-    void status(core::Status val) const { return Base::ft_status = tb::unbox(val);}
+    void status(core::Status val) { Base::ft_status = tb::unbox(val);}
     core::Response response() const { return static_cast<core::Response>(Base::ft_hdr.ft_type.ft_event); } 
     void response(core::Response val) { Base::ft_hdr.ft_type.ft_event = tb::unbox(val); }
     String& message() { return *reinterpret_cast<String*>(&Base::ft_message_len); } 
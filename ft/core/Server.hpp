@@ -2,6 +2,7 @@
 #include "ft/utils/Common.hpp"
 #include "ft/core/Instrument.hpp"
 #include "ft/core/InstrumentsCache.hpp"
+#include "ft/core/BestPriceCache.hpp"
 #include "ft/core/Requests.hpp"
 #include "ft/core/Stream.hpp"
 #include "ft/core/StreamStats.hpp"
@@ -31,6 +32,12 @@ public:
 
     virtual void instruments_cache(core::InstrumentsCache* cache) = 0;
 
+    /// shared best prices used for snapshots on subscribe
+    virtual void bestprice_cache(core::BestPriceCache* cache) = 0;
+
+    /// reply to peer's request
+    virtual void async_write_to(PeerId peer, const core::StatusResponse& res, tb::SizeSlot done) = 0;
+
     /// typed slot
     template<typename...ArgsT>
     Stream::Slot<ArgsT...>& slot_of(StreamTopic topic) {
@@ -49,6 +56,11 @@ public:
     void shutdown(PeerId peer) override { impl()->shutdown(peer); }
 
     void instruments_cache(core::InstrumentsCache* cache) override { impl()->instruments_cache(cache); }
+    void bestprice_cache(core::BestPriceCache* cache) override { impl()->bestprice_cache(cache); }
+
+    void async_write_to(PeerId peer, const core::StatusResponse& res, tb::SizeSlot done) override {
+        impl()->async_write_to(peer, res, done);
+    }
 
     void url(std::string_view url) { impl()->url(url);}
     std::string_view url() const { return impl()->url(); }
@@ -0,0 +1,89 @@
+#pragma once
+#include "ft/core/StreamStats.hpp"
+#include "toolbox/sys/Log.hpp"
+#include "toolbox/sys/Time.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ft { inline namespace core {
+
+/// Logs stats periodically from its own thread, so packet path never checks clock or formats output.
+/// Sources are invoked from reporter thread and should only read Counter values.
+class StatsReporter {
+public:
+    using Source = std::function<void(std::ostream&)>;
+    static constexpr tb::Duration DefaultInterval = std::chrono::seconds(10);
+
+    StatsReporter() = default;
+    StatsReporter(const StatsReporter&) = delete;
+    StatsReporter& operator=(const StatsReporter&) = delete;
+    ~StatsReporter() { stop(); }
+
+    void interval(tb::Duration val) { interval_ = val; }
+    tb::Duration interval() const { return interval_; }
+
+    /// sources should be added before start()
+    void add(std::string name, Source source) {
+        sources_.push_back({std::move(name), std::move(source)});
+    }
+    void add(std::string name, const StreamStats& stats) {
+        add(std::move(name), [&stats](std::ostream& os) { os << stats; });
+    }
+    void clear() {
+        stop();
+        sources_.clear();
+    }
+
+    void start() {
+        stop();
+        stop_ = false;
+        thread_ = std::thread([this] { run(); });
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cond_.notify_all();
+        if(thread_.joinable())
+            thread_.join();
+    }
+
+    /// one line per source
+    void report(std::ostream& os) const {
+        for(auto& s: sources_) {
+            os << s.name << ": ";
+            s.source(os);
+            os << std::endl;
+        }
+    }
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while(!cond_.wait_for(lock, interval_, [this] { return stop_; })) {
+            std::stringstream ss;
+            report(ss);
+            TOOLBOX_INFO << ss.str();
+        }
+    }
+private:
+    struct Entry {
+        std::string name;
+        Source source;
+    };
+    std::vector<Entry> sources_;
+    tb::Duration interval_ {DefaultInterval};
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stop_ {false};
+};
+
+}} // ft::core
@@ -0,0 +1,65 @@
+#include "StatsReporter.hpp"
+#include "ft/utils/UnitTest.hpp"
+#include <chrono>
+#include <sstream>
+
+using namespace ft;
+
+namespace {
+
+constexpr std::size_t BENCH = 0;
+
+}
+
+BOOST_AUTO_TEST_SUITE(StatsReporterSuite)
+
+BOOST_AUTO_TEST_CASE(Report)
+{
+    Counter read;
+    StreamStats stats;
+    StatsReporter reporter;
+    reporter.add("read", [&read](std::ostream& os) { os << read.load(); });
+    reporter.add("stream", stats);
+    read += 3;
+    stats.on_received();
+    stats.on_rejected();
+    std::stringstream ss;
+    reporter.report(ss);
+    BOOST_CHECK_EQUAL(ss.str(), "read: 3\nstream: received:1,rejected:1\n");
+
+    // stop does not wait for the next report
+    reporter.interval(std::chrono::hours(1));
+    reporter.start();
+    auto start = std::chrono::steady_clock::now();
+    reporter.stop();
+    BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+}
+
+/// packet path only increments counters while reporter thread reads and logs them
+BOOST_AUTO_TEST_CASE(Benchmark)
+{
+    constexpr std::size_t N = BENCH ? 100000000 : 1000000;
+    Counter read;
+    StreamStats stats;
+    StatsReporter reporter;
+    reporter.interval(std::chrono::milliseconds(BENCH ? 1000 : 1));
+    reporter.add("read", [&read](std::ostream& os) { os << read.load(); });
+    reporter.add("stream", stats);
+    reporter.start();
+    std::size_t runs = 0;
+    maybe_bench("stats_counters", BENCH, [&] {
+        for(std::size_t i=0; i<N; i++) {
+            read++;
+            stats.on_received();
+            if(i%64==0)
+                stats.on_rejected();
+        }
+        runs++;
+    });
+    reporter.stop();
+    BOOST_CHECK_EQUAL(read.load(), runs*N);
+    BOOST_CHECK_EQUAL(stats.received(), runs*N);
+    BOOST_CHECK_EQUAL(stats.rejected(), runs*((N + 63)/64));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -39,6 +39,8 @@ enum class StreamTopic: ft_topic_t {
     Empty = FT_TOPIC_EMPTY,
     BestPrice = FT_TOPIC_BESTPRICE,
     Instrument = FT_TOPIC_INSTRUMENT,
+    OrderStatus = FT_TOPIC_ORDERSTATUS,
+    Statistics = FT_TOPIC_STATISTICS,
     Candle = FT_TOPIC_CANDLE,
 };
 
@@ -48,6 +50,10 @@ inline constexpr StreamTopic topic_from_name(std::string_view s) {
         return StreamTopic::BestPrice;
     } else if(s=="Instrument") {
         return StreamTopic::Instrument;
+    } else if(s=="OrderStatus") {
+        return StreamTopic::OrderStatus;
+    } else if(s=="Statistics") {
+        return StreamTopic::Statistics;
     } else  {
         return StreamTopic::Empty;
     }
@@ -56,6 +62,8 @@ inline constexpr const char* topic_to_name(const StreamTopic topic) {
     switch(topic) {
         case StreamTopic::BestPrice: return "BestPrice";
         case StreamTopic::Instrument: return "Instrument";
+        case StreamTopic::OrderStatus: return "OrderStatus";
+        case StreamTopic::Statistics: return "Statistics";
         case StreamTopic::Candle: return "Candle";
         case StreamTopic::Empty: return "Empty";
         default: return "Invalid";
@@ -66,6 +74,8 @@ inline std::ostream& operator<<(std::ostream& os, const StreamTopic self) {
     switch(self) {
         case StreamTopic::BestPrice:
         case StreamTopic::Instrument:
+        case StreamTopic::OrderStatus:
+        case StreamTopic::Statistics:
         case StreamTopic::Candle:
         case StreamTopic::Empty:
             return os << topic_to_name(self);
@@ -1,10 +1,33 @@
 #pragma once
 #include "ft/utils/Common.hpp"
-#include "ft/utils/Throttled.hpp"
+#include <atomic>
 #include <ostream>
 
 namespace ft { inline namespace core {
 
+/// Counter incremented by single thread and read by any thread.
+/// Increment is plain load and store, no locked instruction on the packet path.
+class Counter {
+public:
+    Counter(std::size_t val = 0): value_(val) {}
+    Counter(const Counter& rhs): value_(rhs.load()) {}
+    Counter& operator=(const Counter& rhs) { value_.store(rhs.load(), std::memory_order_relaxed); return *this; }
+
+    /// owner thread only
+    Counter& operator+=(std::size_t n) {
+        value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        return *this;
+    }
+    Counter& operator++() { return *this += 1; }
+    void operator++(int) { *this += 1; }
+
+    std::size_t load() const { return value_.load(std::memory_order_relaxed); }
+    operator std::size_t() const { return load(); }
+private:
+    std::atomic<std::size_t> value_;
+};
+
+/// counters are safe to read from reporting thread
 class StreamStats {
 public:
     template<typename...ArgsT>
@@ -35,10 +58,10 @@ public:
         os << *this;
     }
 protected:
-    std::size_t received_{0};
-    std::size_t accepted_{0};
-    std::size_t rejected_{0}; // rejected on bad format
-    std::size_t gaps_{};
+    Counter received_{0};
+    Counter accepted_{0};
+    Counter rejected_{0}; // rejected on bad format
+    Counter gaps_{};
 };
 
 
@@ -51,19 +74,12 @@ class BasicStats : public core::StreamStats {
 public:
     static constexpr bool enabled() { return true; }
 
-    BasicStats() {
-        auto dur = 
-        #ifdef TOOLBOX_DEBUG        
-            toolbox::Seconds(10);
-        #else
-            toolbox::Hours(1);
-        #endif
-        report_.set_interval(dur);
-    }
-
+    /// counters and detailed stats, owner thread only
     void report(std::ostream& os) {
-        if constexpr(DerivedT::enabled())
-            report_(os);
+        if constexpr(DerivedT::enabled()) {
+            os << static_cast<const StreamStats&>(*this) << std::endl;
+            static_cast<DerivedT*>(this)->on_report(os);
+        }
     }
     template<typename T>
     void on_received(const T& packet) { 
@@ -75,11 +91,6 @@ public:
         if constexpr(DerivedT::enabled())
             accepted_++;
     }*/
-    void on_idle() {
-        report(std::cerr);
-    }
-protected:
-    ft::Throttled<toolbox::Slot<std::ostream&>> report_{ toolbox::bind<&DerivedT::on_report>(static_cast<DerivedT*>(this)) };
 };
 
 
@@ -28,9 +28,21 @@ enum class OrderStatusEvent : ft_event_t {
     New   = FT_ORDER_STATUS_NEW,
     Filled = FT_ORDER_STATUS_FILLED,
     PartFilled = FT_ORDER_STATUS_PART_FILLED,
-    Canceled = FT_ORDER_STATUS_CANCELED
+    Canceled = FT_ORDER_STATUS_CANCELED,
+    Failed = FT_ORDER_STATUS_FAILED         // rejected request
 };
 
+inline std::ostream& operator<<(std::ostream& os, const OrderStatusEvent self) {
+    switch(self) {
+        case OrderStatusEvent::New: return os << "New";
+        case OrderStatusEvent::Filled: return os << "Filled";
+        case OrderStatusEvent::PartFilled: return os << "PartFilled";
+        case OrderStatusEvent::Canceled: return os << "Canceled";
+        case OrderStatusEvent::Failed: return os << "Failed";
+        default: return os << (int)tb::unbox(self);
+    }
+}
+
 enum class TickEvent : ft_event_t {
     Empty = 0,
     Add = FT_TICK_ADD,
@@ -105,9 +117,17 @@ public:
 
     bool empty() { return event()==TickEvent::Empty; }
 
+    // L2: index of level from the best one, for protocols updating levels by index
+    std::size_t level() const { return ft_level; }
+    auto& level(std::size_t val) { ft_level = val; return *this; }
+
     // order
     ExchangeId server_id() const { return ft_server_id; }   // to be made up to 64 byte len?
     auto& server_id(ExchangeId val) { ft_server_id = val; return *this; }
+
+    // statistics: which value is carried in price() or qty()
+    Field field() const { return Field(ft_flags); }
+    auto& field(Field val) { ft_flags = tb::unbox(val); return *this; }
 };
 
 struct TickElement : BasicTickElement<TickPolicy> {
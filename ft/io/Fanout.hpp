@@ -0,0 +1,248 @@
+#pragma once
+#include "ft/utils/Common.hpp"
+#include "ft/utils/SpmcRing.hpp"
+#include "ft/core/Identifiable.hpp"
+#include "ft/core/Parameters.hpp"
+#include "toolbox/io/Buffer.hpp"
+#include "toolbox/sys/Log.hpp"
+#include "toolbox/sys/Time.hpp"
+#include "toolbox/util/Slot.hpp"
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sys/socket.h>
+
+namespace ft::io {
+
+/// encoded datagram published by reactor thread
+struct FanoutMessage {
+    static constexpr std::size_t MaxSize = 1472;    // udp payload of 1500 bytes ethernet frame
+    std::int64_t time;                              // mono time of publishing, ns
+    std::uint32_t size;
+    char data[MaxSize];
+};
+
+/// Sends published datagrams to peers from worker threads.
+/// Reactor thread encodes message once and publishes it into lock-free ring,
+/// each worker reads every message and sends it to its own subset of peers.
+template<class EndpointT, std::size_t CapacityI=1024>
+class BasicFanout {
+public:
+    using Endpoint = EndpointT;
+    using Ring = SpmcRing<FanoutMessage, CapacityI>;
+
+    /// where to send
+    struct Target {
+        PeerId id;
+        int fd;
+        Endpoint remote;
+    };
+
+    class Worker {
+    public:
+        Worker(Ring& ring, std::size_t index, int cpu)
+        : ring_(ring)
+        , index_(index)
+        , cpu_(cpu) {}
+
+        void start() {
+            running_ = true;
+            thread_ = std::thread([this] { run(); });
+        }
+        void stop() {
+            running_ = false;
+            if(thread_.joinable())
+                thread_.join();
+        }
+
+        void add(const Target& target) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            targets_.push_back(target);
+            version_++;
+        }
+        bool remove(PeerId id) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = std::find_if(targets_.begin(), targets_.end(), [id](auto& t) { return t.id==id; });
+            if(it==targets_.end())
+                return false;
+            targets_.erase(it);
+            version_++;
+            return true;
+        }
+        std::size_t size() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return targets_.size();
+        }
+
+        std::size_t index() const { return index_; }
+        int cpu() const { return cpu_; }
+        std::uint64_t sent() const { return sent_.load(std::memory_order_relaxed); }
+        std::uint64_t errors() const { return errors_.load(std::memory_order_relaxed); }
+        std::uint64_t overruns() const { return overruns_.load(std::memory_order_relaxed); }
+        /// publish-to-send latency of last message
+        tb::Duration lag() const { return tb::Nanos(lag_.load(std::memory_order_relaxed)); }
+        /// worst lag since last call
+        tb::Duration reset_max_lag() { return tb::Nanos(max_lag_.exchange(0, std::memory_order_relaxed)); }
+
+        /// messages per second since previous call (reporter thread only)
+        double rate(tb::MonoTime now) {
+            auto sent = this->sent();
+            auto dt = std::chrono::duration<double>(now - last_time_).count();
+            double result = (last_time_ != tb::MonoTime{} && dt>0) ? (sent - last_sent_)/dt : 0.;
+            last_sent_ = sent;
+            last_time_ = now;
+            return result;
+        }
+    private:
+        void run() {
+            if(cpu_>=0) {
+                cpu_set_t cpuset;
+                CPU_ZERO(&cpuset);
+                CPU_SET(cpu_, &cpuset);
+                int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+                if(rc!=0)
+                    TOOLBOX_ERROR << "fanout worker "<<index_<<": could not set affinity to cpu "<<cpu_<<", ec:"<<rc;
+            }
+            auto cursor = ring_.cursor();
+            std::vector<Target> targets;
+            std::uint64_t version = 0;
+            FanoutMessage msg;
+            while(running_.load(std::memory_order_relaxed)) {
+                auto v = version_.load(std::memory_order_acquire);
+                if(v != version) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    targets = targets_;
+                    version = version_.load(std::memory_order_relaxed);
+                }
+                if(!ring_.pop(cursor, msg)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                for(auto& t: targets) {
+                    auto n = ::sendto(t.fd, msg.data, msg.size, 0, t.remote.data(), t.remote.size());
+                    if(n<0)
+                        errors_.fetch_add(1, std::memory_order_relaxed);
+                    else
+                        sent_.fetch_add(1, std::memory_order_relaxed);
+                }
+                auto lag = tb::MonoClock::now().time_since_epoch().count() - msg.time;
+                lag_.store(lag, std::memory_order_relaxed);
+                if(lag > max_lag_.load(std::memory_order_relaxed))
+                    max_lag_.store(lag, std::memory_order_relaxed);
+                overruns_.store(cursor.overruns, std::memory_order_relaxed);
+            }
+        }
+    private:
+        Ring& ring_;
+        std::size_t index_;
+        int cpu_ {-1};
+        std::thread thread_;
+        std::atomic<bool> running_ {false};
+        mutable std::mutex mutex_;
+        std::vector<Target> targets_;
+        std::atomic<std::uint64_t> version_ {0};
+        // written by worker
+        std::atomic<std::uint64_t> sent_ {0};
+        std::atomic<std::uint64_t> errors_ {0};
+        std::atomic<std::uint64_t> overruns_ {0};
+        std::atomic<std::int64_t> lag_ {0};
+        std::atomic<std::int64_t> max_lag_ {0};
+        // reporter
+        std::uint64_t last_sent_ {0};
+        tb::MonoTime last_time_ {};
+    };
+public:
+    BasicFanout() = default;
+    ~BasicFanout() { stop(); }
+
+    /// "workers": number of sender threads, "cpus": [cpu for each worker]
+    void configure(const core::Parameters& params) {
+        assert(!is_open());
+        std::size_t count = params.value_or("workers", 0);
+        std::vector<int> cpus;
+        if(params.find("cpus")!=params.end())
+            params["cpus"].copy(cpus);
+        workers_.clear();
+        for(std::size_t i=0; i<count; i++) {
+            int cpu = i<cpus.size() ? cpus[i] : -1;
+            workers_.push_back(std::make_unique<Worker>(ring_, i, cpu));
+        }
+    }
+
+    /// fanout is addressed as a peer with empty id
+    PeerId id() const { return {}; }
+
+    bool enabled() const { return !workers_.empty(); }
+    bool is_open() const { return open_; }
+
+    void start() {
+        for(auto& w: workers_)
+            w->start();
+        open_ = true;
+        TOOLBOX_INFO << "fanout started "<<workers_.size()<<" workers";
+    }
+    void stop() {
+        open_ = false;
+        for(auto& w: workers_)
+            w->stop();
+    }
+
+    /// assign peer to the least loaded worker
+    void add_peer(PeerId id, int fd, const Endpoint& remote) {
+        if(workers_.empty())
+            return;
+        auto it = std::min_element(workers_.begin(), workers_.end(), [](auto& lhs, auto& rhs) {
+            return lhs->size() < rhs->size();
+        });
+        (*it)->add(Target{id, fd, remote});
+    }
+    void remove_peer(PeerId id) {
+        for(auto& w: workers_) {
+            if(w->remove(id))
+                break;
+        }
+    }
+
+    /// publish encoded datagram, workers will send it to their peers
+    void async_write(tb::ConstBuffer buf, tb::SizeSlot done) {
+        if(buf.size() > FanoutMessage::MaxSize) {
+            TOOLBOX_ERROR << "fanout: message of "<<buf.size()<<" bytes exceeds "<<FanoutMessage::MaxSize;
+            done(-1, std::make_error_code(std::errc::message_size));
+            return;
+        }
+        ring_.push([&](FanoutMessage& msg) {
+            msg.time = tb::MonoClock::now().time_since_epoch().count();
+            msg.size = buf.size();
+            std::memcpy(msg.data, buf.data(), buf.size());
+        });
+        done(buf.size(), {});
+    }
+
+    /// per-worker send rate and lag
+    void report(std::ostream& os) {
+        auto now = tb::MonoClock::now();
+        os << "fanout published:"<<ring_.head();
+        for(auto& w: workers_) {
+            os << "\n  worker "<<w->index()<<" cpu:"<<w->cpu()<<" peers:"<<w->size()
+               <<" sent:"<<w->sent()<<" rate:"<<std::fixed<<std::setprecision(1)<<w->rate(now)<<"/s"
+               <<" lag:"<<std::chrono::duration_cast<tb::Micros>(w->lag()).count()<<"us"
+               <<" max_lag:"<<std::chrono::duration_cast<tb::Micros>(w->reset_max_lag()).count()<<"us";
+            if(w->overruns()>0)
+                os <<" overruns:"<<w->overruns();
+            if(w->errors()>0)
+                os <<" errors:"<<w->errors();
+        }
+    }
+protected:
+    Ring ring_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    bool open_ {false};
+};
+
+} // ft::io
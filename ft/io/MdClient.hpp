@@ -5,6 +5,7 @@
 #include "ft/core/Parameters.hpp"
 #include "ft/core/Component.hpp"
 #include "ft/core/Client.hpp"
+#include "ft/core/StatsReporter.hpp"
 #include "toolbox/io/Socket.hpp"
 #include "toolbox/net/EndpointFilter.hpp"
 
@@ -19,6 +20,7 @@
 #include "ft/core/Instrument.hpp"
 
 #include <boost/mp11/detail/mp_list.hpp>
+#include <chrono>
 #include <stdexcept>
 #include <string_view>
 #include <system_error>
@@ -64,9 +66,11 @@ public:
         Base::do_open();
         IdleTimer::open();
         Protocol::open();
+        start_reporter();
     }
 
     void do_close() {
+        reporter_.stop();
         Protocol::close();
         IdleTimer::close();
         Base::do_close();
@@ -76,6 +80,7 @@ public:
         Base::on_parameters_updated(params);        
         Protocol::on_parameters_updated(params);
         IdleTimer::on_parameters_updated(params);
+        reporter_.interval(std::chrono::seconds(params.value_or("report_interval_s", 10)));
     }
 
     void on_idle() {
@@ -84,7 +89,14 @@ public:
         //TOOLBOX_INFO << ss.str();
     }
 protected:
-
+    /// decoder counters are logged by reporter thread, per-endpoint stats of live peers are not counted
+    void start_reporter() {
+        reporter_.clear();
+        reporter_.add(std::string(Protocol::name()), static_cast<const core::StreamStats&>(Protocol::stats()));
+        reporter_.start();
+    }
+protected:
+    core::StatsReporter reporter_;
     //Router router_{self()};
 }; // BasicMdClient
 
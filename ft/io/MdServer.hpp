@@ -17,6 +17,7 @@
 #include "toolbox/net/Endpoint.hpp"
 #include "ft/core/Client.hpp"
 #include "ft/io/Server.hpp"
+#include "ft/io/Fanout.hpp"
 #include "toolbox/util/Slot.hpp"
 namespace ft::io {
 
@@ -33,23 +34,86 @@ class BasicMdServer : public BasicServer<Self, PeerT, ServerSocketT, O...>
 public:
     using Base::Base;
     using typename Base::Peer;
+    using typename Base::Endpoint;
     using Protocol = ProtocolM<Self>;
+    using Fanout = BasicFanout<Endpoint>;
     
     using Base::open, Base::close, Base::do_open; // resolve ambiguity with Protocol::open
 
     void do_open() {
         Base::do_open();
         Protocol::open();
+        if(fanout_) {
+            using namespace std::literals::chrono_literals;
+            fanout_->start();
+            fanout_timer_ = self()->reactor()->timer(tb::MonoClock::now()+10s, 10s,
+                tb::Priority::Low, tb::bind([this](tb::CyclTime now, tb::Timer& timer) {
+                    std::stringstream ss;
+                    fanout_->report(ss);
+                    TOOLBOX_INFO << ss.str();
+            }));
+        }
     }
 
     void do_close() {
+        if(fanout_) {
+            fanout_timer_.cancel();
+            fanout_->stop();
+        }
         Protocol::close();
         Base::do_close();
     }
 
+    /// open server is closed first, so fanout workers and report timer are stopped before fanout is replaced
     void on_parameters_updated(const core::Parameters& params) {
-        Base::on_parameters_updated(params);        
+        auto was_open = self()->is_open();
+        if(was_open)
+            self()->close();
+        Base::on_parameters_updated(params);
         Protocol::on_parameters_updated(params);
+        fanout_.reset();
+        if(params.find("fanout")!=params.end()) {
+            fanout_ = std::make_unique<Fanout>();
+            fanout_->configure(params["fanout"]);
+            if(!fanout_->enabled()) {
+                fanout_.reset();
+            } else {
+                Base::for_each_peer([this](auto& peer) {
+                    fanout_->add_peer(peer.id(), peer.socket().get(), peer.remote());
+                });
+            }
+        }
+        if(was_open)
+            self()->open();
+    }
+
+    /// @returns nullptr if sending from reactor thread
+    Fanout* fanout() { return fanout_ && fanout_->is_open() ? fanout_.get() : nullptr; }
+
+    /// new peers are assigned to fanout workers
+    Peer& emplace_peer(std::unique_ptr<Peer> ptr) {
+        Peer& peer = Base::emplace_peer(std::move(ptr));
+        if(fanout_)
+            fanout_->add_peer(peer.id(), peer.socket().get(), peer.remote());
+        return peer;
+    }
+
+    bool shutdown(PeerId id) {
+        if(fanout_)
+            fanout_->remove_peer(id);
+        Protocol::on_peer_closed(id);
+        return Base::shutdown(id);
+    }
+
+    /// with fanout message is encoded once and sent to all peers by worker threads.
+    /// NOTE: per-peer routing is not applied by workers (as with FT_DEBUG_SUBSCRIBE_ALL_SYMBOLS)
+    template<typename MessageT>
+    void async_write(const MessageT& m, tb::SizeSlot done) {
+        if(fanout_ && fanout_->is_open()) {
+            Protocol::async_write_to(*fanout_, m, done);
+        } else {
+            Base::async_write(m, done);
+        }
     }
 
     void on_subscribe(Peer& peer, core::SubscriptionRequest& req) {
@@ -72,6 +136,17 @@ public:
       Protocol::async_write_to(peer, m, done);
     }
 
+    /// reply to the peer identified by id
+    void async_write_to(PeerId id, const core::StatusResponse& res, tb::SizeSlot done) {
+      Peer* peer = Base::get_peer(id);
+      if(!peer) {
+        TOOLBOX_ERROR<<"async_write_to: no such peer "<<id;
+        done(-1, std::make_error_code(std::errc::not_connected));
+        return;
+      }
+      Protocol::async_write_to(*peer, res, done);
+    }
+
     /// returns Stream::Slot
     core::Stream& slot(core::StreamTopic topic) { 
       switch(topic) {
@@ -98,6 +173,8 @@ protected:
     using Slot = typename Protocol::template Slot<T>;
     Slot<core::Tick> ticks_slot_{self()};
     Slot<core::InstrumentUpdate> instruments_slot_{self()};    
+    std::unique_ptr<Fanout> fanout_;
+    tb::Timer fanout_timer_;
 };
 
 
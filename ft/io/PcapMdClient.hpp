@@ -4,19 +4,32 @@
 #include "ft/core/Instrument.hpp"
 #include "ft/core/Parameters.hpp"
 #include "ft/core/StreamStats.hpp"
+#include "ft/io/PcapMerger.hpp"
+#include "ft/io/PcapReader.hpp"
 #include "ft/io/Protocol.hpp"
 #include "ft/utils/Common.hpp"
 #include "ft/utils/StringUtils.hpp"
 #include "ft/core/Client.hpp"
 
+#include "ft/utils/SpscQueue.hpp"
+
 #include "toolbox/net/Endpoint.hpp"
 #include "toolbox/net/EndpointFilter.hpp"
+#include "toolbox/net/Packet.hpp"
 #include "toolbox/net/Pcap.hpp"
 #include "toolbox/sys/Log.hpp"
 #include "toolbox/sys/Time.hpp"
 //#include <netinet/in.h>
 #include "ft/io/Service.hpp"
 #include "ft/core/EndpointStats.hpp"
+#include "ft/core/StatsReporter.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 namespace ft::io {
 
@@ -25,6 +38,55 @@ public:
     using Component::Component;
 };
 
+/// Maps capture timestamps to the monotonic time packets are due,
+/// capture time offsets are divided by speed, speed 0 means as fast as possible.
+class ReplayClock {
+public:
+    double speed() const { return speed_; }
+    void speed(double val) { speed_ = std::max(val, 0.); }
+
+    /// capture time corresponds to time, later captures are due relative to it
+    void anchor(tb::WallTime capture, tb::MonoTime time) {
+        capture_ = capture;
+        time_ = time;
+    }
+    tb::MonoTime due(tb::WallTime capture) const {
+        if(speed_==0)
+            return time_;
+        auto offset = std::chrono::duration<double, std::nano>(capture - capture_) / speed_;
+        return time_ + std::chrono::duration_cast<tb::Duration>(offset);
+    }
+private:
+    double speed_ {1};
+    tb::WallTime capture_ {};
+    tb::MonoTime time_ {};
+};
+
+/// how late packets were dispatched compared to replay schedule
+struct ReplayLag {
+    std::size_t count {0};
+    std::size_t late {0};           // dispatched later than threshold
+    std::size_t underruns {0};      // schedule was ahead of reading
+    tb::Duration total {};
+    tb::Duration max {};
+    tb::Duration threshold = std::chrono::milliseconds(1);
+
+    void on_dispatched(tb::Duration lag) {
+        count++;
+        lag = std::max(lag, tb::Duration{});
+        total += lag;
+        max = std::max(max, lag);
+        late += lag > threshold;
+    }
+    void report(std::ostream& os) const {
+        using Micros = std::chrono::microseconds;
+        os << "replay packets "<<count<<" lag avg "
+           << (count ? std::chrono::duration_cast<Micros>(total).count() / count : 0) << "us"
+           << " max "<<std::chrono::duration_cast<Micros>(max).count()<<"us"
+           << " late "<<late<<" underruns "<<underruns;
+    }
+};
+
 template<template<class...> class ProtocolM>
 class PcapMdClient  : public BasicService<PcapMdClient<ProtocolM>, io::Service>
 , public ProtocolM<PcapMdClient<ProtocolM>>
@@ -38,6 +100,31 @@ public:
     using BinaryPacket = tb::PcapPacket;
     using typename Base::Reactor;
     using Peer = PcapConn;
+    /// view of captured payload, native reader hands out packets without copying
+    using PacketView = tb::Packet<tb::ConstBuffer, tb::IpEndpoint>;
+    static constexpr std::size_t DefaultReplayBuffer = 16384;   // packets
+    static constexpr std::size_t MaxDispatchBatch = 1024;       // packets per timer callback
+private:
+    struct Captured {
+        tb::WallTime time {};
+        tb::IpEndpoint src {};
+        tb::IpEndpoint dst {};
+        bool accepted {false};
+        bool first {false};         // first packet of input, schedule is anchored to it
+        std::vector<char> data;     // empty if rejected by filter
+    };
+    /// native record seen by endpoints filter the way libpcap packet header is
+    struct RecordHeader {
+        struct Protocol {
+            int value;
+            int protocol() const { return value; }
+        };
+        Protocol protocol_;
+        tb::IpEndpoint src_, dst_;
+        const Protocol& protocol() const { return protocol_; }
+        const tb::IpEndpoint& src() const { return src_; }
+        const tb::IpEndpoint& dst() const { return dst_; }
+    };
 public:
     explicit PcapMdClient(Reactor* r, Component* p)
     : Base(r,p)
@@ -48,11 +135,34 @@ public:
     
     auto& gw_stats() { return stats_; } 
 
+    /// app replay mode: packets are paced by capture time even without "replay" parameters
+    void replay_mode(bool val) { replay_mode_ = val; }
+    /// inputs are read and dispatched by open() on calling thread, only when there is no reactor thread to block
+    void sync(bool val) { sync_ = val; }
+
     // dispatch parameters
+    /// "pcap": { "inputs", "filter", "reader": "native" | "libpcap", "merge": false, "replay": {"speed": 1, "loop": false, "buffer"} }
+    /// native reader maps inputs and reads pcap, pcapng, gzip and tar (.tgz) by content
+    /// with "merge" inputs are read simultaneously in capture time order (A/B lines, several feeds)
+    /// inputs are read by own thread, reactor dispatches packets as fast as possible or,
+    /// with "replay", at capture times scaled by speed (0 = max)
     void on_parameters_updated(const core::Parameters& params) {
         auto& pcap_pa = params["pcap"];
 
         pcap_pa["inputs"].copy(inputs_);
+        native_ = pcap_pa.str("reader", "native") != "libpcap";
+        merge_ = pcap_pa.value_or("merge", false);
+        if(merge_ && !native_)
+            TOOLBOX_WARNING<<"pcap: merge requires native reader, inputs are read one after another";
+
+        reporter_.interval(std::chrono::seconds(pcap_pa.value_or("report_interval_s", 10)));
+
+        auto& replay_pa = pcap_pa["replay"];
+        bool has_replay = !replay_pa.is_null();
+        replay_ = replay_mode_ || has_replay;
+        speed_ = has_replay ? replay_pa.value_or("speed", 1.0) : 1.0;
+        loop_ = has_replay && replay_pa.value_or("loop", false);
+        replay_buffer_ = has_replay ? replay_pa.value_or("buffer", DefaultReplayBuffer) : DefaultReplayBuffer;
 
         Protocol::on_parameters_updated(params);
         
@@ -79,35 +189,267 @@ public:
 
     void open() {
         Protocol::open();
-        run(); // FIXME: reactor.defer(&This::run);
+        start_reporter();
+        if(sync_) {
+            if(replay_)
+                TOOLBOX_WARNING<<"pcap: replay is not paced without reactor thread";
+            run();
+        } else {
+            start_reader();
+        }
     }
     void run() {
-        for(auto& input: inputs_) {
-            TOOLBOX_INFO<<"pcap replay start: "<<input;
-            peer_.input(input);
-            peer_.run();
-            TOOLBOX_INFO<<"pcap replay done: "<<input;
-        };
+        do {
+            if(merge_ && native_) {
+                read_merged();
+                continue;
+            }
+            for(auto& input: inputs_) {
+                if(stop_.load(std::memory_order_relaxed))
+                    return;
+                TOOLBOX_INFO<<"pcap replay start: "<<input;
+                first_ = true;
+                std::size_t read = read_;
+                auto start = tb::MonoClock::now();
+                if(native_) {
+                    read_native(input);
+                } else {
+                    peer_.input(input);
+                    peer_.run();
+                }
+                auto elapsed = std::chrono::duration<double>(tb::MonoClock::now() - start).count();
+                read = read_ - read;
+                TOOLBOX_INFO<<"pcap replay done: "<<input<<", "<<read<<" packets in "<<elapsed<<" s, "
+                    <<(elapsed>0 ? read / elapsed / 1e3 : 0)<<" kpps";
+            }
+        } while(queue_ && replay_ && loop_ && !inputs_.empty() && !stop_.load(std::memory_order_relaxed));
     }
     void close() {
+        stop_reader();
+        reporter_.stop();
+        std::stringstream ss;
+        report(ss);
+        TOOLBOX_INFO << ss.str();
         Protocol::close();
     }
+    /// detailed stats, reactor thread only
     void report(std::ostream& os) {
-        //protocol_.stats().report(os);
+        os << "pcap ";
         stats_.report(os);
+        if constexpr(HasStats<Protocol>::value) {
+            os << Protocol::name() << " ";
+            Protocol::stats().report(os);
+        }
     }
-    void on_idle() {
-        report(std::cerr);
-    }
+    const ReplayLag& lag() const { return lag_; }
 private:
+    template<class T, class=void>
+    struct HasStats: std::false_type {};
+    template<class T>
+    struct HasStats<T, std::void_t<decltype(std::declval<T&>().stats().report(std::declval<std::ostream&>()))>>: std::true_type {};
+
+    /// packet path only counts, reporter thread logs the counters
+    void start_reporter() {
+        reporter_.clear();
+        reporter_.add("pcap read", [this](std::ostream& os) { os << read_.load(); });
+        reporter_.add("pcap", stats_);
+        if constexpr(HasStats<Protocol>::value)
+            reporter_.add(std::string(Protocol::name()), static_cast<const core::StreamStats&>(Protocol::stats()));
+        reporter_.start();
+    }
+
+    /// reading thread fills the queue, reactor timer dispatches packets when they are due
+    void start_reader() {
+        queue_ = std::make_unique<SpscQueue<Captured>>(replay_buffer_);
+        lag_ = {};
+        stop_ = false;
+        reading_done_ = false;
+        anchored_ = false;
+        clock_.speed(replay_ ? speed_ : 0);
+        if(replay_)
+            TOOLBOX_INFO<<"pcap replay speed "<<clock_.speed()<<(loop_ ? " loop" : "");
+        reader_ = std::thread([this] {
+            run();
+            reading_done_.store(true, std::memory_order_release);
+        });
+        schedule(tb::MonoClock::now());
+    }
+
+    /// libpcap loop could not be broken through PcapDevice, rest of its input is skipped packet by packet
+    void stop_reader() {
+        stop_ = true;
+        replay_timer_.cancel();
+        if(reader_.joinable())
+            reader_.join();
+        if(queue_) {
+            if(replay_) {
+                std::stringstream ss;
+                lag_.report(ss);
+                TOOLBOX_INFO<<"pcap "<<ss.str();
+            }
+            queue_.reset();
+        }
+    }
+
+    void schedule(tb::MonoTime when) {
+        replay_timer_ = this->reactor()->timer(when, tb::Priority::High,
+            tb::bind([this](tb::CyclTime now, tb::Timer& timer) { on_replay_timer(); }));
+    }
+
+    void on_replay_timer() {
+        constexpr auto Poll = std::chrono::milliseconds(1);
+        auto& queue = *queue_;
+        for(std::size_t n=0; n<MaxDispatchBatch; n++) {
+            if(queue.empty()) {
+                if(reading_done_.load(std::memory_order_acquire) && queue.empty()) {
+                    TOOLBOX_INFO<<"pcap "<<(replay_ ? "replay" : "read")<<" finished";
+                    return;
+                }
+                lag_.underruns++;
+                schedule(tb::MonoClock::now() + Poll);
+                return;
+            }
+            auto& c = queue.front();
+            auto now = tb::MonoClock::now();
+            if(c.first || !anchored_) {
+                // next input continues where previous one stopped
+                clock_.anchor(c.time, anchored_ ? std::max(now, last_due_) : now);
+                anchored_ = true;
+            }
+            auto due = clock_.due(c.time);
+            if(due > now) {
+                schedule(due);
+                return;
+            }
+            last_due_ = due;
+            lag_.on_dispatched(now - due);
+            dispatch(c);
+            queue.pop();
+        }
+        schedule(tb::MonoClock::now());     // let other events in between batches
+    }
+
+    void dispatch(const Captured& c) {
+        PacketView pkt(PacketView::Buffer(c.data.data(), c.data.size()));
+        pkt.header().src() = c.src;
+        pkt.header().dst() = c.dst;
+        pkt.header().recv_timestamp(c.time);
+        stats_.on_received(pkt);
+        if(c.accepted) {
+            Protocol::async_handle(peer_, pkt, tb::bind([this](std::error_code ec) {
+            }));
+        } else {
+            stats_.on_rejected(pkt);
+        }
+    }
+
+    /// decompression runs ahead on its own thread, records are dispatched from the mapped or inflated memory
+    void read_native(const std::string& input) {
+        try {
+            pcap_reader_.open(input);
+            PcapRecord rec;
+            while(pcap_reader_.next(rec)) {
+                if(stop_.load(std::memory_order_relaxed))
+                    break;
+                on_record_(rec);
+            }
+            if(pcap_reader_.skipped())
+                TOOLBOX_INFO<<"pcap "<<input<<": skipped "<<pcap_reader_.skipped()<<" not UDP/TCP over IPv4 packets";
+        } catch(std::exception& e) {
+            TOOLBOX_ERROR<<"pcap "<<input<<": "<<e.what();
+        }
+        pcap_reader_.close();
+    }
+
+    /// all inputs are open at once, packets are dispatched in global capture time order
+    void read_merged() {
+        if(inputs_.empty())
+            return;
+        TOOLBOX_INFO<<"pcap merge start: "<<inputs_.size()<<" inputs";
+        first_ = true;
+        std::size_t read = read_;
+        auto start = tb::MonoClock::now();
+        try {
+            for(auto& input: inputs_)
+                merger_.add(input);
+            PcapRecord rec;
+            while(merger_.next(rec)) {
+                if(stop_.load(std::memory_order_relaxed))
+                    break;
+                on_record_(rec);
+            }
+        } catch(std::exception& e) {
+            TOOLBOX_ERROR<<"pcap merge: "<<e.what();
+        }
+        merger_.close();
+        auto elapsed = std::chrono::duration<double>(tb::MonoClock::now() - start).count();
+        read = read_ - read;
+        TOOLBOX_INFO<<"pcap merge done: "<<read<<" packets in "<<elapsed<<" s, "
+            <<(elapsed>0 ? read / elapsed / 1e3 : 0)<<" kpps";
+    }
+
+    static tb::IpEndpoint to_endpoint(std::uint32_t addr, std::uint16_t port) {
+        return tb::IpEndpoint(boost::asio::ip::address_v4(addr), port);
+    }
+
+    void on_record_(const PcapRecord& rec) {
+        read_++;
+        RecordHeader h {{rec.protocol}, to_endpoint(rec.src_addr, rec.src_port), to_endpoint(rec.dst_addr, rec.dst_port)};
+        bool accepted = filter_(h);
+        if(queue_) {
+            capture(rec.time, h.src_, h.dst_, accepted, rec.data, rec.size);
+            return;
+        }
+        PacketView pkt(PacketView::Buffer(rec.data, rec.size));
+        pkt.header().src() = h.src_;
+        pkt.header().dst() = h.dst_;
+        pkt.header().recv_timestamp(rec.time);
+        stats_.on_received(pkt);
+        if(accepted) {
+            Protocol::async_handle(peer_, pkt, tb::bind([this](std::error_code ec) {
+            }));
+        } else {
+            stats_.on_rejected(pkt);
+        }
+    }
+
+    /// reading thread, payload is copied into the queue slot, so its buffer is reused once dispatched
+    void capture(tb::WallTime time, const tb::IpEndpoint& src, const tb::IpEndpoint& dst, bool accepted, const char* data, std::size_t size) {
+        Captured* c;
+        while(!(c = queue_->try_acquire())) {
+            if(stop_.load(std::memory_order_relaxed))
+                return;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        c->time = time;
+        c->src = src;
+        c->dst = dst;
+        c->accepted = accepted;
+        c->first = first_;
+        first_ = false;
+        if(c->accepted)
+            c->data.assign(data, data + size);
+        else
+            c->data.clear();
+        queue_->commit();
+    }
+
     void on_packet_(const tb::PcapPacket& pkt) {
+        if(stop_.load(std::memory_order_relaxed))
+            return;     // skip the rest of input
+        read_++;
         switch(pkt.header().protocol().protocol()) {
             case IPPROTO_TCP: case IPPROTO_UDP: {
+                if(queue_) {
+                    auto& buf = pkt.buffer();
+                    capture(pkt.header().recv_timestamp(), pkt.header().src(), pkt.header().dst(), filter_(pkt.header()),
+                        reinterpret_cast<const char*>(buf.data()), buf.size());
+                    break;
+                }
                 stats_.on_received(pkt);
                 if(filter_(pkt.header())) {
                     Protocol::async_handle(peer_, pkt, tb::bind([this](std::error_code ec) { 
                     })); // FIXME: sync_process?
-                    on_idle();      
                 } else {
                     stats_.on_rejected(pkt);
                 }
@@ -120,6 +462,29 @@ private:
     Stats stats_;
     toolbox::EndpointsFilter filter_;
     std::vector<std::string> inputs_;
+    bool native_ {true};
+    bool merge_ {false};
+    PcapReader pcap_reader_;            // reading thread
+    PcapMerger merger_;                 // reading thread
+    // reading thread and paced replay
+    bool sync_ {false};
+    bool replay_mode_ {false};
+    bool replay_ {false};
+    double speed_ {1};
+    bool loop_ {false};
+    std::size_t replay_buffer_ {DefaultReplayBuffer};
+    ReplayClock clock_;
+    ReplayLag lag_;
+    bool anchored_ {false};
+    tb::MonoTime last_due_ {};
+    tb::Timer replay_timer_;
+    std::unique_ptr<SpscQueue<Captured>> queue_;
+    std::thread reader_;
+    bool first_ {false};                // reading thread
+    std::atomic<bool> stop_ {false};
+    std::atomic<bool> reading_done_ {false};
+    core::Counter read_;                // reading thread
+    core::StatsReporter reporter_;
 };
 
 } // ft::pcap
\ No newline at end of file
@@ -0,0 +1,97 @@
+#pragma once
+#include "ft/io/PcapReader.hpp"
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace ft::io {
+
+/// Reads several captures at once and yields their packets in capture time order,
+/// so A/B lines and different feeds captured separately are interleaved as they were live.
+/// Packets with equal time are yielded in the order inputs were added.
+class PcapMerger {
+    struct Entry {
+        PcapRecord rec;
+        std::size_t input;
+    };
+    /// min-heap on time, then input
+    struct Later {
+        bool operator()(const Entry& lhs, const Entry& rhs) const {
+            return lhs.rec.time!=rhs.rec.time ? lhs.rec.time > rhs.rec.time : lhs.input > rhs.input;
+        }
+    };
+    static constexpr std::size_t None = std::size_t(-1);
+public:
+    explicit PcapMerger(std::size_t gzip_block_size = ft::GzipReader::DefaultBlockSize)
+    : gzip_block_size_(gzip_block_size) {}
+
+    /// inputs should be added before the first next()
+    void add(const std::string& path) {
+        reader().open(path);
+        names_.push_back(path);
+    }
+    /// data should outlive reading
+    void add(const char* data, std::size_t size, std::string name = {}) {
+        reader().input(data, size);
+        names_.push_back(std::move(name));
+    }
+    void close() {
+        readers_.clear();
+        names_.clear();
+        heap_.clear();
+        started_ = false;
+        current_ = None;
+    }
+
+    /// @returns false when all inputs are over
+    /// @throws std::runtime_error on malformed capture
+    bool next(PcapRecord& rec) {
+        if(!started_) {
+            started_ = true;
+            for(std::size_t i=0; i<readers_.size(); i++)
+                advance(i);
+        } else if(current_!=None) {
+            // previous record refers to memory of its reader until now
+            advance(current_);
+        }
+        current_ = None;
+        if(heap_.empty())
+            return false;
+        std::pop_heap(heap_.begin(), heap_.end(), Later{});
+        rec = heap_.back().rec;
+        current_ = heap_.back().input;
+        heap_.pop_back();
+        return true;
+    }
+
+    /// input the last record was read from
+    std::size_t input() const { return current_; }
+    const std::string& name(std::size_t input) const { return names_[input]; }
+    std::size_t size() const { return readers_.size(); }
+    const PcapReader& reader(std::size_t input) const { return *readers_[input]; }
+private:
+    PcapReader& reader() {
+        if(started_)
+            throw std::logic_error("pcap: input added after reading started");
+        readers_.push_back(std::make_unique<PcapReader>(gzip_block_size_));
+        return *readers_.back();
+    }
+    void advance(std::size_t input) {
+        Entry e {{}, input};
+        if(!readers_[input]->next(e.rec))
+            return;
+        heap_.push_back(e);
+        std::push_heap(heap_.begin(), heap_.end(), Later{});
+    }
+private:
+    std::size_t gzip_block_size_;
+    std::vector<std::unique_ptr<PcapReader>> readers_;     // each inflates on its own thread
+    std::vector<std::string> names_;
+    std::vector<Entry> heap_;
+    std::size_t current_ {None};
+    bool started_ {false};
+};
+
+} // ft::io
@@ -0,0 +1,463 @@
+#pragma once
+#include "ft/utils/GzipReader.hpp"
+#include "ft/utils/MappedFile.hpp"
+#include "toolbox/sys/Time.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <netinet/in.h>
+
+namespace ft::io {
+
+/// UDP or TCP packet over IPv4, payload refers to reader's memory and is valid until next packet is read
+struct PcapRecord {
+    toolbox::WallTime time {};
+    int protocol {0};               // IPPROTO_UDP or IPPROTO_TCP
+    std::uint32_t src_addr {0};     // host byte order
+    std::uint32_t dst_addr {0};
+    std::uint16_t src_port {0};
+    std::uint16_t dst_port {0};
+    const char* data {nullptr};     // transport payload
+    std::size_t size {0};
+};
+
+/// Native reader of pcap and pcapng captures.
+/// Input is mapped into memory, gzip-compressed input is inflated by background thread ahead of decoding,
+/// tar archive (e.g. .tgz) is read as sequence of captures it contains.
+/// Packets are handed out without copying unless they cross boundary of inflated blocks.
+class PcapReader {
+    /// contiguous view of input, byte ranges crossing inflated blocks are made contiguous on request
+    class Source {
+    public:
+        void input(const char* data, std::size_t size) {
+            gzip_ = nullptr;
+            ptr_ = data;
+            end_ = data + size;
+        }
+        void input(ft::GzipReader& gzip) {
+            gzip_ = &gzip;
+            ptr_ = end_ = nullptr;
+        }
+        /// @returns pointer to size contiguous bytes at current position, nullptr if input ends before
+        const char* peek(std::size_t size) {
+            while(static_cast<std::size_t>(end_ - ptr_) < size) {
+                if(!gzip_ || !fetch())
+                    return nullptr;
+            }
+            return ptr_;
+        }
+        void consume(std::size_t size) { ptr_ += size; }
+        /// @returns false if input ends before
+        bool skip(std::size_t size) {
+            while(static_cast<std::size_t>(end_ - ptr_) < size) {
+                size -= end_ - ptr_;
+                ptr_ = end_;
+                if(!gzip_ || !fetch())
+                    return false;
+            }
+            ptr_ += size;
+            return true;
+        }
+    private:
+        /// appends next inflated block to unconsumed bytes
+        bool fetch() {
+            std::size_t tail = end_ - ptr_;
+            if(tail <= ft::GzipReader::HeadRoom) {
+                auto block = gzip_->next({ptr_, tail});
+                if(block.empty())
+                    return false;
+                ptr_ = block.data();
+                end_ = block.data() + block.size();
+            } else {
+                // packet is longer than head room of inflated blocks
+                std::vector<char> spill(ptr_, end_);
+                auto block = gzip_->next({});
+                spill.insert(spill.end(), block.begin(), block.end());
+                spill_.swap(spill);
+                ptr_ = spill_.data();
+                end_ = spill_.data() + spill_.size();
+                if(block.empty())
+                    return false;
+            }
+            return true;
+        }
+    private:
+        const char* ptr_ {};
+        const char* end_ {};
+        ft::GzipReader* gzip_ {};
+        std::vector<char> spill_;
+    };
+
+    enum class Format { None, Pcap, PcapNg };
+
+    struct Interface {
+        std::uint32_t linktype {0};
+        std::uint64_t units_per_sec {1000000};      // if_tsresol
+    };
+public:
+    static constexpr std::size_t TarBlockSize = 512;
+    static constexpr std::uint64_t Unbounded = ~0ULL;
+
+    /// link layer types
+    enum LinkType : std::uint32_t {
+        LINKTYPE_NULL = 0,
+        LINKTYPE_ETHERNET = 1,
+        LINKTYPE_RAW = 101,
+        LINKTYPE_LINUX_SLL = 113,
+        LINKTYPE_LINUX_SLL2 = 276
+    };
+
+    explicit PcapReader(std::size_t gzip_block_size = ft::GzipReader::DefaultBlockSize)
+    : gzip_(gzip_block_size) {}
+
+    /// maps file, gzip, tar, pcap and pcapng are detected by content
+    void open(const std::string& path) {
+        close();
+        file_.open(path);
+        input(file_.data(), file_.size());
+    }
+    /// data should outlive reading
+    void input(const char* data, std::size_t size) {
+        close_input();
+        if(ft::GzipReader::is_gzip(data, size)) {
+            gzip_.open(data, size);
+            source_.input(gzip_);
+        } else {
+            source_.input(data, size);
+        }
+        auto* block = source_.peek(TarBlockSize);
+        tar_ = block && std::memcmp(block + 257, "ustar", 5)==0;
+        remaining_ = tar_ ? 0 : Unbounded;
+        padding_ = 0;
+        started_ = false;
+        format_ = Format::None;
+        eof_ = false;
+    }
+    void close() {
+        close_input();
+        file_.close();
+    }
+
+    /// @returns false at the end of input
+    /// @throws std::runtime_error on malformed capture
+    bool next(PcapRecord& rec) {
+        while(!eof_) {
+            if(format_==Format::None && !next_capture())
+                break;
+            if(format_==Format::Pcap ? read_pcap(rec) : read_pcapng(rec))
+                return true;
+        }
+        eof_ = true;
+        return false;
+    }
+
+    /// name of tar entry being read
+    const std::string& entry() const { return entry_; }
+    std::size_t packets() const { return packets_; }
+    /// not UDP or TCP over IPv4, fragments
+    std::size_t skipped() const { return skipped_; }
+private:
+    void close_input() {
+        gzip_.close();
+        source_.input(nullptr, 0);
+        format_ = Format::None;
+        eof_ = true;
+    }
+
+    /// starts next capture of tar archive or the whole input
+    bool next_capture() {
+        if(!tar_) {
+            if(started_)
+                return false;       // single capture is over
+            started_ = true;
+            return start_capture();
+        }
+        for(;;) {
+            if(!source_.skip(remaining_ + padding_))
+                return false;
+            remaining_ = padding_ = 0;
+            auto* h = source_.peek(TarBlockSize);
+            if(!h || std::all_of(h, h + TarBlockSize, [](char c) { return c==0; }))
+                return false;       // end of archive
+            std::uint64_t size = tar_size(h + 124);
+            char type = h[156];
+            entry_.assign(h, strnlen(h, 100));
+            source_.consume(TarBlockSize);
+            remaining_ = size;
+            padding_ = (TarBlockSize - size % TarBlockSize) % TarBlockSize;
+            if((type=='0' || type=='\0') && start_capture())
+                return true;
+        }
+    }
+
+    static std::uint64_t tar_size(const char* field) {
+        std::uint64_t size = 0;
+        if(static_cast<std::uint8_t>(field[0]) & 0x80) {
+            for(int i=4; i<12; i++)     // base-256 of large files
+                size = (size<<8) | static_cast<std::uint8_t>(field[i]);
+            return size;
+        }
+        int i = 0;
+        while(i<12 && field[i]==' ')
+            i++;
+        for(; i<12 && field[i]>='0' && field[i]<='7'; i++)
+            size = size*8 + (field[i]-'0');
+        return size;
+    }
+
+    /// @returns false if capture format is not recognized, then it is skipped
+    bool start_capture() {
+        auto* p = peek(4);
+        if(!p)
+            return false;
+        std::uint32_t magic;
+        std::memcpy(&magic, p, sizeof(magic));
+        switch(magic) {
+            case 0xa1b2c3d4: case 0xa1b23c4d: swapped_ = false; break;
+            case 0xd4c3b2a1: case 0x4d3cb2a1: swapped_ = true; break;
+            case 0x0A0D0D0A:
+                format_ = Format::PcapNg;
+                interfaces_.clear();
+                return true;
+            default:
+                return false;
+        }
+        p = peek(24);
+        if(!p)
+            return false;
+        std::uint32_t m = u32(p);
+        nanos_ = m==0xa1b23c4d;
+        interfaces_.assign(1, Interface{u32(p + 20), nanos_ ? 1000000000ull : 1000000ull});
+        consume(24);
+        format_ = Format::Pcap;
+        return true;
+    }
+
+    bool read_pcap(PcapRecord& rec) {
+        for(;;) {
+            auto* h = peek(16);
+            if(!h)
+                return end_capture();
+            std::uint32_t caplen = u32(h + 8);
+            auto* p = peek(16 + caplen);
+            if(!p)
+                return end_capture();
+            auto ticks = static_cast<std::uint64_t>(u32(p)) * interfaces_[0].units_per_sec + u32(p + 4);
+            bool ok = decode(interfaces_[0], ticks, p + 16, caplen, rec);
+            consume(16 + caplen);
+            if(ok)
+                return true;
+        }
+    }
+
+    bool read_pcapng(PcapRecord& rec) {
+        for(;;) {
+            auto* h = peek(12);
+            if(!h)
+                return end_capture();
+            std::uint32_t type = u32(h);
+            if(type==0x0A0D0D0A) {
+                std::uint32_t bom;
+                std::memcpy(&bom, h + 8, sizeof(bom));
+                if(bom!=0x1A2B3C4D && bom!=0x4D3C2B1A)
+                    throw std::runtime_error("pcapng: invalid byte order magic");
+                swapped_ = bom==0x4D3C2B1A;
+                interfaces_.clear();
+            }
+            std::uint32_t len = u32(h + 4);
+            if(len < 12 || len % 4)
+                throw std::runtime_error("pcapng: invalid block length");
+            auto* b = peek(len);
+            if(!b)
+                return end_capture();
+            bool ok = false;
+            switch(u32(b)) {
+                case 1: add_interface(b, len); break;
+                case 6: {   // enhanced packet
+                    if(len < 32)
+                        throw std::runtime_error("pcapng: invalid enhanced packet block");
+                    std::uint32_t ifc = u32(b + 8);
+                    std::uint32_t caplen = std::min<std::uint32_t>(u32(b + 20), len - 32);
+                    if(ifc >= interfaces_.size())
+                        throw std::runtime_error("pcapng: unknown interface");
+                    auto ticks = (static_cast<std::uint64_t>(u32(b + 12)) << 32) | u32(b + 16);
+                    ok = decode(interfaces_[ifc], ticks, b + 28, caplen, rec);
+                } break;
+                case 3: {   // simple packet, without timestamp
+                    if(interfaces_.empty() || len < 16)
+                        break;
+                    std::uint32_t caplen = std::min<std::uint32_t>(u32(b + 8), len - 16);
+                    ok = decode(interfaces_[0], last_ticks_, b + 12, caplen, rec, false);
+                } break;
+                default: break;
+            }
+            consume(len);
+            if(ok)
+                return true;
+        }
+    }
+
+    void add_interface(const char* b, std::uint32_t len) {
+        Interface ifc {static_cast<std::uint32_t>(u16(b + 8))};
+        // options: if_tsresol
+        for(std::uint32_t ofs = 16; ofs + 4 <= len - 4;) {
+            std::uint16_t code = u16(b + ofs), size = u16(b + ofs + 2);
+            if(code==0)
+                break;
+            if(code==9 && size>=1) {
+                auto res = static_cast<std::uint8_t>(b[ofs + 4]);
+                ifc.units_per_sec = 1;
+                for(int i=0; i<(res & 0x7f); i++)
+                    ifc.units_per_sec *= res & 0x80 ? 2 : 10;
+            }
+            ofs += 4 + ((size + 3) & ~3u);
+        }
+        interfaces_.push_back(ifc);
+    }
+
+    /// skips the rest of capture
+    bool end_capture() {
+        format_ = Format::None;
+        return false;
+    }
+
+    /// link, IPv4 and transport headers
+    bool decode(const Interface& ifc, std::uint64_t ticks, const char* p, std::size_t size, PcapRecord& rec, bool has_time = true) {
+        packets_++;
+        if(has_time)
+            last_ticks_ = ticks;
+        std::size_t ofs = 0;
+        std::uint16_t ethertype = 0x0800;
+        switch(ifc.linktype) {
+            case LINKTYPE_ETHERNET:
+                if(size < 14)
+                    return skip();
+                ethertype = be16(p + 12);
+                ofs = 14;
+                while((ethertype==0x8100 || ethertype==0x88a8) && size >= ofs + 4) {    // vlan tags
+                    ethertype = be16(p + ofs + 2);
+                    ofs += 4;
+                }
+                break;
+            case LINKTYPE_LINUX_SLL:
+                if(size < 16)
+                    return skip();
+                ethertype = be16(p + 14);
+                ofs = 16;
+                break;
+            case LINKTYPE_LINUX_SLL2:
+                if(size < 20)
+                    return skip();
+                ethertype = be16(p);
+                ofs = 20;
+                break;
+            case LINKTYPE_NULL:
+                ofs = 4;
+                break;
+            case LINKTYPE_RAW: case 12: case 14:
+                break;
+            default:
+                return skip();
+        }
+        if(ethertype!=0x0800 || size < ofs + 20)
+            return skip();
+        const char* ip = p + ofs;
+        std::size_t ihl = (ip[0] & 0x0f) * 4;
+        if((static_cast<std::uint8_t>(ip[0])>>4)!=4 || ihl<20 || size < ofs + ihl)
+            return skip();
+        if(be16(ip + 6) & 0x3fff)
+            return skip();      // fragment
+        std::size_t ip_end = std::min<std::size_t>(size, ofs + be16(ip + 2));   // without link layer padding
+        const char* l4 = ip + ihl;
+        std::size_t l4_size = ip_end > ofs + ihl ? ip_end - ofs - ihl : 0;
+        rec.protocol = static_cast<std::uint8_t>(ip[9]);
+        std::size_t header;
+        if(rec.protocol==IPPROTO_UDP) {
+            header = 8;
+        } else if(rec.protocol==IPPROTO_TCP) {
+            if(l4_size < 20)
+                return skip();
+            header = (static_cast<std::uint8_t>(l4[12])>>4) * 4;
+        } else {
+            return skip();
+        }
+        if(l4_size < header)
+            return skip();
+        rec.src_addr = be32(ip + 12);
+        rec.dst_addr = be32(ip + 16);
+        rec.src_port = be16(l4);
+        rec.dst_port = be16(l4 + 2);
+        rec.data = l4 + header;
+        rec.size = l4_size - header;
+        if(rec.protocol==IPPROTO_UDP)
+            rec.size = std::min<std::size_t>(rec.size, std::max<std::uint16_t>(be16(l4 + 4), 8) - 8);
+        rec.time = toolbox::WallTime(std::chrono::duration_cast<toolbox::WallTime::duration>(to_nanos(ticks, ifc.units_per_sec)));
+        return true;
+    }
+    bool skip() {
+        skipped_++;
+        return false;
+    }
+
+    static std::chrono::nanoseconds to_nanos(std::uint64_t ticks, std::uint64_t units_per_sec) {
+        if(units_per_sec==1000000000)
+            return std::chrono::nanoseconds(ticks);
+        if(units_per_sec==1000000)
+            return std::chrono::nanoseconds(ticks * 1000);
+        auto secs = ticks / units_per_sec, frac = ticks % units_per_sec;
+        return std::chrono::nanoseconds(secs * 1000000000 + static_cast<std::uint64_t>(static_cast<unsigned __int128>(frac) * 1000000000 / units_per_sec));
+    }
+
+    /// bounded by current tar entry
+    const char* peek(std::size_t size) {
+        return size <= remaining_ ? source_.peek(size) : nullptr;
+    }
+    void consume(std::size_t size) {
+        source_.consume(size);
+        remaining_ -= size;
+    }
+
+    std::uint16_t u16(const char* p) const {
+        std::uint16_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return swapped_ ? __builtin_bswap16(v) : v;
+    }
+    std::uint32_t u32(const char* p) const {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return swapped_ ? __builtin_bswap32(v) : v;
+    }
+    static std::uint16_t be16(const char* p) {
+        std::uint16_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return __builtin_bswap16(v);    // little-endian host assumed
+    }
+    static std::uint32_t be32(const char* p) {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return __builtin_bswap32(v);
+    }
+private:
+    ft::MappedFile file_;
+    ft::GzipReader gzip_;
+    Source source_;
+    bool tar_ {false};
+    bool started_ {false};
+    bool eof_ {true};
+    std::uint64_t remaining_ {0};   // bytes left in tar entry
+    std::uint64_t padding_ {0};
+    std::string entry_;
+    Format format_ {Format::None};
+    bool swapped_ {false};
+    bool nanos_ {false};
+    std::vector<Interface> interfaces_;
+    std::uint64_t last_ticks_ {0};
+    std::size_t packets_ {0};
+    std::size_t skipped_ {0};
+};
+
+} // ft::io
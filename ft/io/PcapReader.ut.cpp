@@ -0,0 +1,288 @@
+#include "PcapReader.hpp"
+#include "PcapMerger.hpp"
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+using namespace ft;
+using namespace ft::io;
+
+namespace {
+
+/// captured packet to encode
+struct Packet {
+    std::uint64_t usec;
+    std::uint32_t dst_addr;
+    std::uint16_t dst_port;
+    std::string payload;
+    int protocol = IPPROTO_UDP;
+};
+
+template<typename T>
+void put(std::string& out, T val) { out.append(reinterpret_cast<const char*>(&val), sizeof(val)); }
+void put_be16(std::string& out, std::uint16_t val) { put(out, __builtin_bswap16(val)); }
+void put_be32(std::string& out, std::uint32_t val) { put(out, __builtin_bswap32(val)); }
+
+/// ethernet frame with vlan tag, IPv4 and UDP or TCP header
+std::string frame(const Packet& p) {
+    std::string out(12, '\0');
+    put_be16(out, 0x8100);
+    put_be16(out, 7);
+    put_be16(out, 0x0800);
+    std::size_t l4 = p.protocol==IPPROTO_UDP ? 8 : 20;
+    out.push_back(0x45);
+    out.push_back(0);
+    put_be16(out, 20 + l4 + p.payload.size());
+    put_be16(out, 0);
+    put_be16(out, 0x4000);      // don't fragment
+    out.push_back(64);
+    out.push_back(static_cast<char>(p.protocol));
+    put_be16(out, 0);
+    put_be32(out, 0x0a016e37);  // 10.1.110.55
+    put_be32(out, p.dst_addr);
+    put_be16(out, 5000);
+    put_be16(out, p.dst_port);
+    if(p.protocol==IPPROTO_UDP) {
+        put_be16(out, 8 + p.payload.size());
+        put_be16(out, 0);
+    } else {
+        out.append(8, '\0');
+        out.push_back(0x50);    // data offset
+        out.append(7, '\0');
+    }
+    out += p.payload;
+    return out;
+}
+
+std::string pcap(const std::vector<Packet>& packets) {
+    std::string out;
+    put<std::uint32_t>(out, 0xa1b2c3d4);
+    put<std::uint16_t>(out, 2);
+    put<std::uint16_t>(out, 4);
+    put<std::uint32_t>(out, 0);
+    put<std::uint32_t>(out, 0);
+    put<std::uint32_t>(out, 262144);
+    put<std::uint32_t>(out, PcapReader::LINKTYPE_ETHERNET);
+    for(auto& p: packets) {
+        auto f = frame(p);
+        put<std::uint32_t>(out, p.usec / 1000000);
+        put<std::uint32_t>(out, p.usec % 1000000);
+        put<std::uint32_t>(out, f.size());
+        put<std::uint32_t>(out, f.size());
+        out += f;
+    }
+    // not IP, longer than head room of inflated blocks
+    std::size_t size = 100000;
+    put<std::uint32_t>(out, 0);
+    put<std::uint32_t>(out, 0);
+    put<std::uint32_t>(out, size);
+    put<std::uint32_t>(out, size);
+    out.append(12, '\0');
+    put_be16(out, 0x0806);
+    out.append(size - 14, 'z');
+    return out;
+}
+
+std::string pcapng_block(std::uint32_t type, const std::string& body) {
+    std::string out;
+    std::uint32_t len = 12 + (body.size() + 3) / 4 * 4;
+    put(out, type);
+    put(out, len);
+    out += body;
+    out.append(len - 12 - body.size(), '\0');
+    put(out, len);
+    return out;
+}
+
+/// nanosecond timestamps
+std::string pcapng(const std::vector<Packet>& packets) {
+    std::string shb;
+    put<std::uint32_t>(shb, 0x1A2B3C4D);
+    put<std::uint16_t>(shb, 1);
+    put<std::uint16_t>(shb, 0);
+    put<std::int64_t>(shb, -1);
+    std::string idb;
+    put<std::uint16_t>(idb, PcapReader::LINKTYPE_ETHERNET);
+    put<std::uint16_t>(idb, 0);
+    put<std::uint32_t>(idb, 0);
+    put<std::uint16_t>(idb, 9);     // if_tsresol
+    put<std::uint16_t>(idb, 1);
+    idb += std::string("\x09\0\0\0", 4);
+    put<std::uint32_t>(idb, 0);     // opt_endofopt
+    std::string out = pcapng_block(0x0A0D0D0A, shb) + pcapng_block(1, idb);
+    for(auto& p: packets) {
+        auto f = frame(p);
+        std::string epb;
+        std::uint64_t ns = p.usec * 1000 + 1;
+        put<std::uint32_t>(epb, 0);
+        put<std::uint32_t>(epb, ns >> 32);
+        put<std::uint32_t>(epb, ns & 0xffffffff);
+        put<std::uint32_t>(epb, f.size());
+        put<std::uint32_t>(epb, f.size());
+        epb += f;
+        out += pcapng_block(6, epb);
+    }
+    return out;
+}
+
+std::string tar(const std::vector<std::pair<std::string, std::string>>& files) {
+    std::string out;
+    for(auto& [name, data]: files) {
+        std::string h(512, '\0');
+        h.replace(0, name.size(), name);
+        char size[12];
+        std::snprintf(size, sizeof(size), "%011o", static_cast<unsigned>(data.size()));
+        h.replace(124, 11, size, 11);
+        h[156] = '0';
+        h.replace(257, 6, "ustar", 6);
+        out += h + data;
+        out.append((512 - data.size() % 512) % 512, '\0');
+    }
+    out.append(1024, '\0');
+    return out;
+}
+
+std::string gzip(const std::string& data) {
+    z_stream zs {};
+    deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    std::string out(deflateBound(&zs, data.size()), '\0');
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.avail_in = data.size();
+    zs.next_out = reinterpret_cast<Bytef*>(out.data());
+    zs.avail_out = out.size();
+    deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return out;
+}
+
+std::vector<PcapRecord> read_all(PcapReader& reader, std::vector<std::string>& payloads) {
+    std::vector<PcapRecord> result;
+    PcapRecord rec;
+    while(reader.next(rec)) {
+        payloads.emplace_back(rec.data, rec.size);
+        result.push_back(rec);
+    }
+    return result;
+}
+
+std::vector<Packet> sample(std::size_t n, std::uint64_t usec) {
+    std::vector<Packet> packets;
+    for(std::size_t i=0; i<n; i++)
+        packets.push_back({usec + i*10, 0xe91a2610 + std::uint32_t(i%2), std::uint16_t(6016 + i%2), std::string(10 + i%50, 'a' + i%26)});
+    packets.push_back({usec + n*10, 0xe91a2610, 6016, "tcp", IPPROTO_TCP});
+    packets.push_back({usec + n*10 + 1, 0xe91a2611, 6017, std::string(65000, 'x')});
+    return packets;
+}
+
+} // anonymous
+
+BOOST_AUTO_TEST_SUITE(PcapReaderSuite)
+
+BOOST_AUTO_TEST_CASE(Pcap)
+{
+    auto packets = sample(100, 1602460800000000ull);
+    auto data = pcap(packets);
+    PcapReader reader;
+    reader.input(data.data(), data.size());
+    std::vector<std::string> payloads;
+    auto recs = read_all(reader, payloads);
+    BOOST_REQUIRE_EQUAL(recs.size(), packets.size());
+    BOOST_CHECK_EQUAL(reader.skipped(), 1);
+    for(std::size_t i=0; i<packets.size(); i++) {
+        BOOST_CHECK_EQUAL(payloads[i], packets[i].payload);
+        BOOST_CHECK_EQUAL(recs[i].dst_addr, packets[i].dst_addr);
+        BOOST_CHECK_EQUAL(recs[i].dst_port, packets[i].dst_port);
+        BOOST_CHECK_EQUAL(recs[i].src_addr, 0x0a016e37u);
+        BOOST_CHECK_EQUAL(recs[i].protocol, packets[i].protocol);
+        BOOST_CHECK_EQUAL(std::chrono::duration_cast<std::chrono::microseconds>(recs[i].time.time_since_epoch()).count(), static_cast<std::int64_t>(packets[i].usec));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(PcapNg)
+{
+    auto packets = sample(10, 1602460800000000ull);
+    auto data = pcapng(packets);
+    PcapReader reader;
+    reader.input(data.data(), data.size());
+    std::vector<std::string> payloads;
+    auto recs = read_all(reader, payloads);
+    BOOST_REQUIRE_EQUAL(recs.size(), packets.size());
+    BOOST_CHECK_EQUAL(payloads.back(), packets.back().payload);
+    BOOST_CHECK_EQUAL(std::chrono::duration_cast<std::chrono::nanoseconds>(recs[3].time.time_since_epoch()).count(),
+        static_cast<std::int64_t>(packets[3].usec * 1000 + 1));
+}
+
+BOOST_AUTO_TEST_CASE(Tgz)
+{
+    auto a = sample(1000, 1602460800000000ull);
+    auto b = sample(500, 1602460900000000ull);
+    auto data = gzip(tar({{"a.pcap", pcap(a)}, {"readme.txt", "not a capture"}, {"b.pcapng", pcapng(b)}}));
+    // small blocks make packets cross block boundaries
+    for(std::size_t block_size: {std::size_t(1000), std::size_t(1)<<20}) {
+        PcapReader reader(block_size);
+        reader.input(data.data(), data.size());
+        std::vector<std::string> payloads;
+        auto recs = read_all(reader, payloads);
+        BOOST_REQUIRE_EQUAL(recs.size(), a.size() + b.size());
+        std::size_t mismatches = 0;
+        for(std::size_t i=0; i<a.size(); i++)
+            mismatches += payloads[i] != a[i].payload;
+        for(std::size_t i=0; i<b.size(); i++)
+            mismatches += payloads[a.size() + i] != b[i].payload;
+        BOOST_CHECK_EQUAL(mismatches, 0);
+        BOOST_CHECK_EQUAL(reader.entry(), "b.pcapng");
+    }
+    // truncated archive
+    PcapReader reader(1000);
+    auto truncated = data.substr(0, data.size()/2);
+    reader.input(truncated.data(), truncated.size());
+    std::vector<std::string> payloads;
+    BOOST_CHECK_THROW(read_all(reader, payloads), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(Merge)
+{
+    // A and B lines with interleaved and equal timestamps, third feed starts later and is compressed
+    std::vector<Packet> a, b, c;
+    for(std::uint64_t i=0; i<100; i++) {
+        a.push_back({1000 + i*10, 0xe91a2610, 6016, "A" + std::to_string(i)});
+        b.push_back({1000 + i*10 + (i%2 ? 5 : 0), 0xe91a2611, 6017, "B" + std::to_string(i)});
+        c.push_back({1500 + i*7, 0xe91a2612, 6018, "C" + std::to_string(i)});
+    }
+    auto da = pcap(a), db = pcapng(b), dc = gzip(pcap(c));
+    PcapMerger merger(1000);
+    merger.add(da.data(), da.size(), "a");
+    merger.add(db.data(), db.size(), "b");
+    merger.add(dc.data(), dc.size(), "c");
+    PcapRecord rec;
+    std::vector<std::string> payloads;
+    std::vector<std::size_t> inputs;
+    std::int64_t prev = 0;
+    bool ordered = true;
+    while(merger.next(rec)) {
+        auto ns = rec.time.time_since_epoch().count();
+        ordered &= ns >= prev;
+        prev = ns;
+        payloads.emplace_back(rec.data, rec.size);
+        inputs.push_back(merger.input());
+    }
+    BOOST_CHECK(ordered);
+    BOOST_REQUIRE_EQUAL(payloads.size(), a.size() + b.size() + c.size());
+    BOOST_CHECK_EQUAL(payloads[0], "A0");
+    BOOST_CHECK_EQUAL(payloads[1], "B0");  // pcapng timestamps are 1ns later
+    BOOST_CHECK_EQUAL(payloads[2], "A1");
+    BOOST_CHECK_EQUAL(payloads[3], "B1");
+    BOOST_CHECK_EQUAL(inputs[0], 0u);
+    BOOST_CHECK_EQUAL(inputs[1], 1u);
+    std::size_t count[3] {};
+    for(std::size_t i=0; i<payloads.size(); i++) {
+        auto& expected = inputs[i]==0 ? a : inputs[i]==1 ? b : c;
+        BOOST_CHECK_EQUAL(payloads[i], expected[count[inputs[i]]++].payload);
+    }
+    BOOST_CHECK_THROW(merger.add(da.data(), da.size()), std::logic_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -7,6 +7,7 @@
 #include "ft/core/Stream.hpp"
 #include "ft/core/Requests.hpp"
 #include "ft/core/InstrumentsCache.hpp"
+#include "ft/core/BestPriceCache.hpp"
 
 namespace ft::io {
 
@@ -122,6 +123,8 @@ class BasicProtocol
     void on_parameters_updated(const core::Parameters& params) {
 
     }
+    /// peer was shut down, per-peer state could be dropped
+    void on_peer_closed(PeerId id) {}
 }; // Protocol
 
 template<class Self, typename...O>
@@ -138,7 +141,11 @@ class BasicMdProtocol : public BasicProtocol<Self, O...> {
     }
     void instruments_cache(core::InstrumentsCache* instruments_cache) { instruments_cache_ = instruments_cache; }
     core::InstrumentsCache* instruments_cache() { return instruments_cache_; }
+    /// shared cache of last known best prices, used to answer subscriptions with snapshot
+    void bestprice_cache(core::BestPriceCache* bestprice_cache) { bestprice_cache_ = bestprice_cache; }
+    core::BestPriceCache* bestprice_cache() { return bestprice_cache_; }
   protected:
       core::InstrumentsCache* instruments_cache_ {};
+      core::BestPriceCache* bestprice_cache_ {};
 };
 } // ft::io
\ No newline at end of file
@@ -0,0 +1,165 @@
+#pragma once
+#include "ft/utils/Common.hpp"
+#include "ft/utils/TokenBucket.hpp"
+#include "ft/core/Parameters.hpp"
+#include "toolbox/sys/Time.hpp"
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace ft::io {
+
+/// updates of critical subscriptions bypass limits
+enum class UpdatePriority : int {
+    Normal = 0,
+    Critical = 1
+};
+
+inline std::ostream& operator<<(std::ostream& os, UpdatePriority val) {
+    return os << (val==UpdatePriority::Critical ? "critical" : "normal");
+}
+
+/// outbound limits applied to each peer
+struct RateLimits {
+    /// consumer class: peers at remote address with their own critical symbols
+    struct Consumer {
+        std::string remote;
+        std::vector<std::string> critical;
+    };
+    double rate {0};                // messages per second, 0 = unlimited
+    double burst {0};               // max messages sent at once
+    tb::Duration min_interval {};   // min interval between updates of the same instrument
+    std::vector<std::string> critical;  // symbols whose updates bypass limits of peers of no other class
+    std::vector<Consumer> consumers;
+
+    bool enabled() const { return rate>0 || min_interval>tb::Duration{}; }
+
+    /// "rate", "burst", "min_interval_us", "critical": ["symbol", ...],
+    /// "consumers": [{ "remote": "address", "critical": ["symbol", ...] }]
+    void configure(const core::Parameters& params) {
+        rate = params.value_or("rate", 0.);
+        burst = params.value_or("burst", rate>0 ? rate/10 : 0.);
+        min_interval = tb::Micros(params.value_or("min_interval_us", 0));
+        critical.clear();
+        if(params.find("critical")!=params.end())
+            params["critical"].copy(critical);
+        consumers.clear();
+        if(params.find("consumers")!=params.end()) {
+            for(auto pa: params["consumers"]) {
+                auto& c = consumers.emplace_back();
+                c.remote = pa.str("remote");
+                if(pa.find("critical")!=pa.end())
+                    pa["critical"].copy(c.critical);
+            }
+        }
+    }
+
+    /// @returns critical symbols of consumer at remote address
+    const std::vector<std::string>& critical_for(std::string_view remote) const {
+        for(auto& c: consumers)
+            if(c.remote==remote)
+                return c.critical;
+        return critical;
+    }
+};
+
+/// Per-peer rate limiter, priorities of the peer's subscriptions are resolved once per instrument.
+/// Updates which were not admitted are conflated: only the fact that instrument has
+/// changed is remembered, latest state should be sent when drained.
+template<typename KeyT>
+class BasicRateLimiter {
+    struct State {
+        tb::MonoTime last_sent {};
+        bool pending {false};
+        bool resolved {false};      // priority is known
+        UpdatePriority priority {UpdatePriority::Normal};
+    };
+public:
+    using Key = KeyT;
+
+    /// @param critical symbols whose updates bypass limits of this peer
+    explicit BasicRateLimiter(const RateLimits& limits, const std::vector<std::string>& critical = {})
+    : limits_(limits)
+    , critical_(critical)
+    , bucket_(limits.rate, limits.burst) {}
+
+    /// @returns priority of updates of key, symbol_fn(key) is called once per key
+    template<typename FnT>
+    UpdatePriority priority(Key key, FnT&& symbol_fn) {
+        if(critical_.empty())
+            return UpdatePriority::Normal;
+        auto& st = state_[key];
+        if(!st.resolved) {
+            st.resolved = true;
+            std::string_view symbol = symbol_fn(key);
+            bool found = std::find(critical_.begin(), critical_.end(), symbol) != critical_.end();
+            st.priority = found ? UpdatePriority::Critical : UpdatePriority::Normal;
+        }
+        return st.priority;
+    }
+
+    /// @returns true if update could be sent now
+    bool admit(Key key, tb::MonoTime now) {
+        auto& st = state_[key];
+        if(now - st.last_sent < limits_.min_interval || !bucket_.consume(now))
+            return false;
+        st.last_sent = now;
+        st.pending = false;
+        admitted_++;
+        return true;
+    }
+
+    /// remember skipped update
+    void conflate(Key key) {
+        auto& st = state_[key];
+        conflated_++;
+        if(!st.pending) {
+            st.pending = true;
+            pending_.push_back(key);
+        }
+    }
+
+    bool has_pending() const { return !pending_.empty(); }
+
+    /// sends latest state of conflated instruments while limits allow, fn(key)
+    /// @returns number of updates sent
+    template<typename FnT>
+    std::size_t drain(tb::MonoTime now, FnT&& fn) {
+        std::size_t sent = 0;
+        for(auto n = pending_.size(); n>0; n--) {
+            Key key = pending_.front();
+            pending_.pop_front();
+            auto& st = state_[key];
+            if(!st.pending)
+                continue;   // already sent
+            if(now - st.last_sent < limits_.min_interval) {
+                pending_.push_back(key);
+                continue;
+            }
+            if(!bucket_.consume(now)) {
+                pending_.push_front(key);
+                break;
+            }
+            st.pending = false;
+            st.last_sent = now;
+            admitted_++;
+            sent++;
+            fn(key);
+        }
+        return sent;
+    }
+
+    std::size_t admitted() const { return admitted_; }
+    std::size_t conflated() const { return conflated_; }
+protected:
+    const RateLimits& limits_;
+    std::vector<std::string> critical_;
+    TokenBucket bucket_;
+    ft::unordered_map<Key, State> state_;
+    std::deque<Key> pending_;
+    std::size_t admitted_ {0};
+    std::size_t conflated_ {0};
+};
+
+} // ft::io
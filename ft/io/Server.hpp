@@ -95,16 +95,45 @@ class BasicServer : public BasicPeerService<Self, PeerT, O...>
             }
         }
 
-        void async_accept_first(Peer& peer, tb::DoneSlot done) {
-            TOOLBOX_DUMPV(5)<<"self:"<<self()<<" peer:"<<&peer<<",local:"<<peer.local()<<",remote:"<<peer.remote()<<", peer_id:"<<peer.id()<<", #peers:"<<self()->peers_.size();
-            auto& peers = self()->peers_;
-            auto it = peers.find(peer.id());
-            if(it==peers.end()) {
-                emplace_next_peer();
-                self()->newpeer()(peer.id(), {});
-            }else {
+        /// resolves datagram source endpoint to the peer, new peer is created only for unseen endpoint
+        void async_accept_first(Peer& rx, tb::DoneSlot done) {
+            const Endpoint& remote = rx.packet().header().src();
+            Peer* peer = find_peer(remote);
+            if(!peer) {
+                peer = emplace_remote_peer(remote);
+                TOOLBOX_DUMPV(5)<<"self:"<<self()<<" new peer:"<<peer<<",local:"<<peer->local()<<",remote:"<<remote<<", peer_id:"<<peer->id()<<", #peers:"<<self()->peers_.size();
+                self()->newpeer()(peer->id(), {});
             }
-            self()->async_handle(peer, peer.packet(), done);        
+            self()->async_handle(*peer, rx.packet(), done);
+        }
+
+        /// @returns peer for remote endpoint or nullptr
+        Peer* find_peer(const Endpoint& remote) {
+            if(last_.peer && last_.remote == remote)
+                return last_.peer;
+            auto it = demux_.find(remote);
+            if(it == demux_.end())
+                return nullptr;
+            last_ = {remote, it->second};
+            return it->second;
+        }
+
+        /// forget peer before it is destroyed
+        void erase_peer(Peer& peer) {
+            if(last_.peer == &peer)
+                last_ = {};
+            auto it = demux_.find(peer.remote());
+            if(it!=demux_.end() && it->second == &peer)
+                demux_.erase(it);
+        }
+
+        Peer* emplace_remote_peer(const Endpoint& remote) {
+            auto ptr = make_next_peer();
+            ptr->remote() = remote;
+            Peer* peer = &self()->emplace_peer(std::move(ptr));
+            demux_.emplace(remote, peer);
+            last_ = {remote, peer};
+            return peer;
         }
 
         Peer* emplace_next_peer() {
@@ -133,18 +162,43 @@ class BasicServer : public BasicPeerService<Self, PeerT, O...>
         Endpoint& local() { return local_; }
         const Endpoint& local() const { return local_; }
         void local(const Endpoint& ep) { local_ = ep; }
+    protected:
+        /// hashes what Endpoint::operator== compares, raw sockaddr has padding and v6 flowinfo
+        struct EndpointHash {
+            std::size_t operator()(const Endpoint& ep) const noexcept {
+                auto addr = ep.address();
+                std::size_t h = ep.port();
+                if(addr.is_v4()) {
+                    h = h*31 + addr.to_v4().to_uint();
+                } else {
+                    auto v6 = addr.to_v6();
+                    auto bytes = v6.to_bytes();
+                    h = h*31 + 1;
+                    h = h*31 + std::hash<std::string_view>{}(std::string_view {reinterpret_cast<const char*>(bytes.data()), bytes.size()});
+                    h = h*31 + v6.scope_id();
+                }
+                return h;
+            }
+        };
+        struct LastPeer {
+            Endpoint remote;
+            Peer* peer {};
+        };
+        using DemuxMap = tb::unordered_map<Endpoint, Peer*, EndpointHash>;
     protected:
         Self* self_{};    
         Endpoint local_;    
         ServerSocket socket_;
-        std::unique_ptr<Peer> next_peer_ {};
+        std::unique_ptr<Peer> next_peer_ {};    // tcp: next accepted peer, udp: receives for all peers
+        DemuxMap demux_;                        // udp: remote endpoint => peer
+        LastPeer last_;                         // udp: recently active peer
         static constexpr bool has_accept() { return tb::SocketTraits::has_accept<ServerSocket>; }    
     };
 
     using Acceptors = std::vector<std::unique_ptr<Acceptor>>;
   public:
     using Base::peers, Base::peers_, Base::reactor
-        , Base::make_peer, Base::emplace_peer
+        , Base::make_peer, Base::emplace_peer, Base::get_peer
         , Base::async_write;
     using Base::Base;
 
@@ -183,6 +237,16 @@ class BasicServer : public BasicPeerService<Self, PeerT, O...>
 
     Acceptors& acceptors() { return acceptors_; }
 
+    /// close and remove peer, drops it from acceptors' demux
+    bool shutdown(PeerId id) {
+        if(auto* peer = get_peer(id)) {
+            for(auto& acpt: acceptors_) {
+                acpt->erase_peer(*peer);
+            }
+        }
+        return Base::shutdown(id);
+    }
+
     void on_error(Peer& peer, std::error_code ec, const char* what="error", const char* loc="") {
         TOOLBOX_ERROR << loc << what <<", ec:"<<ec<<", peer:"<<peer.remote();
     }
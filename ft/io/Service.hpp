@@ -216,7 +216,7 @@ class BasicPeerService : public BasicService<Self, io::PeerService, O...>
     Peer* get_peer(PeerId id) {
         auto it = peers_.find(id);
         if(it!=peers_.end()) {
-            return it->second;
+            return it->second.get();
         }
         return nullptr;
     }
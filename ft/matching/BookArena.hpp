@@ -0,0 +1,96 @@
+#pragma once
+#include "toolbox/util/Pool.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace ft { inline namespace matching {
+
+/// Memory shared by many order books: one pool of order nodes and slabs the level windows are carved from.
+/// Windows have power of 2 sizes, freed ones are reused by windows of the same size.
+/// Not thread safe, books sharing arena should be updated from one thread.
+template<typename NodeT, typename LevelT>
+class BookArena {
+    static constexpr std::size_t SizeClasses = 32;
+public:
+    using Node = NodeT;
+    using Level = LevelT;
+
+    /// levels are carved from slabs of this size unless window is larger
+    explicit BookArena(std::size_t slab_size = 1<<20)
+    : slab_size_(slab_size) {}
+
+    BookArena(const BookArena&) = delete;
+    BookArena& operator=(const BookArena&) = delete;
+
+    template<typename...ArgsT>
+    Node* alloc_node(ArgsT&&...args) {
+        nodes_size_++;
+        return nodes_.alloc(std::forward<ArgsT>(args)...);
+    }
+    void dealloc_node(Node* node) {
+        nodes_size_--;
+        nodes_.dealloc(node);
+    }
+
+    /// @returns constructed levels, size should be power of 2
+    Level* alloc_levels(std::size_t size) {
+        auto& free = free_[size_class(size)];
+        Level* levels;
+        if(!free.empty()) {
+            levels = free.back();
+            free.pop_back();
+        } else {
+            levels = carve(size);
+        }
+        std::uninitialized_default_construct_n(levels, size);
+        levels_size_ += size;
+        return levels;
+    }
+    void dealloc_levels(Level* levels, std::size_t size) {
+        if(!levels)
+            return;
+        std::destroy_n(levels, size);
+        free_[size_class(size)].push_back(levels);
+        levels_size_ -= size;
+    }
+
+    /// nodes in use
+    std::size_t nodes_size() const { return nodes_size_; }
+    /// levels in use by windows
+    std::size_t levels_size() const { return levels_size_; }
+    /// bytes reserved for levels including freed windows
+    std::size_t slabs_bytes() const { return slabs_bytes_; }
+private:
+    static std::size_t size_class(std::size_t size) {
+        return std::min<std::size_t>(__builtin_ctzll(size), SizeClasses - 1);
+    }
+    Level* carve(std::size_t size) {
+        std::size_t bytes = size * sizeof(Level);
+        if(bytes > slab_left_) {
+            std::size_t slab_bytes = std::max(slab_size_, bytes);
+            slabs_.emplace_back(new std::byte[slab_bytes]);
+            slab_ptr_ = slabs_.back().get();
+            slab_left_ = slab_bytes;
+            slabs_bytes_ += slab_bytes;
+        }
+        auto* levels = reinterpret_cast<Level*>(slab_ptr_);
+        slab_ptr_ += bytes;
+        slab_left_ -= bytes;
+        return levels;
+    }
+private:
+    toolbox::util::Pool<Node> nodes_;
+    std::size_t nodes_size_ {0};
+    std::size_t slab_size_;
+    std::vector<std::unique_ptr<std::byte[]>> slabs_;
+    std::byte* slab_ptr_ {nullptr};
+    std::size_t slab_left_ {0};
+    std::size_t slabs_bytes_ {0};
+    std::size_t levels_size_ {0};
+    std::array<std::vector<Level*>, SizeClasses> free_;  // freed windows by log2 of size
+};
+
+}} // ft::matching
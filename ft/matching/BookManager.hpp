@@ -0,0 +1,78 @@
+#pragma once
+#include "ft/matching/OrderBook.hpp"
+#include <memory>
+#include <vector>
+
+namespace ft { inline namespace matching {
+
+/// Order books of many instruments by dense instrument index, e.g. position in instruments list.
+/// Books share one arena for order nodes and level windows. Each book is created on first access
+/// and allocates its window on the first order, window starts small and grows with activity of the book.
+template<typename BookT = OrderBook<>>
+class BookManager {
+public:
+    using Book = BookT;
+    using Arena = typename Book::Arena;
+    using Traits = typename Book::OrderTraits;
+
+    explicit BookManager(Traits traits = Traits().index_size(16).max_index_size(4096), std::size_t slab_size = 1<<20)
+    : traits_(traits)
+    , arena_(slab_size)
+    {}
+
+    Book& operator[](std::size_t index) {
+        if(index >= books_.size())
+            books_.resize(index + 1);
+        auto& book = books_[index];
+        if(!book) {
+            book = std::make_unique<Book>(arena_, traits_);
+            size_++;
+        }
+        return *book;
+    }
+    /// @returns book or nullptr if it was not created
+    Book* find(std::size_t index) {
+        return index < books_.size() ? books_[index].get() : nullptr;
+    }
+    const Book* find(std::size_t index) const {
+        return index < books_.size() ? books_[index].get() : nullptr;
+    }
+    /// resting orders and window of book go back to arena
+    void erase(std::size_t index) {
+        if(index < books_.size() && books_[index]) {
+            books_[index].reset();
+            size_--;
+        }
+    }
+    /// books created
+    std::size_t size() const { return size_; }
+
+    /// bytes used by book or 0 if it was not created
+    std::size_t memory_usage(std::size_t index) const {
+        auto* book = find(index);
+        return book ? book->memory_usage() : 0;
+    }
+    /// bytes used by all books
+    std::size_t memory_usage() const {
+        std::size_t bytes = 0;
+        for(auto& book: books_)
+            bytes += book ? book->memory_usage() : 0;
+        return bytes;
+    }
+    /// calls fn(index, book) for each created book
+    template<typename FnT>
+    void for_each(FnT&& fn) {
+        for(std::size_t i=0; i<books_.size(); i++)
+            if(books_[i])
+                fn(i, *books_[i]);
+    }
+    Arena& arena() { return arena_; }
+    const Arena& arena() const { return arena_; }
+private:
+    Traits traits_;
+    Arena arena_;   // outlives books
+    std::vector<std::unique_ptr<Book>> books_;
+    std::size_t size_ {0};
+};
+
+}} // ft::matching
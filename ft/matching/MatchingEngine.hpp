@@ -0,0 +1,343 @@
+#pragma once
+#include "ft/matching/OrderBook.hpp"
+#include "ft/core/Instrument.hpp"
+#include "ft/core/Order.hpp"
+#include "ft/core/Stream.hpp"
+#include "ft/core/Tick.hpp"
+#include "toolbox/util/Slot.hpp"
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string_view>
+
+namespace ft { inline namespace matching {
+
+/// Venue stand-in: matches order requests of many clients in per-instrument books in price-time priority.
+/// Each change of an order is reported to its owner as Execution, market data resulting from requests
+/// is published on best_price() as BestPrice ticks: Fill element per trade, Modify element per side
+/// whenever best price or qty changes (empty side is 0/0), same as OrderLogBook::best_price().
+/// Instrument is announced on instruments() by the first order placed for it, before anything is published for it.
+/// Server order ids, fill ids and sequences are counters, so the same requests give the same output.
+class MatchingEngine {
+public:
+    using Tick = core::Tick;
+    using TickEvent = core::TickEvent;
+    using Status = core::OrderStatusEvent;
+    using OrderRequest = core::OrderRequest;
+    using Execution = core::Execution;
+    using OrderId = core::OrderId;
+    using InstrumentUpdate = core::InstrumentUpdate;
+    /// up to this many elements are published in one tick
+    using OutputTick = core::Ticks<4>;
+    using ExecutionSignal = tb::Signal<PeerId, const Execution&>;
+
+    /// resting order, qty is signed: positive for bids, negative for asks
+    struct Order : PriceQty {
+        Order() = default;
+        Order(Price price, Qty qty)
+        : PriceQty{price, qty} {}
+        OrderId server_order_id {};
+        OrderId client_order_id {};
+        PeerId peer {};
+        Qty orig_qty {0};
+    };
+private:
+    struct Instrument;
+    struct OnFill {
+        MatchingEngine* engine {};
+        Instrument* ins {};
+        void operator()(Order& order, Order& other, Qty qty) {
+            engine->on_fill(*ins, order, other, qty);
+        }
+    };
+public:
+    using Book = OrderBook<Order, OnFill>;
+    using Traits = typename Book::OrderTraits;
+    using Arena = typename Book::Arena;
+
+    explicit MatchingEngine(Traits traits = Traits().index_size(256).max_index_size(1<<16))
+    : traits_(traits) {}
+
+    /// Handles request of peer: Add places order, Delete cancels it, Modify replaces its price and qty.
+    /// Failed requests are answered with Failed execution.
+    void on_order(PeerId peer, const OrderRequest& req, core::Timestamp now) {
+        now_ = now;
+        InstrumentId id = instrument_id(req);
+        switch(req.event()) {
+            case core::OrderEvent::Add:
+                add(instrument(id, req.symbol()), peer, req);
+                break;
+            case core::OrderEvent::Delete:
+                if(auto* ins = find_instrument(id))
+                    remove(*ins, peer, req);
+                else
+                    reject(peer, req, id);
+                break;
+            case core::OrderEvent::Modify:
+                if(auto* ins = find_instrument(id))
+                    modify(*ins, peer, req);
+                else
+                    reject(peer, req, id);
+                break;
+            default:
+                reject(peer, req, id);
+        }
+    }
+
+    /// instrument of request: its id or hash of symbol when id is empty
+    static InstrumentId instrument_id(const OrderRequest& req) {
+        if(req.instrument_id())
+            return req.instrument_id();
+        return InstrumentId(std::hash<std::string_view>{}(req.symbol()));
+    }
+
+    /// book of instrument or nullptr if no order was placed for it
+    const Book* find(InstrumentId id) const {
+        auto it = instruments_.find(id);
+        return it!=instruments_.end() ? &it->second->book : nullptr;
+    }
+    std::size_t size() const { return instruments_.size(); }
+
+    /// announcements of all known instruments, for peers which missed them
+    template<typename FnT>
+    void for_each_instrument(FnT&& fn) const {
+        for(auto& [id, ins]: instruments_)
+            fn(ins->update.template as_size<0>());
+    }
+
+    ExecutionSignal& executions() { return executions_; }
+    core::Stream::Signal<const Tick&>& best_price() { return best_price_; }
+    core::Stream::Signal<const InstrumentUpdate&>& instruments() { return instruments_signal_; }
+private:
+    static constexpr std::size_t MaxSymbolSize = 256;
+
+    struct Instrument {
+        Instrument(InstrumentId id, Arena& arena, const Traits& traits)
+        : id(id), book(arena, traits) {}
+        InstrumentId id;
+        Book book;
+        core::BasicInstrumentUpdate<2*MaxSymbolSize> update;
+        /// peer => client order id => server order id of resting orders
+        ft::unordered_map<PeerId, ft::unordered_map<OrderId, OrderId>> by_client;
+        PriceQty best[2] {};                            // last published bid, ask
+        OutputTick out {};
+        std::size_t n {0};
+    };
+
+    Instrument& instrument(InstrumentId id, std::string_view symbol) {
+        auto& ins = instruments_[id];
+        if(!ins) {
+            ins = std::make_unique<Instrument>(id, arena_, traits_);
+            announce(*ins, symbol);
+        }
+        return *ins;
+    }
+    /// ticks and executions carry the same id as instrument and venue instrument id
+    void announce(Instrument& ins, std::string_view symbol) {
+        symbol = symbol.substr(0, MaxSymbolSize);
+        auto& u = ins.update;
+        u.topic(core::StreamTopic::Instrument);
+        u.symbol(symbol);
+        u.venue_symbol(symbol);
+        u.instrument_id(ins.id);
+        u.venue_instrument_id(ins.id);
+        instruments_signal_.invoke(u.as_size<0>());
+    }
+    Instrument* find_instrument(InstrumentId id) {
+        auto it = instruments_.find(id);
+        return it!=instruments_.end() ? it->second.get() : nullptr;
+    }
+    bool valid(TickSide side, Price price, Qty qty) const {
+        return (side==TickSide::Buy || side==TickSide::Sell) && qty>0 && price>0
+            && price % traits_.mpi()==0;
+    }
+
+    /// client order ids are unique within peer
+    bool known(Instrument& ins, PeerId peer, OrderId client_id) const {
+        return client_id && ins.by_client[peer].count(client_id);
+    }
+
+    void add(Instrument& ins, PeerId peer, const OrderRequest& req) {
+        if(!valid(req.side(), req.price(), req.qty()) || known(ins, peer, req.client_order_id())) {
+            reject(peer, req, ins.id);
+            return;
+        }
+        Order order(req.price(), (ssize_t)req.side() * req.qty());
+        order.server_order_id = OrderId(++order_seq_);
+        order.client_order_id = req.client_order_id();
+        order.peer = peer;
+        order.orig_qty = req.qty();
+        report(ins, order, Status::New);
+        place(ins, std::move(order));
+        publish(ins);
+    }
+    void remove(Instrument& ins, PeerId peer, const OrderRequest& req) {
+        auto* node = find_order(ins, peer, req);
+        if(!node || node->peer!=peer) {
+            reject(peer, req, ins.id);
+            return;
+        }
+        Order order = *node;
+        ins.by_client[peer].erase(order.client_order_id);
+        ins.book.cancel(node);
+        report(ins, order, Status::Canceled);
+        publish(ins);
+    }
+    /// Order takes client order id of request if it is set, replaced one is reported as linked order id.
+    /// Decrease of qty at the same price keeps time priority, otherwise order could match at the new price.
+    void modify(Instrument& ins, PeerId peer, const OrderRequest& req) {
+        auto* node = find_order(ins, peer, req);
+        OrderId client_id = req.client_order_id() ? req.client_order_id() : node ? node->client_order_id : OrderId{};
+        if(!node || node->peer!=peer || !valid(traits_.side(*node), req.price(), req.qty())
+            || (client_id!=node->client_order_id && known(ins, peer, client_id))) {
+            reject(peer, req, ins.id);
+            return;
+        }
+        OrderId linked_id = node->client_order_id;
+        ins.by_client[peer].erase(linked_id);
+        Order order = *node;
+        order.price = req.price();
+        order.qty = (ssize_t)traits_.side(*node) * req.qty();
+        order.orig_qty = req.qty();
+        order.client_order_id = client_id;
+        report(ins, order, Status::New, linked_id);
+        auto* rest = ins.book.replace(order.server_order_id, Order(order), OnFill{this, &ins});
+        if(rest) {
+            rest->client_order_id = order.client_order_id;    // kept in place when only qty decreased
+            rest->orig_qty = order.orig_qty;
+            index(ins, *rest);
+        }
+        publish(ins);
+    }
+    void place(Instrument& ins, Order&& order) {
+        auto id = order.server_order_id;
+        if(auto* rest = ins.book.place(id, std::move(order), OnFill{this, &ins}))
+            index(ins, *rest);
+    }
+    void index(Instrument& ins, const Order& order) {
+        if(order.client_order_id)
+            ins.by_client[order.peer].emplace(order.client_order_id, order.server_order_id);
+    }
+    typename Book::Node* find_order(Instrument& ins, PeerId peer, const OrderRequest& req) {
+        OrderId id = req.server_order_id();
+        if(!id) {
+            auto& clients = ins.by_client[peer];
+            auto it = clients.find(req.linked_order_id());
+            if(it==clients.end())
+                return nullptr;
+            id = it->second;
+        }
+        return ins.book.find(id);
+    }
+
+    /// called before qty of orders is reduced by fill
+    void on_fill(Instrument& ins, Order& order, Order& other, Qty qty) {
+        Identifier fill_id(++fill_seq_);
+        auto fill = [&](Order& o) {
+            Qty active = std::abs(o.qty) - qty;
+            report(ins, o, active ? Status::PartFilled : Status::Filled, active, qty, fill_id, other.price);
+            if(!active && &o==&other)
+                ins.by_client[o.peer].erase(o.client_order_id);
+        };
+        fill(other);
+        fill(order);
+        element(ins, TickEvent::Fill, traits_.side(order), other.price, qty);
+    }
+
+    void report(Instrument& ins, const Order& o, Status status, OrderId linked_id = {}) {
+        report(ins, o, status, std::abs(o.qty), 0, {}, o.price, linked_id);
+    }
+    void report(Instrument& ins, const Order& o, Status status, Qty active, Qty fill_qty, Identifier fill_id, Price price,
+        OrderId linked_id = {})
+    {
+        Execution e;
+        e.status(status);
+        e.sequence(++exec_seq_);
+        e.send_time(now_);
+        e.timestamp(now_);
+        e.instrument_id(ins.id);
+        e.client_order_id(o.client_order_id);
+        e.server_order_id(o.server_order_id);
+        e.linked_order_id(linked_id);
+        e.side(traits_.side(o));
+        e.price(price);
+        e.qty(active);
+        e.orig_qty(o.orig_qty);
+        e.fill_qty(fill_qty);
+        e.fill_id(fill_id);
+        executions_.invoke(o.peer, e);
+    }
+    void reject(PeerId peer, const OrderRequest& req, InstrumentId id) {
+        Execution e;
+        e.status(Status::Failed);
+        e.sequence(++exec_seq_);
+        e.send_time(now_);
+        e.timestamp(now_);
+        e.instrument_id(id);
+        e.client_order_id(req.client_order_id());
+        e.server_order_id(req.server_order_id());
+        e.linked_order_id(req.linked_order_id());
+        e.side(req.side());
+        e.price(req.price());
+        e.orig_qty(req.qty());
+        executions_.invoke(peer, e);
+    }
+
+    /// trades of the request are followed by changes of the best levels
+    void publish(Instrument& ins) {
+        for(Side side: {Side::Buy, Side::Sell}) {
+            const Book& book = ins.book;
+            auto* best = book.get_best(side);
+            auto& last = ins.best[side==Side::Sell];
+            PriceQty now {};
+            if(best)
+                now = {best->price, std::abs(best->qty)};
+            if(now.price==last.price && now.qty==last.qty)
+                continue;
+            last = now;
+            element(ins, TickEvent::Modify, side, now.price, now.qty);
+        }
+        emit(ins);
+    }
+    void element(Instrument& ins, TickEvent event, Side side, Price price, Qty qty) {
+        if(ins.n==ins.out.capacity())
+            emit(ins);
+        auto& e = ins.out[ins.n++];
+        e = core::TickElement {};
+        e.event(event);
+        e.side(side);
+        e.price(price);
+        e.qty(qty);
+    }
+    void emit(Instrument& ins) {
+        if(ins.n==0)
+            return;
+        auto& out = ins.out;
+        out.resize(ins.n);
+        out.ft_hdr.ft_len = sizeof(ft_tick_t);
+        out.ft_item_len = core::TickElement::length();
+        out.topic(core::StreamTopic::BestPrice);
+        out.event(core::Event::Update);
+        out.sequence(++tick_seq_);
+        out.instrument_id(ins.id);
+        out.venue_instrument_id(ins.id);
+        out.send_time(now_);
+        out.recv_time(now_);
+        best_price_.invoke(out.as_size<1>());
+        ins.n = 0;
+    }
+private:
+    Traits traits_;
+    Arena arena_;   // shared by books, outlives them
+    ft::unordered_map<InstrumentId, std::unique_ptr<Instrument>> instruments_;
+    core::Timestamp now_ {};
+    std::uint64_t order_seq_ {0};
+    std::uint64_t fill_seq_ {0};
+    ft_seq_t exec_seq_ {0};
+    ft_seq_t tick_seq_ {0};
+    ExecutionSignal executions_;
+    core::Stream::Signal<const Tick&> best_price_;
+    core::Stream::Signal<const InstrumentUpdate&> instruments_signal_;
+};
+
+}} // ft::matching
@@ -0,0 +1,348 @@
+#include "MatchingEngine.hpp"
+#include "ft/core/BestPriceCache.hpp"
+#include "ft/core/InstrumentsCache.hpp"
+#include "ft/utils/UnitTest.hpp"
+#include "toolbox/sys/Log.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace ft;
+
+namespace {
+
+constexpr std::size_t BENCH = 0;
+
+using TestRequest = core::BasicOrderRequest<16>;
+using ExecStatus = core::OrderStatusEvent;
+
+const PeerId Alice {1};
+const PeerId Bob {2};
+const InstrumentId Ins {7};
+
+TestRequest request(core::OrderEvent event, std::uint64_t client_id, TickSide side, Price price, Qty qty) {
+    TestRequest req;
+    req.event(event);
+    req.instrument_id(Ins);
+    req.client_order_id(OrderId(client_id));
+    req.side(side);
+    req.price(price);
+    req.qty(qty);
+    return req;
+}
+TestRequest add(std::uint64_t client_id, TickSide side, Price price, Qty qty) {
+    return request(core::OrderEvent::Add, client_id, side, price, qty);
+}
+
+/// executions by peer and ticks published by engine
+struct Output {
+    struct Report {
+        PeerId peer;
+        core::Execution e;
+    };
+    std::vector<Report> reports;
+    std::vector<core::Ticks<4>> ticks;
+
+    explicit Output(MatchingEngine& engine) {
+        engine.executions().connect(tb::bind([this](PeerId peer, const core::Execution& e) {
+            reports.push_back({peer, e});
+        }));
+        engine.best_price().connect(tb::bind([this](const core::Tick& tick) {
+            ticks.emplace_back();
+            std::memcpy(static_cast<void*>(&ticks.back()), &tick, sizeof(ft_tick_t) + tick.size()*core::TickElement::length());
+        }));
+    }
+    void clear() {
+        reports.clear();
+        ticks.clear();
+    }
+};
+
+void on_order(MatchingEngine& engine, PeerId peer, const TestRequest& req) {
+    engine.on_order(peer, req.as_size<0>(), core::Timestamp(tb::Nanos(1)));
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(MatchingEngineSuite)
+
+BOOST_AUTO_TEST_CASE(Match)
+{
+    MatchingEngine engine;
+    Output out(engine);
+    on_order(engine, Alice, add(1, TickSide::Sell, 100, 5));
+    on_order(engine, Alice, add(2, TickSide::Sell, 101, 5));
+    BOOST_REQUIRE_EQUAL(out.reports.size(), 2);
+    BOOST_CHECK(out.reports[0].e.status()==ExecStatus::New);
+    BOOST_CHECK_EQUAL(out.reports[0].e.server_order_id().low(), 1);
+    BOOST_CHECK_EQUAL(out.reports[1].e.server_order_id().low(), 2);
+    // first ask sets best, second is deeper
+    BOOST_REQUIRE_EQUAL(out.ticks.size(), 1);
+    BOOST_CHECK(out.ticks[0].topic()==core::StreamTopic::BestPrice);
+    BOOST_CHECK_EQUAL(out.ticks[0].venue_instrument_id(), Ins);
+    BOOST_CHECK_EQUAL(out.ticks[0][0].price(), 100);
+
+    out.clear();
+    on_order(engine, Bob, add(1, TickSide::Buy, 101, 7));
+    // New, then each fill is reported to resting order first
+    BOOST_REQUIRE_EQUAL(out.reports.size(), 5);
+    BOOST_CHECK(out.reports[0].peer==Bob && out.reports[0].e.status()==ExecStatus::New);
+    auto& f1 = out.reports[1];
+    BOOST_CHECK(f1.peer==Alice && f1.e.status()==ExecStatus::Filled);
+    BOOST_CHECK_EQUAL(f1.e.fill_qty(), 5);
+    BOOST_CHECK_EQUAL(f1.e.price(), 100);
+    auto& f2 = out.reports[2];
+    BOOST_CHECK(f2.peer==Bob && f2.e.status()==ExecStatus::PartFilled);
+    BOOST_CHECK_EQUAL(f2.e.qty(), 2);
+    BOOST_CHECK(f2.e.fill_id()==f1.e.fill_id());
+    BOOST_CHECK(out.reports[3].e.status()==ExecStatus::PartFilled);
+    BOOST_CHECK_EQUAL(out.reports[3].e.qty(), 3);
+    BOOST_CHECK_EQUAL(out.reports[3].e.client_order_id().low(), 2);
+    BOOST_CHECK(out.reports[4].e.status()==ExecStatus::Filled);
+    BOOST_CHECK_EQUAL(out.reports[4].e.price(), 101);
+    BOOST_CHECK_EQUAL(out.reports[4].e.orig_qty(), 7);
+    // two trades, then the new best ask
+    BOOST_REQUIRE_EQUAL(out.ticks.size(), 1);
+    auto& ti = out.ticks[0];
+    BOOST_REQUIRE_EQUAL(ti.size(), 3);
+    BOOST_CHECK(ti[0].event()==core::TickEvent::Fill && ti[0].side()==TickSide::Buy);
+    BOOST_CHECK_EQUAL(ti[1].price(), 101);
+    BOOST_CHECK_EQUAL(ti[1].qty(), 2);
+    BOOST_CHECK(ti[2].event()==core::TickEvent::Modify && ti[2].side()==TickSide::Sell);
+    BOOST_CHECK_EQUAL(ti[2].price(), 101);
+    BOOST_CHECK_EQUAL(ti[2].qty(), 3);
+    BOOST_CHECK_EQUAL(ti.bytesize(), sizeof(ft_tick_t) + 3*core::TickElement::length());
+
+    auto* book = engine.find(Ins);
+    BOOST_REQUIRE(book);
+    BOOST_CHECK_EQUAL(book->qty(101), -3);
+    BOOST_CHECK(book->empty(TickSide::Buy));
+}
+
+BOOST_AUTO_TEST_CASE(CancelModify)
+{
+    MatchingEngine engine(MatchingEngine::Traits().mpi(5).index_size(64));
+    Output out(engine);
+    on_order(engine, Alice, add(1, TickSide::Buy, 100, 5));
+    on_order(engine, Alice, add(2, TickSide::Buy, 100, 5));
+    on_order(engine, Bob, add(1, TickSide::Sell, 110, 5));
+
+    // rejected: not a multiple of price increment, duplicate client id, zero qty
+    out.clear();
+    on_order(engine, Alice, add(3, TickSide::Buy, 101, 5));
+    on_order(engine, Alice, add(1, TickSide::Buy, 95, 5));
+    on_order(engine, Bob, add(3, TickSide::Sell, 115, 0));
+    BOOST_REQUIRE_EQUAL(out.reports.size(), 3);
+    for(auto& r: out.reports)
+        BOOST_CHECK(r.e.status()==ExecStatus::Failed);
+    BOOST_CHECK(out.ticks.empty());
+
+    // order of other peer could not be canceled
+    out.clear();
+    auto cancel = request(core::OrderEvent::Delete, 0, TickSide::Buy, 0, 0);
+    cancel.server_order_id(OrderId(1));
+    on_order(engine, Bob, cancel);
+    BOOST_REQUIRE_EQUAL(out.reports.size(), 1);
+    BOOST_CHECK(out.reports[0].e.status()==ExecStatus::Failed);
+
+    // decrease of qty keeps priority, order takes new client id
+    out.clear();
+    auto modify = request(core::OrderEvent::Modify, 11, TickSide::Buy, 100, 2);
+    modify.linked_order_id(OrderId(1));
+    on_order(engine, Alice, modify);
+    BOOST_REQUIRE_EQUAL(out.reports.size(), 1);
+    BOOST_CHECK(out.reports[0].e.status()==ExecStatus::New);
+    BOOST_CHECK_EQUAL(out.reports[0].e.linked_order_id().low(), 1);
+    BOOST_CHECK_EQUAL(out.reports[0].e.qty(), 2);
+    BOOST_CHECK_EQUAL(engine.find(Ins)->qty(100), 7);
+    on_order(engine, Bob, add(2, TickSide::Sell, 100, 1));
+    auto& fill = out.reports[out.reports.size() - 2];
+    BOOST_CHECK_EQUAL(fill.e.client_order_id().low(), 11);
+    BOOST_CHECK_EQUAL(fill.e.qty(), 1);
+
+    // price change crossing the book trades at the resting price
+    out.clear();
+    modify = request(core::OrderEvent::Modify, 0, TickSide::Buy, 110, 5);
+    modify.server_order_id(OrderId(2));
+    on_order(engine, Alice, modify);
+    BOOST_REQUIRE_EQUAL(out.reports.size(), 3);
+    BOOST_CHECK_EQUAL(out.reports[0].e.client_order_id().low(), 2);
+    BOOST_CHECK(out.reports[1].peer==Bob && out.reports[1].e.status()==ExecStatus::Filled);
+    BOOST_CHECK(out.reports[2].peer==Alice && out.reports[2].e.status()==ExecStatus::Filled);
+    BOOST_CHECK_EQUAL(out.reports[2].e.price(), 110);
+    BOOST_CHECK(engine.find(Ins)->empty(TickSide::Sell));
+
+    // cancel by client id, the only bid left goes away
+    out.clear();
+    cancel = request(core::OrderEvent::Delete, 0, TickSide::Buy, 0, 0);
+    cancel.linked_order_id(OrderId(11));
+    on_order(engine, Alice, cancel);
+    BOOST_REQUIRE_EQUAL(out.reports.size(), 1);
+    BOOST_CHECK(out.reports[0].e.status()==ExecStatus::Canceled);
+    BOOST_CHECK_EQUAL(out.reports[0].e.qty(), 1);
+    BOOST_REQUIRE_EQUAL(out.ticks.size(), 1);
+    BOOST_CHECK_EQUAL(out.ticks[0][0].qty(), 0);
+    BOOST_CHECK(engine.find(Ins)->empty(TickSide::Buy));
+    // order is gone
+    on_order(engine, Alice, cancel);
+    BOOST_CHECK(out.reports.back().e.status()==ExecStatus::Failed);
+}
+
+/// Si futures in core prices, as a client sees the simulator: instrument is announced before its ticks,
+/// symbol resolves to best prices, trades happen at resting prices far beyond int range
+BOOST_AUTO_TEST_CASE(CorePrices)
+{
+    constexpr Price M = core::CorePriceMultiplier;     // Si price step is 1 rub
+    MatchingEngine engine(MatchingEngine::Traits().mpi(M).index_size(256).max_index_size(1<<16));
+    Output out(engine);
+    core::InstrumentsCache instruments;
+    core::BestPriceCache bestprice;
+    std::vector<core::BasicInstrumentUpdate<64>> updates;
+    std::size_t unknown = 0;    // ticks of instruments not announced yet
+    instruments.connect(engine);
+    engine.instruments().connect(tb::bind([&](const core::InstrumentUpdate& u) {
+        updates.emplace_back();
+        std::memcpy(static_cast<void*>(&updates.back()), &u, u.ft_hdr.ft_len);
+    }));
+    engine.best_price().connect(tb::bind([&](const core::Tick& tick) {
+        auto announced = [&](auto& u) { return u.venue_instrument_id()==tick.venue_instrument_id(); };
+        if(std::none_of(updates.begin(), updates.end(), announced))
+            unknown++;
+        bestprice.update(tick.as_size<MatchingEngine::OutputTick::capacity()>());
+    }));
+    auto si = [&](std::uint64_t client_id, TickSide side, Price price, Qty qty) {
+        auto req = add(client_id, side, price, qty);
+        req.instrument_id({});
+        req.symbol("Si-3.21");
+        return req;
+    };
+    on_order(engine, Alice, si(1, TickSide::Sell, 73010*M, 5));
+    on_order(engine, Alice, si(2, TickSide::Sell, 73005*M, 3));
+    on_order(engine, Bob, si(1, TickSide::Buy, 72930*M, 2));
+    on_order(engine, Bob, si(2, TickSide::Buy, 72000*M, 10));
+    BOOST_REQUIRE_EQUAL(updates.size(), 1);
+    auto& u = updates[0];
+    BOOST_CHECK(u.topic()==core::StreamTopic::Instrument);
+    BOOST_CHECK_EQUAL(u.symbol(), "Si-3.21");
+    BOOST_CHECK_EQUAL(u.venue_symbol(), "Si-3.21");
+    BOOST_CHECK_EQUAL(u.instrument_id(), u.venue_instrument_id());
+    BOOST_REQUIRE(engine.find(u.instrument_id()));
+    BOOST_CHECK_EQUAL(unknown, 0);
+    for(auto& r: out.reports)
+        BOOST_CHECK(r.e.status()==ExecStatus::New && r.e.instrument_id()==u.instrument_id());
+
+    // takes 3 at 73005 and 1 at 73010, nothing crosses with bids
+    out.clear();
+    on_order(engine, Bob, si(3, TickSide::Buy, 73010*M, 4));
+    BOOST_REQUIRE_EQUAL(out.reports.size(), 5);
+    BOOST_CHECK(out.reports[1].peer==Alice && out.reports[1].e.status()==ExecStatus::Filled);
+    BOOST_CHECK_EQUAL(out.reports[1].e.price(), 73005*M);
+    BOOST_CHECK_EQUAL(out.reports[2].e.fill_qty(), 3);
+    BOOST_CHECK_EQUAL(out.reports[2].e.price(), 73005*M);
+    BOOST_CHECK(out.reports[3].peer==Alice && out.reports[3].e.status()==ExecStatus::PartFilled);
+    BOOST_CHECK_EQUAL(out.reports[3].e.qty(), 4);
+    BOOST_CHECK(out.reports[4].peer==Bob && out.reports[4].e.status()==ExecStatus::Filled);
+    BOOST_CHECK_EQUAL(out.reports[4].e.price(), 73010*M);
+
+    auto* ins = instruments.find("Si-3.21");
+    BOOST_REQUIRE(ins);
+    auto* bp = bestprice.find(ins->venue_instrument_id());
+    BOOST_REQUIRE(bp);
+    BOOST_CHECK_EQUAL(bp->bid_price(), 72930*M);
+    BOOST_CHECK_EQUAL(bp->bid_qty(), 2);
+    BOOST_CHECK_EQUAL(bp->ask_price(), 73010*M);
+    BOOST_CHECK_EQUAL(bp->ask_qty(), 4);
+    BOOST_CHECK_EQUAL(bp->last_price(), 73010*M);
+    BOOST_CHECK_EQUAL(bp->last_qty(), 1);
+
+    // sell sweeps bids far apart at their prices
+    out.clear();
+    on_order(engine, Alice, si(3, TickSide::Sell, 72000*M, 12));
+    BOOST_REQUIRE_EQUAL(out.reports.size(), 5);
+    BOOST_CHECK_EQUAL(out.reports[2].e.price(), 72930*M);
+    BOOST_CHECK_EQUAL(out.reports[4].e.price(), 72000*M);
+    BOOST_CHECK(out.reports[4].e.status()==ExecStatus::Filled);
+    BOOST_CHECK(engine.find(u.instrument_id())->empty(TickSide::Buy));
+    BOOST_CHECK_EQUAL(bp->bid_price(), 0);
+    BOOST_CHECK_EQUAL(bp->last_price(), 72000*M);
+
+    // off the price step
+    out.clear();
+    on_order(engine, Bob, si(4, TickSide::Buy, 72000*M + M/2, 1));
+    BOOST_REQUIRE_EQUAL(out.reports.size(), 1);
+    BOOST_CHECK(out.reports[0].e.status()==ExecStatus::Failed);
+
+    // instrument placed by id is announced once too, all of them are available for late peers
+    on_order(engine, Bob, add(5, TickSide::Buy, 100*M, 1));
+    on_order(engine, Bob, add(6, TickSide::Buy, 99*M, 1));
+    BOOST_REQUIRE_EQUAL(updates.size(), 2);
+    BOOST_CHECK_EQUAL(updates[1].instrument_id(), Ins);
+    BOOST_CHECK_EQUAL(unknown, 0);
+    std::size_t known = 0;
+    engine.for_each_instrument([&](const core::InstrumentUpdate& u) { known++; });
+    BOOST_CHECK_EQUAL(known, 2);
+}
+
+/// random flow of two peers around fixed mid, same requests give the same output
+BOOST_AUTO_TEST_CASE(Benchmark)
+{
+    constexpr std::size_t N = BENCH ? 10000000 : 100000;
+    std::vector<TestRequest> requests;
+    std::vector<PeerId> peers;
+    requests.reserve(N);
+    std::mt19937_64 gen(1);
+    for(std::size_t i=0; i<N; i++) {
+        PeerId peer = gen()&1 ? Alice : Bob;
+        std::uint64_t r = gen()%100;
+        if(r < 70 || i < 100) {
+            bool buy = gen()&1;
+            Price depth = (gen()%8) * (gen()%8);
+            Price price = buy ? 1000 - depth + 2 : 1001 + depth - 2;   // some cross the book
+            requests.push_back(add(i+1, buy ? TickSide::Buy : TickSide::Sell, price, 1 + gen()%10));
+        } else {
+            auto cancel = request(core::OrderEvent::Delete, 0, TickSide::Empty, 0, 0);
+            cancel.server_order_id(OrderId(1 + gen()%(i/2 + 1)));      // many are filled or of other peer
+            requests.push_back(cancel);
+        }
+        peers.push_back(peer);
+    }
+    auto run = [&](MatchingEngine& engine) {
+        for(std::size_t i=0; i<N; i++)
+            on_order(engine, peers[i], requests[i]);
+    };
+    std::size_t runs = 0;
+    maybe_bench("matching_engine", BENCH, [&] {
+        MatchingEngine engine;
+        run(engine);
+        runs++;
+    });
+    if(runs>1)
+        TOOLBOX_INFO << "matching_engine: "<<N<<" requests per iteration";
+    auto digest = [&](std::size_t& reports, std::size_t& ticks) {
+        MatchingEngine engine;
+        std::size_t hash = 0;
+        Qty bought = 0, sold = 0;
+        engine.executions().connect(tb::bind([&](PeerId peer, const core::Execution& e) {
+            hash = hash*31 + e.server_order_id().low()*7 + e.fill_qty() + tb::unbox(e.status());
+            (e.side()==TickSide::Buy ? bought : sold) += e.fill_qty();
+            reports++;
+        }));
+        engine.best_price().connect(tb::bind([&](const core::Tick& tick) {
+            hash = hash*31 + tick.size();
+            ticks++;
+        }));
+        run(engine);
+        BOOST_CHECK_EQUAL(bought, sold);
+        BOOST_CHECK(bought > 0);
+        return hash;
+    };
+    std::size_t reports = 0, ticks = 0;
+    auto hash = digest(reports, ticks);
+    BOOST_CHECK(reports > N);
+    BOOST_CHECK(ticks > 0);
+    BOOST_CHECK_EQUAL(digest(reports, ticks), hash);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,157 @@
+#pragma once
+#include "ft/matching/MatchingEngine.hpp"
+#include "ft/core/Order.hpp"
+#include "ft/core/Parameters.hpp"
+#include "ft/core/Stream.hpp"
+#include "ft/core/Tick.hpp"
+#include "ft/io/Protocol.hpp"
+#include "ft/utils/Common.hpp"
+#include "toolbox/io/Buffer.hpp"
+#include "toolbox/sys/Log.hpp"
+#include "toolbox/sys/Time.hpp"
+#include "toolbox/util/Slot.hpp"
+#include <memory>
+#include <system_error>
+#include <unordered_set>
+
+namespace ft { inline namespace matching {
+
+/// Local exchange simulator as MdServer protocol ("SIM").
+/// Peers send OrderRequest messages packed back to back in datagrams, orders are matched by MatchingEngine.
+/// Executions go back to the owner of the order, resulting BestPrice ticks are sent to all peers
+/// and published on bestprice() signal. Instruments are announced the same way when their first order
+/// is placed, peer which missed the announcements gets them before its first request is handled.
+/// "mpi": price increment, "index_size", "max_index_size": level window of books, see OrderTraits
+template<class Self, typename...>
+class MatchingProtocol : public io::BasicMdProtocol<Self> {
+    FT_SELF(Self);
+protected:
+    using Base = io::BasicMdProtocol<Self>;
+public:
+    using Engine = MatchingEngine;
+    using OrderRequest = core::OrderRequest;
+    using Execution = core::Execution;
+    using BestPriceSignal = typename Base::template Signal<core::Tick>;
+    using InstrumentSignal = typename Base::template Signal<core::InstrumentUpdate>;
+
+    using Base::Base;
+    using Base::async_write_to;
+
+    constexpr std::string_view name() { return "SIM"; }
+
+    void on_parameters_updated(const core::Parameters& params) {
+        Base::on_parameters_updated(params);
+        auto traits = Engine::Traits()
+            .mpi(params.value_or("mpi", 1))
+            .index_size(params.value_or("index_size", 256))
+            .max_index_size(params.value_or("max_index_size", 1<<16));
+        make_engine(traits);
+        TOOLBOX_INFO << name()<<": mpi:"<<traits.mpi()<<", index_size:"<<traits.index_size()<<", max_index_size:"<<traits.max_index_size();
+    }
+
+    void open() {
+        Base::open();
+        if(!engine_)
+            make_engine(Engine::Traits().index_size(256).max_index_size(1<<16));
+    }
+
+    /// datagram could contain several requests packed back to back
+    template<class ConnT, class PacketT, class DoneT>
+    void async_handle(ConnT& conn, const PacketT& e, DoneT done) {
+        std::error_code ec{};
+        auto& buf = e.buffer();
+        const char* ptr = reinterpret_cast<const char*>(buf.data());
+        const char* end = ptr + buf.size();
+        auto now = tb::WallClock::now();
+        if(announced_.insert(conn.id()).second) {
+            engine_->for_each_instrument([&](const core::InstrumentUpdate& u) {
+                self()->async_write_to(conn, u, tb::bind([](ssize_t size, std::error_code ec) {
+                    if(ec)
+                        TOOLBOX_ERROR << "SIM: instrument write failed, ec:"<<ec;
+                }));
+            });
+        }
+        while(ptr < end) {
+            const OrderRequest& req = *reinterpret_cast<const OrderRequest*>(ptr);
+            if(end - ptr < (ssize_t)sizeof(ft_order_t) || req.length() < sizeof(ft_order_t)
+                || end - ptr < (ssize_t)req.bytesize() || req.topic()!=core::StreamTopic::OrderStatus) {
+                TOOLBOX_ERROR << name()<<": malformed request of "<<(end - ptr)<<" bytes from "<<conn.remote();
+                ec = std::make_error_code(std::errc::invalid_argument);
+                break;
+            }
+            TOOLBOX_DEBUG << name()<<": in: "<<req;
+            engine_->on_order(conn.id(), req, now);
+            ptr += req.bytesize();
+        }
+        done(ec);
+    }
+
+    /// ticks are sent as is, including ones forwarded to the server from other sources
+    template<typename ConnT, typename DoneT>
+    void async_write_to(ConnT& conn, const core::Tick& tick, DoneT done) {
+        std::size_t size = sizeof(ft_tick_t) + tick.size()*core::TickElement::length();
+        conn.async_write(tb::ConstBuffer{&tick, size}, done);
+    }
+    /// update is sent with its symbols
+    template<typename ConnT, typename DoneT>
+    void async_write_to(ConnT& conn, const core::InstrumentUpdate& u, DoneT done) {
+        conn.async_write(tb::ConstBuffer{&u, u.ft_hdr.ft_len}, done);
+    }
+
+    void on_peer_closed(PeerId id) {
+        Base::on_peer_closed(id);
+        announced_.erase(id);
+    }
+
+    void on_execution(PeerId id, const Execution& e) {
+        TOOLBOX_DEBUG << name()<<": out: "<<e;
+        auto* peer = self()->get_peer(id);
+        if(!peer)
+            return;     // peer is gone, its orders stay in the book
+        self()->async_write_to(*peer, e, tb::bind([](ssize_t size, std::error_code ec) {
+            if(ec)
+                TOOLBOX_ERROR << "SIM: execution write failed, ec:"<<ec;
+        }));
+    }
+    void on_best_price(const core::Tick& tick) {
+        self()->async_write(tick, tb::bind([](ssize_t size, std::error_code ec) {
+            if(ec)
+                TOOLBOX_ERROR << "SIM: tick write failed, ec:"<<ec;
+        }));
+        bestprice().invoke(tick, nullptr);
+    }
+    void on_instrument(const core::InstrumentUpdate& u) {
+        TOOLBOX_INFO << name()<<": new instrument: "<<u;
+        self()->async_write(u, tb::bind([](ssize_t size, std::error_code ec) {
+            if(ec)
+                TOOLBOX_ERROR << "SIM: instrument write failed, ec:"<<ec;
+        }));
+        instruments().invoke(u, nullptr);
+    }
+
+    Engine& engine() { return *engine_; }
+    /// books are dropped with their orders and instruments
+    void make_engine(const typename Engine::Traits& traits) {
+        engine_ = std::make_unique<Engine>(traits);
+        announced_.clear();
+        engine_->executions().connect(tb::bind([this](PeerId id, const Execution& e) {
+            on_execution(id, e);
+        }));
+        engine_->best_price().connect(tb::bind([this](const core::Tick& tick) {
+            on_best_price(tick);
+        }));
+        engine_->instruments().connect(tb::bind([this](const core::InstrumentUpdate& u) {
+            on_instrument(u);
+        }));
+    }
+
+    auto& bestprice() { return bestprice_signal_; }
+    auto& instruments() { return instruments_signal_; }
+protected:
+    std::unique_ptr<Engine> engine_;
+    BestPriceSignal bestprice_signal_;
+    InstrumentSignal instruments_signal_;
+    std::unordered_set<PeerId> announced_;      // peers which got known instruments
+};
+
+}} // ft::matching
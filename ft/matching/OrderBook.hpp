@@ -1,16 +1,24 @@
 #pragma once
 #include "ft/utils/Common.hpp"
+#include "ft/utils/OccupancyBitmap.hpp"
+#include "ft/matching/BookArena.hpp"
 #include "ft/core/Tick.hpp"
 #include "toolbox/sys/Time.hpp"
-#include "toolbox/util/Pool.hpp"
-#include <boost/intrusive/circular_list_algorithms.hpp>
 #include <boost/intrusive/list.hpp>
 #include <boost/intrusive/list_hook.hpp>
+#include <algorithm>
+#include <array>
 #include <cstdint>
+#include <cstdlib>
 #include <functional>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
 #include <vector>
 #include <deque>
 #include <cmath>
+#include <utility>
 #include <ostream>
 
 
@@ -24,30 +32,41 @@ inline Side operator-(Side rhs) {
 
 template<typename OrderT,
 typename PriceT=Price,
-typename QtyT=Qty>
+typename QtyT=Qty,
+typename OrderIdT=ExchangeId>
 class OrderTraits {
 public:
     using Price=PriceT;
     using Qty=QtyT;
+    using OrderId=OrderIdT;
 
-    int compare(const PriceT &lhs, const PriceT &rhs) {
-        return lhs-rhs;
+    /// @returns sign of lhs-rhs, the difference itself could overflow int
+    int compare(const PriceT &lhs, const PriceT &rhs) const {
+        return (lhs>rhs) - (lhs<rhs);
     }
     void print(std::ostream &os, Price &price) {
         os << (double) price/pow(10., exp10_);
     }
-    PriceT price(const OrderT &order) {
+    PriceT price(const OrderT &order) const {
         return order.price;
     }
-    QtyT qty(const OrderT &order) {
+    QtyT qty(const OrderT &order) const {
         return order.qty;
     }
-    ssize_t to_long(PriceT price) {
+    ssize_t to_long(PriceT price) const {
         return price / mpi_;
     }
-    PriceT to_price(ssize_t price_index) {
+    PriceT to_price(ssize_t price_index) const {
         return price_index * mpi_;
     }
+    /// minimal price increment, one level of the book
+    PriceT mpi() const {
+        return mpi_;
+    }
+    OrderTraits& mpi(PriceT val) {
+        mpi_ = val;
+        return *this;
+    }
     std::size_t book_size() {
         return book_size_;
     }
@@ -55,14 +74,23 @@ public:
         book_size_ = val;
         return *this;
     }
-    std::size_t index_size() {
+    /// levels in price window of the book, rounded up to power of 2
+    std::size_t index_size() const {
         return index_size_;
     }
     OrderTraits& index_size(std::size_t val) {
         index_size_ = val;
         return *this;
     }
-    Side side(const OrderT &order) {
+    /// window grows up to this size when best bid and ask do not fit into it, 0 = fixed window
+    std::size_t max_index_size() const {
+        return max_index_size_;
+    }
+    OrderTraits& max_index_size(std::size_t val) {
+        max_index_size_ = val;
+        return *this;
+    }
+    Side side(const OrderT &order) const {
         static Side sides[2] = {Side::Buy, Side::Sell};
         return sides[order.qty<0];
     }
@@ -70,21 +98,27 @@ private:
     long exp10_;
     std::size_t book_size_ = 4096;
     std::size_t index_size_ = 256;
+    std::size_t max_index_size_ = 0;
     PriceT mpi_{1};
 };
 
 
 
+/// called per fill with aggressive and resting orders before their qty is reduced by fill qty
 template<typename OrderT>
 struct DoNothingOnFill {
-    void operator()(OrderT& order, OrderT& other) {}
+    template<typename QtyT>
+    void operator()(OrderT& order, OrderT& other, QtyT qty) {}
 };
 
 namespace bi = boost::intrusive;
 /*
     @brief OrderBook
-        arena is slabs list;
-        each Node is intrusive list
+        levels window is circular array indexed by price ticks, level of tick t is levels[t mod size];
+        levels outside of the window are kept in sorted overflow map;
+        each Level is intrusive list of orders in time priority.
+        Nodes and window come from arena which could be shared by many books, window is allocated
+        on the first order and grows when much of the activity falls outside of it.
 */
 template<
     typename OrderT = PriceQty,
@@ -97,16 +131,20 @@ public:
     using Qty = typename OrderTraits::Qty;
     using Order = OrderT;
     using OnFill = OnFillT;
+    using OrderId = typename OrderTraits::OrderId;
 
     struct Node : OrderT
                 , bi::list_base_hook<>
     {
         Node() {}
-        Node(OrderT &&order) : OrderT(order) {}
+        Node(const OrderT &order) : OrderT(order) {}
+        OrderId id {};
+        bool indexed {false};   // placed by id
     };
 
+    /// qty is sum of qty of orders on the level
     struct Level : PriceQty
-                 , bi::list<Node>   // linked list of non-empty levels
+                 , bi::list<Node>   // orders in time priority
                  , bi::list_base_hook<>
     {
        using Base = bi::list<Node>;
@@ -114,61 +152,175 @@ public:
        using typename Base::iterator;
     };
     
-    using LevelsArray = std::vector<Level>;
-
+    using Arena = BookArena<Node, Level>;
+private:
+    static constexpr ssize_t NoTick = std::numeric_limits<ssize_t>::min();
+    /// levels window allocated from arena
+    struct Window {
+        Level* data() const { return data_; }
+        std::size_t size() const { return size_; }
+        Level& operator[](std::size_t i) const { return data_[i]; }
+        Level* data_ {nullptr};
+        std::size_t size_ {0};
+    };
 public:
+    /// book with arena of its own
     OrderBook(OrderTraitsT traits = OrderTraitsT{})
     : traits(traits)
-    {
-        auto index_size = this->traits.index_size();
-        levels.resize(index_size);
-        low = &levels[0];
+    , own_arena_(std::make_unique<Arena>(0))
+    , arena_(own_arena_.get())
+    {}
+    /// book sharing arena with other books, arena should outlive the book
+    OrderBook(Arena& arena, OrderTraitsT traits = OrderTraitsT{})
+    : traits(traits)
+    , arena_(&arena)
+    {}
+    OrderBook(const OrderBook&) = delete;
+    OrderBook& operator=(const OrderBook&) = delete;
+    /// resting orders and window are returned to arena
+    ~OrderBook() {
+        auto dispose = [this](Node* node) { arena_->dealloc_node(node); };
+        for(std::size_t i=0; i<levels.size(); i++)
+            levels[i].clear_and_dispose(dispose);
+        for(auto& [tick, level]: overflow_)
+            level.clear_and_dispose(dispose);
+        arena_->dealloc_levels(levels.data(), levels.size());
     }
 
-    Qty try_fill(Order& order) {
+    /// Matches order against opposite side in price-time priority, order qty is reduced by filled qty.
+    /// Filled resting orders are removed from the book and released, their nodes should not be used after.
+    /// @returns qty left
+    Qty try_fill(Order& order, OnFill& on_fill) {
         Side side = traits.side(order);
-        Qty active_qty = traits.qty(order);
-        if(active_qty>0 && !empty(-side)) {
-            // do fills, mutate active qty
+        Level*& best = get_best(-side);
+        while(order.qty!=0 && best && crosses(side, order.price, best->price)) {
+            Level* level = best;
+            for(auto it = level->begin(); it!=level->end() && order.qty!=0;) {
+                Node& other = *it;
+                // qty of buy is positive, of sell negative
+                Qty qty = std::min(std::abs(order.qty), std::abs(other.qty));
+                on_fill(order, static_cast<Order&>(other), qty);
+                Qty signed_qty = (ssize_t)side * qty;
+                order.qty -= signed_qty;
+                other.qty += signed_qty;
+                level->qty += signed_qty;
+                if(other.qty==0) {
+                    it = level->erase(it);
+                    release(&other);
+                } else {
+                    ++it;
+                }
+            }
+            if(!level->empty())
+                break;
+            on_emptied(-side, level);
         }
-        return active_qty;
+        recenter_on_best();
+        return order.qty;
+    }
+    Qty try_fill(Order& order) {
+        OnFill on_fill {};
+        return try_fill(order, on_fill);
     }
 
+    /// matches order and places the rest into the book
+    /// @returns resting order or nullptr if order was filled completely
     FT_NO_INLINE
     Node *place(Order &&order, OnFill on_fill = OnFill{}) {
-        Qty active_qty = try_fill(order);
+        Qty active_qty = try_fill(order, on_fill);
         if(active_qty==0)
             return nullptr;
+        return rest(order);
+    }
+    FT_NO_INLINE
+    bool cancel(Node *order) {
+        unlink(order);
+        release(order);
+        recenter_on_best();
+        return true;
+    }
 
-        Node* node = pool.alloc(order);
-        Side side = traits.side(order);
-        Level& lvl = get_level(side, order.price);
-        lvl.push_back(*node);
-
+    /// places order under exchange order id, then the rest of it could be found, reduced or replaced by id.
+    /// Order already placed under the same id is removed.
+    Node *place(const OrderId& id, Order &&order, OnFill on_fill = OnFill{}) {
+        cancel(id);
+        Node* node = place(std::move(order), on_fill);
+        if(node)
+            index_order(id, node);
         return node;
     }
-    bool cancel(Node *order) {
-        auto side = traits.side(*order);
-        auto shift = traits.to_long(order->price) - traits.to_long(low->price);
-        Level* level = get_shifted_level(low, shift);
-        level->erase(Level::s_iterator_to(*order));
-        Level*& best = get_best(side);
-        if(level==best && level->empty()) {
-            // scan new best
-            const Level* end = get_outlier(-side);
-            while(best!=end) {
-                best = get_shifted_level(best, -(ssize_t)side);
-                if(!best->empty())
-                    break;
+    /// Puts order into the book without matching, for venues reporting fills themselves (order logs).
+    /// Order crossing the opposite side would share its level, so caller should not insert such orders.
+    Node *insert(const OrderId& id, const Order& order) {
+        cancel(id);
+        Node* node = rest(order);
+        index_order(id, node);
+        return node;
+    }
+    Node* find(const OrderId& id) {
+        auto it = orders_.find(id);
+        return it!=orders_.end() ? it->second : nullptr;
+    }
+    /// @returns false if order is not in the book, e.g. it was filled
+    bool cancel(const OrderId& id) {
+        auto* node = find(id);
+        return node ? cancel(node) : false;
+    }
+    /// reduces qty of order by qty keeping time priority, order is removed when nothing is left
+    bool reduce(const OrderId& id, Qty qty) {
+        auto* node = find(id);
+        if(!node)
+            return false;
+        qty = std::min(std::abs(qty), std::abs(node->qty));
+        Qty signed_qty = (ssize_t)traits.side(*node) * qty;
+        if(signed_qty==node->qty)
+            return cancel(node);
+        node->qty -= signed_qty;
+        find_level(node->price)->qty -= signed_qty;
+        return true;
+    }
+    /// Changes price and qty of order. Decrease of qty at the same price keeps time priority,
+    /// otherwise order goes to the end of the queue at the new price and could match there.
+    /// @returns resting order or nullptr if it was filled or not found
+    Node *replace(const OrderId& id, Order &&order, OnFill on_fill = OnFill{}) {
+        auto* node = find(id);
+        if(!node)
+            return nullptr;
+        if(order.price==node->price && traits.side(order)==traits.side(*node)
+            && std::abs(order.qty)<=std::abs(node->qty)) {
+            if(order.qty==0) {
+                cancel(node);
+                return nullptr;
             }
-            if(best==end)
-                best = nullptr;
+            find_level(node->price)->qty += order.qty - node->qty;
+            node->qty = order.qty;
+            return node;
         }
-        pool.dealloc(order);
-        return true;
+        cancel(node);
+        return place(id, std::move(order), on_fill);
+    }
+    /// orders placed by id
+    std::size_t orders_size() const { return orders_.size(); }
+    /// all resting orders
+    std::size_t nodes_size() const { return nodes_size_; }
+    /// approximate bytes used by the book: window, overflow levels, resting orders and their id index
+    std::size_t memory_usage() const {
+        constexpr std::size_t TreeNode = 4*sizeof(void*);
+        return levels.size()*sizeof(Level) + levels.size()/8
+            + overflow_.size()*(sizeof(typename decltype(overflow_)::value_type) + TreeNode)
+            + nodes_size_*sizeof(Node)
+            + orders_.size()*(sizeof(OrderId) + sizeof(Node*));
     }
-    bool empty(Side side) {
-        return get_best(side)!=nullptr;
+    /// sum of qty of orders on price level, positive for bids and negative for asks
+    Qty qty(const Price& price) const {
+        auto tick = traits.to_long(price);
+        if(in_window(tick))
+            return levels[index(tick)].qty;
+        auto it = overflow_.find(tick);
+        return it!=overflow_.end() ? it->second.qty : Qty{};
+    }
+    bool empty(Side side) const {
+        return get_best(side)==nullptr;
     }
 
     struct LevelsView {
@@ -181,14 +333,7 @@ public:
                 return *current_;
             }
             LevelsViewIterator& operator++() {
-                Side side = view_.side();
-                auto const & book = view_.book();
-                const Level* end = book.get_outlier(-side);
-                while(current_!=end) {
-                    current_ = book.get_shifted_level(current_, -(ssize_t)side);
-                    if(!current_->empty())
-                        return *this;
-                }
+                current_ = view_.book().next_level(current_, view_.side());
                 return *this;
             }
             bool operator!=(const LevelsViewIterator &rhs) {
@@ -219,7 +364,7 @@ public:
                 return end();
         }
         LevelsViewIterator end() {
-            return LevelsViewIterator(*this, book_.get_outlier(-side_));
+            return LevelsViewIterator(*this, nullptr);
         }
         const OrderBook &book_;
         Side side_;
@@ -229,111 +374,318 @@ public:
         return LevelsView(*this, side);
     }
 
+    /// index in levels window or -1 for overflow level
     ssize_t level_to_index(const Level *lvl) const {
-        return lvl ? (-1): (lvl - levels.data());
+        return lvl && lvl>=levels.data() && lvl<levels.data()+levels.size() ? (lvl - levels.data()) : (-1);
     }
 
     Level* get_best(Side side) const {
        return best_level[side_to_index(side)];
     }
 
-    /// get low/high level by side.
-    /// low/high levels contain all orders with price less or equal/greater or equal to the level price.
-    const Level* get_outlier(Side side) const {
-        ssize_t index = low - levels.data();
-        index = (index - side_to_index(side)) % levels.size();
-        return &levels[index];
-    }
+    /// prices of levels window
+    Price low_price() const { return traits.to_price(low_); }
+    Price high_price() const { return traits.to_price(low_ + window_size() - 1); }
+    std::size_t window_size() const { return levels.size(); }
+    /// levels outside of window
+    std::size_t overflow_size() const { return overflow_.size(); }
 
-
-    // OrdersContainer& get_orders() const
 private:
-    using cla = boost::intrusive::circular_list_algorithms<Node>;
-    /// ensure dist(L, B) ~= dist(A, H)
-    void rebalance() {
-        ssize_t dist[2] = {
-            (get_best(Side::Buy)-get_outlier(Side::Buy)) % levels.size(),
-            (get_best(Side::Sell)-get_outlier(Side::Sell)) % levels.size(),
-        };
-        for(;;) {
-            ssize_t imbalance = dist[0] - dist[1];
-            if(imbalance < -1) {
-                // bid space should be increased, shifting L down
-                Level* high = get_outlier(Side::Sell);
-                Level* new_high = get_shifted_level(high, -1);
-                // transfer high's orders to new_high
-                cla::transfer(new_high->end(), high->begin(), high->end());
-                // shift low|high down
-                low = high;
-            } else if(imbalance > 1) {
-                // ask space should be increased, shifting H up
-                Level* new_low = get_shifted_level(low, 1);
-                // transfer low's orders to new_low
-                cla::transfer(new_low->end(), low->begin(), low->end());
-                // shift low|high up
-                low = new_low;
-            } else 
-                break;  // 0,+1,-1 is OK
-        }
+    /// window size is power of 2
+    std::size_t index(ssize_t tick) const {
+        return static_cast<std::size_t>(tick) & (levels.size() - 1);
     }
-    /// get level for side and price in the levels circular buffer
+    bool in_window(ssize_t tick) const {
+        return tick>=low_ && tick<low_ + (ssize_t)levels.size();
+    }
+    /// existing level of the price
+    Level* find_level(const Price& price) {
+        auto tick = traits.to_long(price);
+        if(in_window(tick))
+            return &levels[index(tick)];
+        auto it = overflow_.find(tick);
+        return it!=overflow_.end() ? &it->second : nullptr;
+    }
+    /// get level for side and price, updating best of side.
+    /// Window is moved when top of the book leaves it, deeper levels go to overflow.
     Level& get_level(Side side, const Price &price) {
+        if(levels.size()==0)
+            allocate_window();
+        if(++placed_ >= levels.size()*4)
+            adapt_window();
+        auto tick = traits.to_long(price);
         Level*& best = get_best(side);
-        Level*& opp_best = get_best(-side);
-
-        if(/*FT_LIKELY*/(best)) {
-            // our not empty
-            auto prc = traits.to_long(price);
-            auto base_prc = traits.to_long(best->price);
-            Level* lvl = get_level(best, prc - base_prc, side);
-            //lvl->price = price;
-            if(((ssize_t)side)*traits.compare(prc, base_prc)>0) {
-                best = lvl;
+        if(!best && !get_best(-side)) {
+            move_window(tick - (ssize_t)levels.size()/2);
+        } else if(!in_window(tick) && (!best || (ssize_t)side * (tick - traits.to_long(best->price)) > 0)) {
+            recenter(tick, get_best(-side));
+        }
+        Level* lvl;
+        if(in_window(tick)) {
+            lvl = &levels[index(tick)];
+        } else {
+            lvl = &overflow_[tick];
+            lvl->price = price;
+            overflow_placed_++;
+        }
+        if(!best || (ssize_t)side * (tick - traits.to_long(best->price)) > 0)
+            best = lvl;
+        return *lvl;
+    }
+    Node* rest(const Order& order) {
+        Node* node = arena_->alloc_node(order);
+        nodes_size_++;
+        Side side = traits.side(order);
+        Level& lvl = get_level(side, order.price);
+        if(lvl.empty() && in_window(traits.to_long(lvl.price)))
+            occupied_.set(index(traits.to_long(lvl.price)));
+        lvl.push_back(*node);
+        lvl.qty += order.qty;
+        return node;
+    }
+    void index_order(const OrderId& id, Node* node) {
+        node->id = id;
+        node->indexed = true;
+        orders_.emplace(id, node);
+    }
+    /// aggressive order of side with price crosses resting price
+    bool crosses(Side side, const Price& price, const Price& resting) const {
+        return (ssize_t)side * traits.compare(price, resting) >= 0;
+    }
+    void unlink(Node* order) {
+        auto side = traits.side(*order);
+        Level* level = find_level(order->price);
+        level->erase(Level::s_iterator_to(*order));
+        level->qty -= order->qty;
+        if(level->empty())
+            on_emptied(side, level);
+    }
+    void release(Node* order) {
+        if(order->indexed)
+            orders_.erase(order->id);
+        nodes_size_--;
+        arena_->dealloc_node(order);
+    }
+    /// level of side became empty: next best is found, empty overflow level is dropped
+    void on_emptied(Side side, Level* level) {
+        auto tick = traits.to_long(level->price);
+        Level*& best = get_best(side);
+        if(level==best)
+            best = next_level(level, side);
+        if(in_window(tick))
+            occupied_.reset(index(tick));
+        else
+            overflow_.erase(tick);
+    }
+    /// next non-empty level towards worse prices of side or nullptr
+    const Level* next_level(const Level* level, Side side) const {
+        auto tick = traits.to_long(level->price);
+        ssize_t size = levels.size();
+        const Level* result = nullptr;
+        if(side==Side::Sell) {
+            // ascending ticks, window then overflow above it
+            if(tick + 1 < low_ + size) {
+                auto from = std::max(tick + 1, low_);
+                auto found = find_occupied(from - low_, size - 1, side);
+                if(found!=NoTick)
+                    return &levels[index(low_ + found)];
+            }
+            auto it = overflow_.upper_bound(tick);
+            if(it!=overflow_.end() && it->first < low_) {
+                return &it->second;     // below window
             }
-            return *lvl;
-        } else if(opp_best) {
-            // opposite side not empty
-            auto base_prc = traits.to_long(opp_best->price);
-            auto prc = traits.to_long(price);
-            best = get_level(opp_best, prc - base_prc, side);
-            //best->price = price;
-            return *best;
-        } else { // empty book
-            // empty book
-            best = &levels[levels.size()/2];
-            // initialize prices of levels
-            for(Level& level: levels) {
-                level.price = traits.to_price(traits.to_long(price)+(&level-best));
+            it = overflow_.upper_bound(std::max(tick, low_ + size - 1));
+            if(it!=overflow_.end())
+                result = &it->second;
+        } else {
+            if(tick - 1 >= low_) {
+                auto from = std::min(tick - 1, low_ + size - 1);
+                auto found = find_occupied(from - low_, 0, side);
+                if(found!=NoTick)
+                    return &levels[index(low_ + found)];
             }
-            return *best;
+            auto it = overflow_.lower_bound(tick);
+            if(it!=overflow_.begin() && std::prev(it)->first >= low_ + size)
+                return &std::prev(it)->second;     // above window
+            it = overflow_.lower_bound(std::min(tick, low_));
+            if(it!=overflow_.begin())
+                result = &std::prev(it)->second;
         }
+        return result;
     }
-    /// shift level of side by offset given in shift, returning existing or new level of that side.
-    /// if no more space to shift, outlier level will be returned
-    /// L . . . . B . . . A . . H
-    /// . . H L . . . B . . . A .
-    Level* get_level(Level* base, ssize_t shift, Side side) {
-        ssize_t base_index = base - levels.data();
-        ssize_t space_left = (get_outlier(side) - base) % levels.size();
-        // clamp shift
-        if(shift>0 && shift>space_left)
-            shift = space_left;
-        if(shift<0 && shift<space_left)
-            shift = space_left;
-        ssize_t dest_index = (base_index + shift) % levels.size();
-        return &levels[dest_index];
-    }
-    Level* get_shifted_level(const Level* base, ssize_t shift) {
-        ssize_t base_index = base - levels.data();
-        base_index = (base_index + shift) % levels.size();
-        return &levels[base_index];
+    Level* next_level(Level* level, Side side) {
+        return const_cast<Level*>(std::as_const(*this).next_level(level, side));
+    }
+    /// nearest occupied window offset from `from` towards `to`, offsets are from the window low.
+    /// Offsets map to one or two ranges of levels array.
+    ssize_t find_occupied(ssize_t from, ssize_t to, Side side) const {
+        constexpr auto npos = OccupancyBitmap::npos;
+        std::size_t size = levels.size();
+        std::size_t first = index(low_ + from), last = index(low_ + to);
+        std::size_t found;
+        if(side==Side::Sell) {
+            found = occupied_.find_next(first);
+            if(first <= last) {
+                if(found!=npos && found > last)
+                    found = npos;
+            } else if(found==npos) {
+                found = occupied_.find_next(0);     // wrapped around the end of array
+                if(found!=npos && found > last)
+                    found = npos;
+            }
+        } else {
+            found = occupied_.find_prev(first);
+            if(first >= last) {
+                if(found!=npos && found < last)
+                    found = npos;
+            } else if(found==npos) {
+                found = occupied_.find_prev(size - 1);
+                if(found!=npos && found < last)
+                    found = npos;
+            }
+        }
+        if(found==npos)
+            return NoTick;
+        return (found - index(low_)) & (size - 1);
     }
 
-    const Level* get_shifted_level(const Level* base, ssize_t shift) const {
-        ssize_t base_index = base - levels.data();
-        base_index = (base_index + shift) % levels.size();
-        return &levels[base_index];
+    /// Moves window so both best prices fit into it, window grows up to traits max_index_size when they do not.
+    /// tick is new best of the side opposite to opp_best
+    void recenter(ssize_t tick, const Level* opp_best) {
+        ssize_t center = tick;
+        if(opp_best) {
+            auto opp_tick = traits.to_long(opp_best->price);
+            ssize_t spread = std::abs(tick - opp_tick);
+            while(spread >= (ssize_t)levels.size()/2 && levels.size()*2 <= traits.max_index_size())
+                grow();
+            if(spread < (ssize_t)levels.size())
+                center = tick + (opp_tick - tick)/2;
+        }
+        move_window(center - (ssize_t)levels.size()/2);
+    }
+    /// best level left window after fills or cancels
+    void recenter_on_best() {
+        for(auto* best: best_level) {
+            if(best && !in_window(traits.to_long(best->price))) {
+                recenter_on_best_slow();
+                return;
+            }
+        }
+    }
+    /// window stays if the other best is in it and both do not fit
+    FT_NO_INLINE
+    void recenter_on_best_slow() {
+        for(Side side: {Side::Buy, Side::Sell}) {
+            Level* best = get_best(side);
+            if(!best || in_window(traits.to_long(best->price)))
+                continue;
+            Level* opp = get_best(-side);
+            if(opp && in_window(traits.to_long(opp->price))
+                && std::abs(traits.to_long(best->price) - traits.to_long(opp->price)) >= (ssize_t)levels.size()
+                && levels.size()*2 > traits.max_index_size())
+                continue;
+            recenter(traits.to_long(best->price), opp);
+            return;
+        }
+    }
+    /// levels leaving window are spliced into overflow, overflow levels entering window are spliced back
+    void move_window(ssize_t new_low) {
+        ssize_t size = levels.size();
+        if(new_low==low_)
+            return;
+        auto ticks = best_ticks();
+        ssize_t leave_from, leave_to, enter_from, enter_to;
+        if(new_low > low_) {
+            leave_from = low_;
+            leave_to = std::min(new_low, low_ + size);
+            enter_from = std::max(low_ + size, new_low);
+            enter_to = new_low + size;
+        } else {
+            leave_from = std::max(new_low + size, low_);
+            leave_to = low_ + size;
+            enter_from = new_low;
+            enter_to = std::min(low_, new_low + size);
+        }
+        evict(leave_from, leave_to);
+        for(ssize_t tick = enter_from; tick < enter_to; tick++) {
+            Level& lvl = levels[index(tick)];
+            lvl.price = traits.to_price(tick);
+            lvl.qty = 0;
+        }
+        low_ = new_low;
+        for(auto it = overflow_.lower_bound(enter_from); it!=overflow_.end() && it->first < enter_to;) {
+            Level& dst = levels[index(it->first)];
+            dst.qty = it->second.qty;
+            dst.splice(dst.end(), it->second);
+            occupied_.set(index(it->first));
+            it = overflow_.erase(it);
+        }
+        restore_best(ticks);
+    }
+    /// moves occupied window levels of ticks [from, to) to overflow
+    void evict(ssize_t from, ssize_t to) {
+        for(ssize_t ofs = from - low_; ofs < to - low_ && occupied_.any();) {
+            auto found = find_occupied(ofs, to - 1 - low_, Side::Sell);
+            if(found==NoTick)
+                break;
+            auto tick = low_ + found;
+            Level& src = levels[index(tick)];
+            Level& dst = overflow_[tick];
+            dst.price = src.price;
+            dst.qty = src.qty;
+            dst.splice(dst.end(), src);
+            src.qty = 0;
+            occupied_.reset(index(tick));
+            ofs = found + 1;
+        }
+    }
+    /// doubles window, all levels go to overflow until window is moved
+    void grow() {
+        auto ticks = best_ticks();
+        evict(low_, low_ + (ssize_t)levels.size());
+        std::size_t size = levels.size()*2;
+        arena_->dealloc_levels(levels.data(), levels.size());
+        levels = {arena_->alloc_levels(size), size};
+        occupied_.resize(size);
+        low_ = NoTick/2;    // empty window far from any price
+        restore_best(ticks);
+    }
+    /// first window of traits index_size, rounded up to power of 2
+    void allocate_window() {
+        std::size_t size = 1;
+        while(size < traits.index_size())
+            size <<= 1;
+        levels = {arena_->alloc_levels(size), size};
+        occupied_.resize(size);
+        for(ssize_t tick = low_; tick < low_ + (ssize_t)size; tick++)
+            levels[index(tick)].price = traits.to_price(tick);
     }
+    /// Window grows when over a quarter of orders placed during last 4 window sizes went to overflow
+    /// and it is still below traits max_index_size.
+    void adapt_window() {
+        bool narrow = overflow_placed_*4 > placed_;
+        placed_ = overflow_placed_ = 0;
+        if(!narrow || levels.size()*2 > traits.max_index_size())
+            return;
+        grow();
+        Level* bid = get_best(Side::Buy);
+        Level* ask = get_best(Side::Sell);
+        if(bid || ask)
+            recenter(traits.to_long((bid ? bid : ask)->price), bid ? ask : nullptr);
+    }
+    std::array<ssize_t, 2> best_ticks() const {
+        std::array<ssize_t, 2> ticks;
+        for(int i=0; i<2; i++)
+            ticks[i] = best_level[i] ? traits.to_long(best_level[i]->price) : NoTick;
+        return ticks;
+    }
+    void restore_best(const std::array<ssize_t, 2>& ticks) {
+        for(int i=0; i<2; i++) {
+            if(ticks[i]!=NoTick)
+                best_level[i] = find_level(traits.to_price(ticks[i]));
+        }
+    }
+
     /// Buy => 0, Sell => 1
     static ssize_t side_to_index(Side side) {
         return ((ssize_t)side)<0;
@@ -344,10 +696,17 @@ private:
     }
 private:
     OrderTraits traits;
-    toolbox::util::Pool<Node> pool;
-    std::vector<Level> levels;  // all levels as an indexable array 
-    Level *low {};
+    std::unique_ptr<Arena> own_arena_;
+    Arena* arena_;
+    Window levels;              // levels window, circular by price tick
+    ssize_t low_ {0};           // tick of the lowest level of window
+    OccupancyBitmap occupied_;  // non-empty levels of window
+    std::map<ssize_t, Level> overflow_;     // non-empty levels outside of window by tick
     std::array<Level*, 2> best_level {};  // best bid, best ask
+    ft::unordered_map<OrderId, Node*> orders_;  // resting orders placed by id
+    std::size_t nodes_size_ {0};
+    std::size_t placed_ {0};            // orders placed since window was adapted
+    std::size_t overflow_placed_ {0};   // of them to overflow levels
 };
 
 template<
@@ -357,10 +716,6 @@ template<
 > 
 std::ostream& operator<<(std::ostream& os, const OrderBook<OrderT, OnFillT, OrderTraitsT> &book) {
     auto print = [&](Side side) {
-        #if 0
-            os << "best "<<book.level_to_index(book.get_best(side))
-            << " out " << book.level_to_index(book.get_outlier(-side))<<"\n";
-        #endif
         for(auto& level : book.get_levels(side)) {
             os << book.level_to_index(&level)<<" [" << level.price << "]";
             for(auto& order : level) {
@@ -1,11 +1,31 @@
 #include "OrderBook.hpp"
-#include <boost/test/unit_test.hpp>
-#include "toolbox/bm/Suite.hpp"
+#include "BookManager.hpp"
+#include "ft/utils/UnitTest.hpp"
 #include "toolbox/sys/Log.hpp"
 #include <iostream>
+#include <map>
+#include <random>
 
 using namespace ft::matching;
 
+namespace {
+
+constexpr std::size_t BENCH = 0;
+
+struct Fill {
+    ft::Price price;
+    ft::Qty qty;
+    ft::Qty resting_qty;
+};
+/// records fills into vector
+struct RecordFill {
+    std::vector<Fill>* fills;
+    void operator()(ft::PriceQty& order, ft::PriceQty& other, ft::Qty qty) {
+        fills->push_back({other.price, qty, other.qty});
+    }
+};
+}
+
 BOOST_AUTO_TEST_SUITE(OrderBookTests)
 #if 1
 BOOST_AUTO_TEST_CASE(SimplePlace)
@@ -22,30 +42,358 @@ BOOST_AUTO_TEST_CASE(SimplePlace)
     std::cout << "\n\n:" << book << "\n";
 }
 #endif
-#if 0
 BOOST_AUTO_TEST_CASE(SimpleBenchmark)
 {
     TOOLBOX_INFO << "OrderBookTests/SimpleBenchmark";
-    using namespace toolbox::bm;
-    using namespace toolbox::hdr;
-
     OrderBook<> book;
-    BenchmarkSuite bm(std::cout);
-    bm.run("place_place_cancel_cancel", [&](auto& ctx) {
-        book.place({100, 1});
-        book.place({200, -2});
-        while(ctx) {
-            for(auto _:ctx.range(1000)) {
-                auto o1 = book.place({100, 10});
-                auto o2 = book.place({200, -20});
-                book.cancel(o1);
-                book.cancel(o2);
+    book.place({100, 1});
+    book.place({200, -2});
+    ft::maybe_bench("place_place_cancel_cancel", 1000*BENCH, [&] {
+        auto o1 = book.place({100, 10});
+        auto o2 = book.place({200, -20});
+        book.cancel(o1);
+        book.cancel(o2);
+    });
+    ft::maybe_bench("place_fill", 1000*BENCH, [&] {
+        book.place({150, -20});
+        book.place({150, 20});
+    });
+    // every order placed in the loops was canceled or filled
+    const auto& levels = book;
+    BOOST_CHECK_EQUAL(levels.get_best(Side::Buy)->price, 100);
+    BOOST_CHECK_EQUAL(levels.get_best(Side::Buy)->qty, 1);
+    BOOST_CHECK_EQUAL(levels.get_best(Side::Sell)->price, 200);
+    BOOST_CHECK_EQUAL(levels.get_best(Side::Sell)->qty, -2);
+}
+
+BOOST_AUTO_TEST_CASE(FillPriceTimePriority)
+{
+    std::vector<Fill> fills;
+    OrderBook<ft::PriceQty, RecordFill> book;
+    const auto& levels = book;
+    auto a = book.place({101, -5}, {&fills});
+    auto b = book.place({101, -7}, {&fills});
+    auto c = book.place({102, -10}, {&fills});
+    book.place({100, 3}, {&fills});
+    BOOST_REQUIRE(a && b && c);
+    BOOST_CHECK(fills.empty());
+
+    BOOST_CHECK(book.place({102, 15}, {&fills}) == nullptr);
+    BOOST_REQUIRE_EQUAL(fills.size(), 3u);
+    BOOST_CHECK_EQUAL(fills[0].price, 101);
+    BOOST_CHECK_EQUAL(fills[0].qty, 5);
+    BOOST_CHECK_EQUAL(fills[0].resting_qty, -5);    // before fill
+    BOOST_CHECK_EQUAL(fills[1].price, 101);
+    BOOST_CHECK_EQUAL(fills[1].qty, 7);
+    BOOST_CHECK_EQUAL(fills[2].price, 102);
+    BOOST_CHECK_EQUAL(fills[2].qty, 3);
+    BOOST_CHECK_EQUAL(c->qty, -7);
+    BOOST_CHECK_EQUAL(levels.get_best(Side::Sell)->price, 102);
+    BOOST_CHECK_EQUAL(levels.get_best(Side::Sell)->qty, -7);
+    BOOST_CHECK_EQUAL(levels.get_best(Side::Buy)->price, 100);
+
+    // does not cross
+    fills.clear();
+    auto d = book.place({101, 4}, {&fills});
+    BOOST_CHECK(fills.empty());
+    BOOST_REQUIRE(d);
+    BOOST_CHECK_EQUAL(levels.get_best(Side::Buy)->price, 101);
+
+    // sell sweeps bids, the rest is placed
+    auto e = book.place({99, -10}, {&fills});
+    BOOST_REQUIRE_EQUAL(fills.size(), 2u);
+    BOOST_CHECK_EQUAL(fills[0].price, 101);
+    BOOST_CHECK_EQUAL(fills[0].qty, 4);
+    BOOST_CHECK_EQUAL(fills[1].price, 100);
+    BOOST_CHECK_EQUAL(fills[1].qty, 3);
+    BOOST_REQUIRE(e);
+    BOOST_CHECK_EQUAL(e->qty, -3);
+    BOOST_CHECK(book.empty(Side::Buy));
+    BOOST_CHECK_EQUAL(levels.get_best(Side::Sell)->price, 99);
+
+    book.cancel(e);
+    book.cancel(c);
+    BOOST_CHECK(book.empty(Side::Sell));
+}
+
+BOOST_AUTO_TEST_CASE(FillOverflow)
+{
+    std::vector<Fill> fills;
+    OrderBook<ft::PriceQty, RecordFill> book;
+    book.place({100, -1}, {&fills});
+    // beyond levels window, kept in overflow by price
+    auto far = book.place({100000, -2}, {&fills});
+    auto farther = book.place({100500, -3}, {&fills});
+    auto nearer = book.place({100300, -4}, {&fills});
+    BOOST_REQUIRE(far && farther && nearer);
+    BOOST_CHECK_EQUAL(book.overflow_size(), 3u);
+    BOOST_CHECK(book.place({100400, 10}, {&fills}) != nullptr);
+    BOOST_REQUIRE_EQUAL(fills.size(), 3u);
+    BOOST_CHECK_EQUAL(fills[0].price, 100);
+    BOOST_CHECK_EQUAL(fills[1].price, 100000);
+    BOOST_CHECK_EQUAL(fills[2].price, 100300);
+    BOOST_CHECK_EQUAL(farther->qty, -3);
+    // rest of buy is the new best bid, window follows the top of the book
+    const auto& levels = book;
+    BOOST_CHECK_EQUAL(levels.get_best(Side::Buy)->price, 100400);
+    BOOST_CHECK_EQUAL(levels.get_best(Side::Sell)->price, 100500);
+    BOOST_CHECK(book.low_price() <= 100400 && 100500 <= book.high_price());
+    BOOST_CHECK_EQUAL(book.overflow_size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(CorePrices)
+{
+    // prices scaled by CorePriceMultiplier differ by more than int could hold
+    constexpr ft::Price M = ft::core::CorePriceMultiplier;
+    std::vector<Fill> fills;
+    OrderBook<ft::PriceQty, RecordFill> book(OrderTraits<ft::PriceQty>().mpi(M/100).max_index_size(1<<16));
+    const auto& levels = book;
+    BOOST_REQUIRE(book.place({130*M, -1}, {&fills}));
+    BOOST_REQUIRE(book.place({100*M, 1}, {&fills}));
+    BOOST_CHECK(fills.empty());
+    BOOST_CHECK_EQUAL(levels.get_best(Side::Buy)->price, 100*M);
+    BOOST_CHECK_EQUAL(levels.get_best(Side::Sell)->price, 130*M);
+    BOOST_REQUIRE(book.place({160*M, -1}, {&fills}));
+    BOOST_CHECK(fills.empty());
+
+    // buy above best ask fills at resting price
+    BOOST_CHECK(book.place({131*M, 1}, {&fills}) == nullptr);
+    BOOST_REQUIRE_EQUAL(fills.size(), 1u);
+    BOOST_CHECK_EQUAL(fills[0].price, 130*M);
+    BOOST_CHECK_EQUAL(fills[0].qty, 1);
+    // sell below best bid
+    fills.clear();
+    BOOST_CHECK(book.place({70*M, -1}, {&fills}) == nullptr);
+    BOOST_REQUIRE_EQUAL(fills.size(), 1u);
+    BOOST_CHECK_EQUAL(fills[0].price, 100*M);
+    BOOST_CHECK(book.empty(Side::Buy));
+    BOOST_CHECK_EQUAL(levels.get_best(Side::Sell)->price, 160*M);
+}
+
+BOOST_AUTO_TEST_CASE(Grow)
+{
+    OrderBook<> book(OrderTraits<ft::PriceQty>().index_size(100).max_index_size(2048));
+    const auto& levels = book;
+    BOOST_CHECK_EQUAL(book.window_size(), 0u);     // allocated on the first order
+    book.place({1000, 1});
+    BOOST_CHECK_EQUAL(book.window_size(), 128u);
+    book.place({900, 1});
+    book.place({1500, -1});
+    BOOST_CHECK_EQUAL(book.window_size(), 1024u);     // spread fits into half of window
+    BOOST_CHECK(book.low_price() <= 1000 && 1500 <= book.high_price());
+    BOOST_CHECK_EQUAL(book.overflow_size(), 0u);
+    BOOST_CHECK_EQUAL(levels.get_best(Side::Buy)->price, 1000);
+    BOOST_CHECK_EQUAL(levels.get_best(Side::Sell)->price, 1500);
+    std::size_t count = 0;
+    for(auto& level: levels.get_levels(Side::Buy))
+        count += level.size();
+    BOOST_CHECK_EQUAL(count, 2u);
+}
+
+BOOST_AUTO_TEST_CASE(AdaptWindow)
+{
+    // deep orders keep going to overflow of narrow window until it grows wide enough
+    OrderBook<> book(OrderTraits<ft::PriceQty>().index_size(16).max_index_size(1024));
+    std::mt19937 gen(1);
+    for(int n=0; n<2000; n++) {
+        ft::Price ofs = 1 + gen() % 100;
+        bool buy = gen() % 2;
+        book.place({buy ? 1000 - ofs : 1000 + ofs, buy ? 1 : -1});
+    }
+    BOOST_CHECK_EQUAL(book.window_size(), 256u);
+    BOOST_CHECK_EQUAL(book.overflow_size(), 0u);
+    BOOST_CHECK_EQUAL(book.nodes_size(), 2000u);
+    BOOST_CHECK(book.memory_usage() >= 256*sizeof(OrderBook<>::Level) + 2000*sizeof(OrderBook<>::Node));
+}
+
+BOOST_AUTO_TEST_CASE(SharedArena)
+{
+    using Manager = BookManager<>;
+    Manager books(OrderTraits<ft::PriceQty>().index_size(16).max_index_size(64), 4096);
+    BOOST_CHECK(books.find(3)==nullptr);
+    BOOST_CHECK_EQUAL(books.memory_usage(3), 0u);
+    books[3].place({100, 5});
+    books[3].place({101, -5});
+    books[7].place({200, 1});
+    BOOST_CHECK_EQUAL(books.size(), 2u);
+    BOOST_CHECK(books.find(5)==nullptr);
+    BOOST_CHECK_EQUAL(books.arena().nodes_size(), 3u);
+    BOOST_CHECK_EQUAL(books.arena().levels_size(), 32u);
+    BOOST_CHECK_EQUAL(books.arena().slabs_bytes(), 4096u);
+    BOOST_CHECK(books.memory_usage(3) > books.memory_usage(7));
+    BOOST_CHECK_EQUAL(books.memory_usage(), books.memory_usage(3) + books.memory_usage(7));
+    // filled orders go back to arena, so do orders of erased book
+    books[3].place({101, 5});
+    BOOST_CHECK_EQUAL(books.arena().nodes_size(), 2u);
+    books.erase(7);
+    BOOST_CHECK_EQUAL(books.arena().nodes_size(), 1u);
+    BOOST_CHECK_EQUAL(books.arena().levels_size(), 16u);
+    // freed window is reused
+    books[9].place({300, 1});
+    BOOST_CHECK_EQUAL(books.arena().slabs_bytes(), 4096u);
+    std::size_t count = 0;
+    books.for_each([&](std::size_t index, auto& book) { count++; });
+    BOOST_CHECK_EQUAL(count, 2u);
+}
+
+BOOST_AUTO_TEST_CASE(DriftAgainstReference)
+{
+    // mid walks far beyond the window, deep orders stay in overflow
+    OrderBook<> book(OrderTraits<ft::PriceQty>().index_size(64));
+    const auto& levels = book;
+    std::mt19937 gen(7);
+    std::multimap<ft::Price, OrderBook<>::Node*> bids, asks;
+    std::vector<OrderBook<>::Node*> orders;
+    ft::Price mid = 10000;
+    std::size_t mismatches = 0;
+    auto check = [&] {
+        mismatches += bids.empty() ? !book.empty(Side::Buy) : levels.get_best(Side::Buy)->price!=bids.rbegin()->first;
+        mismatches += asks.empty() ? !book.empty(Side::Sell) : levels.get_best(Side::Sell)->price!=asks.begin()->first;
+        for(auto [side, ref]: {std::pair{Side::Buy, &bids}, std::pair{Side::Sell, &asks}}) {
+            std::vector<std::pair<ft::Price, std::size_t>> expected, actual;
+            for(auto& [price, o]: *ref) {
+                if(expected.empty() || expected.back().first!=price)
+                    expected.emplace_back(price, 0);
+                expected.back().second++;
             }
+            if(side==Side::Buy)
+                std::reverse(expected.begin(), expected.end());
+            for(auto& level: levels.get_levels(side))
+                actual.emplace_back(level.price, level.size());
+            mismatches += expected!=actual;
         }
-    });
-    std::cout << "\n\n:" << book << "\n";
+    };
+    for(int n=0; n<5000; n++) {
+        mid += (ft::Price)(gen() % 21) - 10;
+        // keep book uncrossed: no bid at or above best ask and vice versa
+        ft::Price bid_limit = asks.empty() ? mid : std::min(mid, asks.begin()->first - 1);
+        ft::Price ask_limit = bids.empty() ? mid + 1 : std::max(mid + 1, bids.rbegin()->first + 1);
+        if(orders.empty() || gen() % 5 < 3) {
+            bool buy = gen() % 2;
+            ft::Price ofs = gen() % 10 ? gen() % 20 : gen() % 1000;
+            ft::Price price = buy ? bid_limit - ofs : ask_limit + ofs;
+            auto* o = book.place({price, buy ? 1 : -1});
+            (buy ? bids : asks).emplace(price, o);
+            orders.push_back(o);
+        } else {
+            std::swap(orders[gen() % orders.size()], orders.back());
+            auto* o = orders.back();
+            orders.pop_back();
+            auto& ref = o->qty>0 ? bids : asks;
+            for(auto it = ref.find(o->price); it!=ref.end(); ++it)
+                if(it->second==o) { ref.erase(it); break; }
+            book.cancel(o);
+        }
+        check();
+    }
+    BOOST_CHECK_EQUAL(mismatches, 0u);
+    BOOST_CHECK(book.overflow_size() > 0u);
+}
+
+BOOST_AUTO_TEST_CASE(ById)
+{
+    std::vector<Fill> fills;
+    OrderBook<ft::PriceQty, RecordFill> book;
+    const auto& levels = book;
+    using Id = ft::ExchangeId;
+    book.place(Id(1), {101, -5}, {&fills});
+    book.place(Id(2), {101, -7}, {&fills});
+    book.place(Id(3), {102, -10}, {&fills});
+    BOOST_CHECK_EQUAL(book.orders_size(), 3u);
+    BOOST_CHECK_EQUAL(levels.get_best(Side::Sell)->qty, -12);
+
+    // reduce keeps time priority
+    BOOST_CHECK(book.reduce(Id(1), 2));
+    BOOST_CHECK_EQUAL(book.find(Id(1))->qty, -3);
+    BOOST_CHECK_EQUAL(levels.get_best(Side::Sell)->qty, -10);
+    // qty decrease at the same price keeps priority too
+    BOOST_CHECK(book.replace(Id(2), {101, -6}, {&fills}) == book.find(Id(2)));
+    BOOST_CHECK_EQUAL(levels.get_best(Side::Sell)->qty, -9);
+    // increase goes to the end of the queue
+    book.replace(Id(1), {101, -4}, {&fills});
+    book.place({101, 6}, {&fills});
+    BOOST_REQUIRE_EQUAL(fills.size(), 1u);
+    BOOST_CHECK_EQUAL(fills[0].resting_qty, -6);        // order 2 first
+    BOOST_CHECK(book.find(Id(2)) == nullptr);           // filled orders leave the index
+    BOOST_CHECK_EQUAL(book.find(Id(1))->qty, -4);
+
+    // new price
+    BOOST_CHECK(book.replace(Id(3), {103, -10}, {&fills}));
+    BOOST_CHECK_EQUAL(book.find(Id(3))->price, 103);
+    BOOST_CHECK(book.reduce(Id(1), 100));
+    BOOST_CHECK(book.find(Id(1)) == nullptr);
+    BOOST_CHECK_EQUAL(levels.get_best(Side::Sell)->price, 103);
+
+    // replace crossing the book fills
+    fills.clear();
+    book.place(Id(4), {100, 5}, {&fills});
+    BOOST_CHECK(book.replace(Id(4), {103, 5}, {&fills}) == nullptr);
+    BOOST_REQUIRE_EQUAL(fills.size(), 1u);
+    BOOST_CHECK_EQUAL(fills[0].price, 103);
+    BOOST_CHECK(book.empty(Side::Buy));
+
+    BOOST_CHECK(book.cancel(Id(3)));
+    BOOST_CHECK(!book.cancel(Id(3)));
+    BOOST_CHECK(book.empty(Side::Sell));
+    BOOST_CHECK_EQUAL(book.orders_size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(Bitmap)
+{
+    for(std::size_t size: {1, 63, 64, 65, 256, 4096, 5000}) {
+        ft::OccupancyBitmap bits(size);
+        std::vector<bool> ref(size);
+        std::mt19937 gen(size);
+        auto naive_next = [&](std::size_t i) { for(; i<size; i++) if(ref[i]) return i; return ft::OccupancyBitmap::npos; };
+        auto naive_prev = [&](std::size_t i) { for(i=std::min(i, size-1)+1; i-- > 0;) if(ref[i]) return i; return ft::OccupancyBitmap::npos; };
+        std::size_t mismatches = 0;
+        for(int n=0; n<2000; n++) {
+            std::size_t i = gen() % size;
+            if(gen() % 3) { bits.set(i); ref[i] = true; }
+            else { bits.reset(i); ref[i] = false; }
+            std::size_t j = gen() % size;
+            mismatches += bits.find_next(j)!=naive_next(j);
+            mismatches += bits.find_prev(j)!=naive_prev(j);
+            mismatches += bits.test(j)!=ref[j];
+        }
+        BOOST_CHECK_EQUAL(mismatches, 0u);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(SparseBestLevel)
+{
+    // best level follows cancels on sparse book, window is centered again when book gets empty between rounds
+    OrderBook<> book;
+    const auto& levels = book;
+    std::mt19937 gen(1);
+    for(int round=0; round<3; round++) {
+        std::vector<OrderBook<>::Node*> orders;
+        std::multimap<ft::Price, OrderBook<>::Node*> bids, asks;
+        ft::Price mid = 1000 + round*37;
+        for(int n=0; n<200; n++) {
+            ft::Price ofs = n==0 ? 1 : 1 + gen() % 120;    // first order centers the levels window
+            bool buy = gen() % 2;
+            auto* o = book.place({buy ? mid - ofs : mid + ofs, buy ? 1 : -1});
+            (buy ? bids : asks).emplace(o->price, o);
+            orders.push_back(o);
+        }
+        std::shuffle(orders.begin(), orders.end(), gen);
+        std::size_t mismatches = 0;
+        for(auto* o: orders) {
+            auto& side = o->qty>0 ? bids : asks;
+            for(auto it = side.find(o->price); it!=side.end(); ++it)
+                if(it->second==o) { side.erase(it); break; }
+            book.cancel(o);
+            mismatches += bids.empty() ? !book.empty(Side::Buy) : levels.get_best(Side::Buy)->price!=bids.rbegin()->first;
+            mismatches += asks.empty() ? !book.empty(Side::Sell) : levels.get_best(Side::Sell)->price!=asks.begin()->first;
+            std::size_t count = 0;
+            for(auto& level: levels.get_levels(Side::Sell))
+                count += level.size();
+            mismatches += count!=asks.size();
+        }
+        BOOST_CHECK_EQUAL(mismatches, 0u);
+    }
 }
-#endif
 
 BOOST_AUTO_TEST_CASE(PlaceCancel1)
 {
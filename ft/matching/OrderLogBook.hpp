@@ -0,0 +1,231 @@
+#pragma once
+#include "ft/matching/OrderBook.hpp"
+#include "ft/core/Stream.hpp"
+#include "ft/core/Tick.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace ft { inline namespace matching {
+
+/// Rebuilds full order books from exchange order log (QSH OrdLog), one book per venue instrument.
+/// Orders are put into books as reported without matching since the exchange reports fills itself.
+/// QSH decoder publishes Quotes and Deals on the same stream, only order log ticks are taken:
+/// their events carry order id and fills have the second element with fill details.
+/// What changed is published as derived streams:
+///   levels() - aggregated level deltas like QSH Quotes: Add/Modify/Delete with qty of the level;
+///   best_price() - Modify element per side whenever best price or qty changes, for BestPrice::update.
+class OrderLogBook {
+public:
+    using Book = OrderBook<PriceQty>;
+    using Traits = typename Book::OrderTraits;
+    using Tick = core::Tick;
+    using TickEvent = core::TickEvent;
+    using OrderId = typename Book::OrderId;
+    using Arena = typename Book::Arena;
+
+    /// up to this many elements are published in one tick
+    using OutputTick = core::Ticks<4>;
+
+    explicit OrderLogBook(Traits traits = Traits().index_size(1024).max_index_size(1<<16))
+    : traits_(traits) {}
+
+    /// order log tick, first element is order event, second is fill details
+    void on_tick(const Tick& tick) {
+        if(!is_order_log(tick))
+            return;
+        auto& ib = instrument(tick.venue_instrument_id());
+        auto& e = tick[0];
+        Qty qty = e.side()==Side::Sell ? -e.qty() : e.qty();
+        switch(e.event()) {
+            case TickEvent::Add:
+                flush_pending(ib);
+                add(ib, e.server_id(), {e.price(), qty});
+                break;
+            case TickEvent::Delete:
+                flush_pending(ib);
+                remove(ib, e.server_id());
+                break;
+            case TickEvent::Fill:
+                fill(ib, e.server_id(), e.qty());
+                break;
+            default:
+                return;
+        }
+        publish(ib, tick);
+    }
+
+    /// book of instrument or nullptr if nothing was received for it
+    const Book* find(VenueInstrumentId id) const {
+        auto it = books_.find(id);
+        return it!=books_.end() ? &it->second->book : nullptr;
+    }
+    std::size_t size() const { return books_.size(); }
+
+    core::Stream::Signal<const Tick&>& levels() { return levels_; }
+    core::Stream::Signal<const Tick&>& best_price() { return best_price_; }
+private:
+    /// Quotes levels have no order id, Deals are single fill elements with deal id
+    static bool is_order_log(const Tick& tick) {
+        if(tick.empty() || tick[0].server_id().empty())
+            return false;
+        return tick[0].event()!=TickEvent::Fill || tick.size()>1;
+    }
+    struct Pending {
+        OrderId id;
+        PriceQty order;
+    };
+    struct Change {
+        Side side;
+        Price price;
+        Qty prev;       // level qty before update
+    };
+    struct InstrumentBook {
+        InstrumentBook(Arena& arena, const Traits& traits)
+        : book(arena, traits) {}
+        Book book;
+        std::vector<Pending> pending;   // aggressive orders crossing the book until their fills come
+        PriceQty best[2] {};            // last published bid, ask
+    };
+
+    InstrumentBook& instrument(VenueInstrumentId id) {
+        auto& ib = books_[id];
+        if(!ib)
+            ib = std::make_unique<InstrumentBook>(arena_, traits_);
+        return *ib;
+    }
+    bool crosses(const Book& book, const PriceQty& order) const {
+        Side side = order.qty>0 ? Side::Buy : Side::Sell;
+        auto* opp = book.get_best(-side);
+        return opp && (ssize_t)side * (order.price - opp->price) >= 0;
+    }
+    Pending* find_pending(InstrumentBook& ib, const OrderId& id) {
+        auto it = std::find_if(ib.pending.begin(), ib.pending.end(), [&](auto& p) { return p.id==id; });
+        return it!=ib.pending.end() ? &*it : nullptr;
+    }
+    void add(InstrumentBook& ib, const OrderId& id, PriceQty order) {
+        if(order.qty==0)
+            return;
+        remove(ib, id);
+        if(crosses(ib.book, order)) {
+            ib.pending.push_back({id, order});
+            return;
+        }
+        touch(ib, order.price);
+        ib.book.insert(id, order);
+    }
+    void remove(InstrumentBook& ib, const OrderId& id) {
+        if(auto* p = find_pending(ib, id)) {
+            p->order.qty = 0;
+            return;
+        }
+        if(auto* node = ib.book.find(id)) {
+            touch(ib, node->price);
+            ib.book.cancel(node);
+        }
+    }
+    void fill(InstrumentBook& ib, const OrderId& id, Qty qty) {
+        if(auto* p = find_pending(ib, id)) {
+            Qty left = std::max<Qty>(std::abs(p->order.qty) - qty, 0);
+            p->order.qty = p->order.qty > 0 ? left : -left;
+            flush_pending(ib);
+            return;
+        }
+        if(auto* node = ib.book.find(id)) {
+            touch(ib, node->price);
+            ib.book.reduce(id, qty);
+        }
+    }
+    /// Filled aggressive orders are dropped, the rest goes to the book once it does not cross.
+    /// Fills of resting orders do not flush since fills of the aggressive one may still follow.
+    void flush_pending(InstrumentBook& ib) {
+        for(auto it = ib.pending.begin(); it!=ib.pending.end();) {
+            if(it->order.qty==0) {
+                it = ib.pending.erase(it);
+            } else if(!crosses(ib.book, it->order)) {
+                touch(ib, it->order.price);
+                ib.book.insert(it->id, it->order);
+                it = ib.pending.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    /// remembers level qty before it is changed
+    void touch(InstrumentBook& ib, Price price) {
+        for(auto& c: changes_)
+            if(c.price==price)
+                return;
+        Qty prev = ib.book.qty(price);
+        changes_.push_back({prev<0 ? Side::Sell : Side::Buy, price, prev});
+    }
+
+    void publish(InstrumentBook& ib, const Tick& tick) {
+        OutputTick out {};
+        std::size_t n = 0;
+        for(auto& c: changes_) {
+            Qty qty = ib.book.qty(c.price);
+            if(qty==c.prev)
+                continue;
+            if(c.prev!=0 && qty!=0 && (qty>0)!=(c.prev>0)) {
+                element(levels_, out, n, tick, TickEvent::Delete, c.side, c.price, 0);     // level moved to other side
+                c.prev = 0;
+            }
+            if(qty==0)
+                element(levels_, out, n, tick, TickEvent::Delete, c.side, c.price, 0);
+            else
+                element(levels_, out, n, tick, c.prev==0 ? TickEvent::Add : TickEvent::Modify,
+                    qty>0 ? Side::Buy : Side::Sell, c.price, std::abs(qty));
+        }
+        changes_.clear();
+        emit(levels_, out, n, tick);
+
+        const Book& book = ib.book;
+        for(Side side: {Side::Buy, Side::Sell}) {
+            auto& last = ib.best[side==Side::Buy ? 0 : 1];
+            auto* best = book.get_best(side);
+            PriceQty now {};
+            if(best)
+                now = {best->price, std::abs(best->qty)};
+            if(now.price==last.price && now.qty==last.qty)
+                continue;
+            last = now;
+            element(best_price_, out, n, tick, TickEvent::Modify, side, now.price, now.qty);
+        }
+        emit(best_price_, out, n, tick);
+    }
+    void element(core::Stream::Signal<const Tick&>& signal, OutputTick& out, std::size_t& n, const Tick& tick,
+        TickEvent event, Side side, Price price, Qty qty)
+    {
+        if(n==out.capacity())
+            emit(signal, out, n, tick);
+        auto& e = out[n++];
+        e = core::TickElement {};
+        e.event(event);
+        e.side(side);
+        e.price(price);
+        e.qty(qty);
+    }
+    void emit(core::Stream::Signal<const Tick&>& signal, OutputTick& out, std::size_t& n, const Tick& tick) {
+        if(n==0)
+            return;
+        out.resize(n);
+        out.topic(core::StreamTopic::BestPrice);
+        out.event(core::Event::Update);
+        out.venue_instrument_id(tick.venue_instrument_id());
+        out.send_time(tick.send_time());
+        out.recv_time(tick.recv_time());
+        signal.invoke(out.as_size<1>());
+        n = 0;
+    }
+private:
+    Traits traits_;
+    Arena arena_;   // shared by books, outlives them
+    ft::unordered_map<VenueInstrumentId, std::unique_ptr<InstrumentBook>> books_;
+    std::vector<Change> changes_;
+    core::Stream::Signal<const Tick&> levels_;
+    core::Stream::Signal<const Tick&> best_price_;
+};
+
+}} // ft::matching
@@ -0,0 +1,505 @@
+#include "OrderLogBook.hpp"
+#include "ft/core/BestPriceCache.hpp"
+#include "ft/utils/UnitTest.hpp"
+#include "toolbox/sys/Log.hpp"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+using namespace ft;
+using namespace ft::matching;
+
+namespace {
+
+constexpr std::size_t BENCH = 0;
+
+using core::TickEvent;
+using core::TickSide;
+
+/// order log tick as QshDecoder emits it
+core::Ticks<2> order(TickEvent event, TickSide side, std::int64_t id, Price price, Qty qty, VenueInstrumentId instrument=VenueInstrumentId(1)) {
+    core::Ticks<2> ti {};
+    ti.topic(core::StreamTopic::BestPrice);
+    ti.event(core::Event::Update);
+    ti.venue_instrument_id(instrument);
+    auto& e = ti[0];
+    e.event(event);
+    e.side(side);
+    e.server_id(core::ExchangeId(id));
+    e.price(price);
+    e.qty(qty);
+    ti.resize(1);
+    if(event==TickEvent::Fill) {
+        auto& fill = ti[1];
+        fill.event(TickEvent::Fill);
+        fill.side(side);
+        fill.price(price);
+        ti.resize(2);
+    }
+    return ti;
+}
+
+struct Element {
+    TickEvent event;
+    TickSide side;
+    Price price;
+    Qty qty;
+    bool operator==(const Element& rhs) const {
+        return event==rhs.event && side==rhs.side && price==rhs.price && qty==rhs.qty;
+    }
+};
+std::ostream& operator<<(std::ostream& os, const Element& e) {
+    return os << e.event << " " << e.side << " " << e.price << " " << e.qty;
+}
+
+/// Order log of busy trading hour of MOEX futures like Si: thousands of records per second coming
+/// in bursts, with hot periods fifty times busier than the rest,
+/// most orders added close to the top of the book and cancelled soon after,
+/// aggressive orders sweeping resting ones in queue order, reported as pairs of fills.
+/// Exchange time is in send_time like QshDecoder sets it. Keeps its own book to check against.
+class OrdLogFixture {
+public:
+    struct Order {
+        TickSide side;
+        Price price;
+        Qty qty;
+    };
+    explicit OrdLogFixture(std::size_t n, std::uint64_t seed = 1)
+    : gen_(seed) {
+        log.reserve(n);
+        // opening book
+        for(Price i = 0; i < 20; i++) {
+            for(int j = 0; j < 3; j++) {
+                add(TickSide::Buy, Mid - 1 - i, qty());
+                add(TickSide::Sell, Mid + 1 + i, qty());
+            }
+        }
+        for(std::size_t i = 0; log.size() < n; i++) {
+            if(i % 5000==0)
+                hot_ = bernoulli(0.1);
+            // records of one burst are microseconds apart, bursts are milliseconds apart
+            next_time((bernoulli(0.9) ? 5 : 5000) / (hot_ ? 50. : 1.));
+            auto r = gen_()%100;
+            if(r < 48 || orders.size() < 100)
+                passive();
+            else if(r < 94)
+                cancel();
+            else
+                aggressive();
+        }
+    }
+    bool empty(TickSide side) const {
+        return side==TickSide::Buy ? bids_.empty() : asks_.empty();
+    }
+    /// one step off the other side when this side is empty
+    Price best(TickSide side) const {
+        auto other = TickSide(-(int)side);
+        if(empty(side))
+            return empty(other) ? Mid - (side==TickSide::Buy ? 1 : -1) : best(other) - (side==TickSide::Buy ? 1 : -1);
+        return side==TickSide::Buy ? bids_.begin()->first : asks_.begin()->first;
+    }
+    Qty level_qty(TickSide side, Price price) const {
+        Qty qty = 0;
+        auto sum = [&](auto& levels) {
+            auto it = levels.find(price);
+            if(it!=levels.end())
+                for(auto id: it->second)
+                    qty += orders.at(id).qty;
+        };
+        if(side==TickSide::Buy)
+            sum(bids_);
+        else
+            sum(asks_);
+        return qty;
+    }
+    /// exchange time from first to last record
+    tb::Nanos span() const {
+        return log.back().send_time() - log.front().send_time();
+    }
+    /// most records within one second of exchange time
+    std::size_t peak_second() const {
+        std::size_t peak = 0, first = 0;
+        for(std::size_t i = 0; i < log.size(); i++) {
+            while(log[i].send_time() - log[first].send_time() >= tb::Seconds(1))
+                first++;
+            peak = std::max(peak, i - first + 1);
+        }
+        return peak;
+    }
+
+    std::vector<core::Ticks<2>> log;
+    std::unordered_map<std::int64_t, Order> orders;
+private:
+    static constexpr Price Mid = 73000;
+
+    bool bernoulli(double p) { return std::bernoulli_distribution(p)(gen_); }
+    Price distance(double p) { return std::geometric_distribution<Price>(p)(gen_); }
+    Qty qty() { return 1 + std::geometric_distribution<Qty>(0.3)(gen_); }
+    void next_time(double mean_us) {
+        now_ += tb::Nanos(static_cast<std::int64_t>(std::exponential_distribution<double>(1e-3 / mean_us)(gen_)));
+    }
+    void push(TickEvent event, TickSide side, std::int64_t id, Price price, Qty qty) {
+        log.push_back(order(event, side, id, price, qty));
+        log.back().send_time(now_);
+    }
+    template<typename FnT>
+    void on_levels(TickSide side, FnT&& fn) {
+        if(side==TickSide::Buy)
+            fn(bids_);
+        else
+            fn(asks_);
+    }
+    void add(TickSide side, Price price, Qty qty) {
+        push(TickEvent::Add, side, ++id_, price, qty);
+        rest(id_, side, price, qty);
+    }
+    void rest(std::int64_t id, TickSide side, Price price, Qty qty) {
+        orders.emplace(id, Order{side, price, qty});
+        on_levels(side, [&](auto& levels) { levels[price].push_back(id); });
+        recent_.push_back(id);
+    }
+    void remove(std::int64_t id) {
+        auto& o = orders.at(id);
+        on_levels(o.side, [&](auto& levels) {
+            auto it = levels.find(o.price);
+            auto& q = it->second;
+            q.erase(std::find(q.begin(), q.end(), id));
+            if(q.empty())
+                levels.erase(it);
+        });
+        orders.erase(id);
+    }
+    /// joins own side a few levels off the best, or improves it when spread is wide
+    void passive() {
+        auto side = bernoulli(0.5) ? TickSide::Buy : TickSide::Sell;
+        auto dir = side==TickSide::Buy ? 1 : -1;
+        Price own = best(side), other = best(TickSide(-(int)side));
+        Price price = own - dir * distance(0.35);
+        if(std::abs(other - own) > 1 && bernoulli(0.3))
+            price = own + dir;
+        add(side, price, qty());
+    }
+    /// mostly cancels of recently added orders
+    void cancel() {
+        for(;;) {
+            auto back = std::min<std::size_t>(distance(0.05), recent_.size() - 1);
+            auto it = recent_.end() - 1 - back;
+            auto o = orders.find(*it);
+            recent_.erase(it);
+            if(o==orders.end())
+                continue;
+            push(TickEvent::Delete, o->second.side, o->first, o->second.price, o->second.qty);
+            remove(o->first);
+            break;
+        }
+        if(recent_.size() > 4 * orders.size())
+            recent_.erase(std::remove_if(recent_.begin(), recent_.end(),
+                [&](auto id) { return orders.count(id)==0; }), recent_.end());
+    }
+    /// takes resting orders up to limit price, resting fill goes first like in OrderLogBook test,
+    /// limit orders are added before they fill and the rest stays in the book
+    void aggressive() {
+        auto side = bernoulli(0.5) ? TickSide::Buy : TickSide::Sell;
+        auto other = TickSide(-(int)side);
+        auto dir = side==TickSide::Buy ? 1 : -1;
+        Price limit = best(other) + dir * distance(0.6);
+        Qty left = qty() * (1 + distance(0.5));
+        bool ioc = bernoulli(0.7);
+        auto id = ++id_;
+        if(!ioc)
+            push(TickEvent::Add, side, id, limit, left);
+        while(left > 0 && !empty(other)) {
+            Price price = best(other);
+            if(dir * (limit - price) < 0)
+                break;
+            std::int64_t resting;
+            on_levels(other, [&](auto& levels) { resting = levels.begin()->second.front(); });
+            auto& o = orders.at(resting);
+            Qty qty = std::min(left, o.qty);
+            push(TickEvent::Fill, other, resting, price, qty);
+            push(TickEvent::Fill, side, id, price, qty);
+            left -= qty;
+            o.qty -= qty;
+            if(o.qty==0)
+                remove(resting);
+        }
+        if(!ioc && left > 0)
+            rest(id, side, limit, left);
+    }
+
+    std::mt19937_64 gen_;
+    Timestamp now_ {tb::Nanos(tb::Seconds(1614582000))};    // 2021-03-01 10:00 MSK
+    bool hot_ = false;
+    std::int64_t id_ = 0;
+    std::map<Price, std::deque<std::int64_t>, std::greater<>> bids_;
+    std::map<Price, std::deque<std::int64_t>> asks_;
+    std::vector<std::int64_t> recent_;
+};
+
+/// collects elements of both derived streams
+struct Recorder {
+    explicit Recorder(OrderLogBook& book) {
+        book.levels().connect(tb::bind([this](const core::Tick& ti) { append(levels, ti); }));
+        book.best_price().connect(tb::bind([this](const core::Tick& ti) { append(best, ti); }));
+    }
+    static void append(std::vector<Element>& v, const core::Tick& ti) {
+        for(auto& e: ti.as_size<OrderLogBook::OutputTick::capacity()>())
+            v.push_back({e.event(), e.side(), e.price(), e.qty()});
+    }
+    void clear() {
+        levels.clear();
+        best.clear();
+    }
+    std::vector<Element> levels;
+    std::vector<Element> best;
+};
+
+}
+
+BOOST_AUTO_TEST_SUITE(OrderLogBookSuite)
+
+BOOST_AUTO_TEST_CASE(Levels)
+{
+    OrderLogBook books;
+    Recorder rec(books);
+    books.on_tick(order(TickEvent::Add, TickSide::Buy, 1, 100, 10).as_size<1>());
+    books.on_tick(order(TickEvent::Add, TickSide::Buy, 2, 100, 5).as_size<1>());
+    books.on_tick(order(TickEvent::Add, TickSide::Sell, 3, 102, 3).as_size<1>());
+    books.on_tick(order(TickEvent::Add, TickSide::Buy, 4, 99, 7).as_size<1>());
+    std::vector<Element> levels {
+        {TickEvent::Add, TickSide::Buy, 100, 10},
+        {TickEvent::Modify, TickSide::Buy, 100, 15},
+        {TickEvent::Add, TickSide::Sell, 102, 3},
+        {TickEvent::Add, TickSide::Buy, 99, 7},
+    };
+    BOOST_TEST(rec.levels==levels, boost::test_tools::per_element());
+    std::vector<Element> best {
+        {TickEvent::Modify, TickSide::Buy, 100, 10},
+        {TickEvent::Modify, TickSide::Buy, 100, 15},
+        {TickEvent::Modify, TickSide::Sell, 102, 3},
+    };
+    BOOST_TEST(rec.best==best, boost::test_tools::per_element());
+
+    rec.clear();
+    books.on_tick(order(TickEvent::Delete, TickSide::Buy, 1, 100, 10).as_size<1>());
+    books.on_tick(order(TickEvent::Fill, TickSide::Buy, 2, 100, 5).as_size<1>());
+    books.on_tick(order(TickEvent::Delete, TickSide::Sell, 42, 102, 1).as_size<1>());   // unknown order
+    levels = {
+        {TickEvent::Modify, TickSide::Buy, 100, 5},
+        {TickEvent::Delete, TickSide::Buy, 100, 0},
+    };
+    BOOST_TEST(rec.levels==levels, boost::test_tools::per_element());
+    best = {
+        {TickEvent::Modify, TickSide::Buy, 100, 5},
+        {TickEvent::Modify, TickSide::Buy, 99, 7},
+    };
+    BOOST_TEST(rec.best==best, boost::test_tools::per_element());
+
+    auto* book = books.find(VenueInstrumentId(1));
+    BOOST_REQUIRE(book);
+    BOOST_CHECK_EQUAL(book->orders_size(), 2);
+    BOOST_CHECK_EQUAL(book->qty(99), 7);
+    BOOST_CHECK_EQUAL(book->qty(102), -3);
+    BOOST_CHECK(books.find(VenueInstrumentId(2))==nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(AggressiveOrder)
+{
+    OrderLogBook books;
+    Recorder rec(books);
+    books.on_tick(order(TickEvent::Add, TickSide::Buy, 1, 100, 10).as_size<1>());
+    books.on_tick(order(TickEvent::Add, TickSide::Buy, 2, 99, 10).as_size<1>());
+    rec.clear();
+    // sell 14 at 99 takes 10 at 100 and 4 at 99, fills are reported by exchange
+    books.on_tick(order(TickEvent::Add, TickSide::Sell, 3, 99, 14).as_size<1>());
+    BOOST_CHECK(rec.levels.empty());
+    books.on_tick(order(TickEvent::Fill, TickSide::Buy, 1, 100, 10).as_size<1>());
+    books.on_tick(order(TickEvent::Fill, TickSide::Sell, 3, 100, 10).as_size<1>());
+    books.on_tick(order(TickEvent::Fill, TickSide::Buy, 2, 99, 4).as_size<1>());
+    books.on_tick(order(TickEvent::Fill, TickSide::Sell, 3, 99, 4).as_size<1>());
+    std::vector<Element> levels {
+        {TickEvent::Delete, TickSide::Buy, 100, 0},
+        {TickEvent::Modify, TickSide::Buy, 99, 6},
+    };
+    BOOST_TEST(rec.levels==levels, boost::test_tools::per_element());
+    auto* book = books.find(VenueInstrumentId(1));
+    BOOST_CHECK(book->empty(Side::Sell));
+
+    // sell 10 at 99 takes 6 at 99, the rest stays once its own fill comes
+    rec.clear();
+    books.on_tick(order(TickEvent::Add, TickSide::Sell, 4, 99, 10).as_size<1>());
+    books.on_tick(order(TickEvent::Fill, TickSide::Buy, 2, 99, 6).as_size<1>());
+    BOOST_CHECK(book->empty(Side::Sell));
+    books.on_tick(order(TickEvent::Fill, TickSide::Sell, 4, 99, 6).as_size<1>());
+    levels = {
+        {TickEvent::Delete, TickSide::Buy, 99, 0},
+        {TickEvent::Add, TickSide::Sell, 99, 4},
+    };
+    BOOST_TEST(rec.levels==levels, boost::test_tools::per_element());
+    std::vector<Element> best {
+        {TickEvent::Modify, TickSide::Buy, 0, 0},
+        {TickEvent::Modify, TickSide::Sell, 99, 4},
+    };
+    BOOST_TEST(rec.best==best, boost::test_tools::per_element());
+    BOOST_CHECK_EQUAL(book->orders_size(), 1);
+    BOOST_CHECK_EQUAL(book->qty(99), -4);
+}
+
+BOOST_AUTO_TEST_CASE(BestPriceCache)
+{
+    OrderLogBook books;
+    core::BestPriceCache cache;
+    books.best_price().connect(tb::bind([&](const core::Tick& ti) {
+        cache.update(ti.as_size<OrderLogBook::OutputTick::capacity()>());
+    }));
+    books.on_tick(order(TickEvent::Add, TickSide::Buy, 1, 100, 10, VenueInstrumentId(7)).as_size<1>());
+    books.on_tick(order(TickEvent::Add, TickSide::Sell, 2, 103, 2, VenueInstrumentId(7)).as_size<1>());
+    books.on_tick(order(TickEvent::Add, TickSide::Sell, 3, 101, 5, VenueInstrumentId(8)).as_size<1>());
+    auto* bp = cache.find(VenueInstrumentId(7));
+    BOOST_REQUIRE(bp);
+    BOOST_CHECK_EQUAL(bp->bid_price(), 100);
+    BOOST_CHECK_EQUAL(bp->bid_qty(), 10);
+    BOOST_CHECK_EQUAL(bp->ask_price(), 103);
+    BOOST_CHECK_EQUAL(bp->ask_qty(), 2);
+    BOOST_REQUIRE(cache.find(VenueInstrumentId(8)));
+    BOOST_CHECK_EQUAL(cache.find(VenueInstrumentId(8))->ask_price(), 101);
+    BOOST_CHECK_EQUAL(books.size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(OtherStreams)
+{
+    OrderLogBook books;
+    Recorder rec(books);
+    // Quotes level and Deals trade come on the same stream as order log
+    books.on_tick(order(TickEvent::Add, TickSide::Buy, 0, 100, 10).as_size<1>());
+    auto deal = order(TickEvent::Add, TickSide::Buy, 77, 100, 10);
+    deal[0].event(TickEvent::Fill);
+    books.on_tick(deal.as_size<1>());
+    BOOST_CHECK(rec.levels.empty());
+    BOOST_CHECK(rec.best.empty());
+    BOOST_CHECK_EQUAL(books.size(), 0);
+}
+
+/// synthetic futures order log: adds around the mid, cancels and fills of random resting orders,
+/// fills of aggressive orders which never rest are reported with unknown ids
+BOOST_AUTO_TEST_CASE(Benchmark)
+{
+    constexpr std::size_t N = BENCH ? 10000000 : 100000;
+    std::vector<core::Ticks<2>> log;
+    log.reserve(N + 1);
+    std::mt19937_64 gen(1);
+    std::vector<std::pair<std::int64_t, core::Ticks<2>>> resting;
+    std::int64_t id = 0;
+    std::size_t changes = 0;    // ticks changing a level
+    constexpr Price mid = 73000;
+    while(log.size() < N) {
+        auto r = gen()%100;
+        if(r < 45 || resting.size() < 1000) {
+            bool buy = gen() & 1;
+            Price price = buy ? mid - 1 - gen()%50 : mid + 1 + gen()%50;
+            auto ti = order(TickEvent::Add, buy ? TickSide::Buy : TickSide::Sell, ++id, price, 1 + gen()%20);
+            log.push_back(ti);
+            resting.emplace_back(id, ti);
+        } else if(r < 90) {
+            auto i = gen()%resting.size();
+            auto& e = resting[i].second[0];
+            log.push_back(order(TickEvent::Delete, e.side(), resting[i].first, e.price(), e.qty()));
+            resting[i] = resting.back();
+            resting.pop_back();
+        } else {
+            auto i = gen()%resting.size();
+            auto& e = resting[i].second[0];
+            Qty qty = 1 + gen()%e.qty();
+            log.push_back(order(TickEvent::Fill, TickSide(-(int)e.side()), 0, e.price(), qty));
+            log.push_back(order(TickEvent::Fill, e.side(), resting[i].first, e.price(), qty));
+            e.qty(e.qty() - qty);
+            if(e.qty()==0) {
+                resting[i] = resting.back();
+                resting.pop_back();
+            }
+        }
+        changes++;
+    }
+    OrderLogBook books;
+    std::size_t levels = 0, best = 0;
+    books.levels().connect(tb::bind([&](const core::Tick& ti) { levels++; }));
+    books.best_price().connect(tb::bind([&](const core::Tick& ti) { best++; }));
+    auto replay = [&] {
+        for(auto& ti: log)
+            books.on_tick(ti.as_size<1>());
+    };
+    std::size_t runs = 0;
+    ft::maybe_bench("ordlog_book", BENCH, [&] {
+        replay();
+        // replays over the same books republish only what differs
+        if(runs++==0)
+            BOOST_CHECK_EQUAL(levels, changes);
+    });
+    if(runs>1)
+        TOOLBOX_INFO << "ordlog_book: "<<log.size()<<" ticks per iteration";
+    auto* book = books.find(VenueInstrumentId(1));
+    BOOST_REQUIRE(book);
+    BOOST_CHECK_EQUAL(book->orders_size(), resting.size());
+    Qty qty = 0;
+    for(auto& [order_id, ti]: resting) {
+        if(ti[0].price()==book->get_best(Side::Buy)->price)
+            qty += ti[0].qty();
+    }
+    BOOST_CHECK_EQUAL(std::abs(book->get_best(Side::Buy)->qty), qty);
+    BOOST_CHECK(best > 0);
+}
+
+/// the realistic order log above must be rebuilt more than 10x faster than exchange produced it
+BOOST_AUTO_TEST_CASE(RealTime)
+{
+    constexpr std::size_t N = BENCH ? 5000000 : 100000;
+    OrdLogFixture fix(N);
+    std::size_t levels = 0;
+    auto replay = [&](OrderLogBook& books) {
+        for(auto& ti: fix.log)
+            books.on_tick(ti.as_size<1>());
+    };
+    ft::maybe_bench("ordlog_book_realtime", BENCH, [&] {
+        OrderLogBook books;
+        replay(books);
+    });
+
+    OrderLogBook books;
+    books.levels().connect(tb::bind([&](const core::Tick& ti) { levels++; }));
+    replay(books);
+    auto* book = books.find(VenueInstrumentId(1));
+    BOOST_REQUIRE(book);
+    BOOST_CHECK_EQUAL(book->orders_size(), fix.orders.size());
+    for(auto side: {Side::Buy, Side::Sell}) {
+        auto* best = book->get_best(side);
+        BOOST_REQUIRE(best);
+        auto tick_side = side==Side::Buy ? TickSide::Buy : TickSide::Sell;
+        BOOST_CHECK_EQUAL(best->price, fix.best(tick_side));
+        BOOST_CHECK_EQUAL(std::abs(best->qty), fix.level_qty(tick_side, best->price));
+    }
+    BOOST_CHECK(levels > 0);
+
+    if(BENCH) {
+        constexpr int Repeat = 10;
+        auto start = tb::MonoClock::now();
+        for(int i=0; i<Repeat; i++) {
+            OrderLogBook books;
+            replay(books);
+        }
+        double wall_s = std::chrono::duration<double>(tb::MonoClock::now() - start).count() / Repeat;
+        double span_s = std::chrono::duration<double>(fix.span()).count();
+        auto peak = fix.peak_second();
+        TOOLBOX_INFO << "ordlog_book_realtime: "<<fix.log.size()<<" ticks over "<<span_s<<" s of exchange time"
+            <<", "<<fix.log.size()/wall_s<<" ticks/s, real time: "<<span_s/wall_s<<"x"
+            <<", peak second: "<<peak<<" ticks, "<<fix.log.size()/wall_s/peak<<"x";
+        BOOST_CHECK_GT(span_s/wall_s, 10);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -3,64 +3,53 @@
 #include "ft/core/StreamStats.hpp"
 #include "QshDecoder.hpp"
 #include "toolbox/sys/Log.hpp"
+#include "ft/utils/Leb128.hpp"
 
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <limits>
 
 using namespace ft::qsh;
 
+template<bool CheckedI>
 std::int64_t QshDecoder::read_leb128() {
-    std::int64_t result = 0;
-    int shift  = 0;
-    int byte;
-    do {
-        byte = input_stream().get();
-        if(byte == EOF) {
-            throw std::runtime_error("EOF in read_leb128");
-        }
-        result |= ((byte & 0x7F) << shift);
-        shift += 7;
-    }while(byte & 0x80);
-
-    if((byte & 0x40)!=0) {
-        result |= ((-1ULL) << shift);
-    }
-    return result;
+    if constexpr(CheckedI)
+        return leb128::read_signed_checked(ptr_, end_);
+    else
+        return leb128::read_signed(ptr_);
 }
 
+template<bool CheckedI>
 std::uint64_t QshDecoder::read_uleb128() {
-    std::uint64_t result = 0;
-    int shift  = 0;
-    int byte;
-    do {
-        byte = input_stream().get();
-        if(byte == EOF) {
-            throw std::runtime_error("EOF in read_uleb128");
-        }
-        result |= ((byte & 0x7F) << shift);
-        shift += 7;            
-    } while(byte & 0x80);
-    return result;
+    if constexpr(CheckedI)
+        return leb128::read_unsigned_checked(ptr_, end_);
+    else
+        return leb128::read_unsigned(ptr_);
 }
 
+template<bool CheckedI>
 std::uint64_t QshDecoder::read_relative(std::uint64_t previous) {
-    previous += read_leb128();
+    previous += read_leb128<CheckedI>();
     return previous;
 }
 
 std::string QshDecoder::read_string() {
-    std::int64_t size = read_uleb128();
-    std::string result(size, '\0');
-    input_stream().read(result.data(), size);
-    if(input_stream().fail())
-        throw std::runtime_error("EOF in read_string");
+    ensure(leb128::MaxSize);
+    std::size_t size = read_uleb128<true>();
+    ensure(size);
+    require(size, "EOF in read_string");
+    std::string result(ptr_, size);
+    ptr_ += size;
     return result;
 }
 
+template<bool CheckedI>
 std::uint64_t QshDecoder::read_growing(std::uint64_t previous) {
-    std::uint64_t delta = read_uleb128();
+    std::uint64_t delta = read_uleb128<CheckedI>();
     if(delta == 268435455) {
-        std::int64_t delta2 = read_leb128();
+        std::int64_t delta2 = read_leb128<CheckedI>();
         return ((std::int64_t)previous) + delta2;
     }else {
         return previous + delta;
@@ -69,96 +58,325 @@ std::uint64_t QshDecoder::read_growing(std::uint64_t previous) {
 
 ft::HundredNanos QshDecoder::read_datetime() {
     std::uint64_t val;
-    input_stream().read((char*)&val, sizeof(val));
-    if(input_stream().fail())
-        throw std::runtime_error("EOF in read_datetime");
+    require(sizeof(val), "EOF in read_datetime");
+    std::memcpy(&val, ptr_, sizeof(val));
+    ptr_ += sizeof(val);
     return ft::HundredNanos(val);
 }
 
+template<bool CheckedI>
 ft::HundredNanos QshDecoder::read_grow_datetime(ft::HundredNanos previous) {
     std::uint64_t pval = previous.count();
-    std::uint64_t val = read_growing(pval / 10000) * 10000;
+    std::uint64_t val = read_growing<CheckedI>(pval / 10000) * 10000;
     return ft::HundredNanos(val);
 }
 
-
+template<bool CheckedI>
 int QshDecoder::read_byte() {
-    int byte = input_stream().get();
-    if(byte == EOF)
-        throw std::runtime_error("EOF in read_byte");
-    return byte;
+    if constexpr(CheckedI)
+        require(1, "EOF in read_byte");
+    return static_cast<std::uint8_t>(*ptr_++);
 }
 
+template<bool CheckedI>
 std::uint16_t QshDecoder::read_uint16() {
-    std::int16_t val;
-    input_stream().read((char*)&val, sizeof(val));
-    if(input_stream().fail())
-        throw std::runtime_error("EOF in read_datetime");
+    std::uint16_t val;
+    if constexpr(CheckedI)
+        require(sizeof(val), "EOF in read_uint16");
+    std::memcpy(&val, ptr_, sizeof(val));
+    ptr_ += sizeof(val);
+    return val;
+}
+
+template<bool CheckedI>
+double QshDecoder::read_double() {
+    double val;
+    if constexpr(CheckedI)
+        require(sizeof(val), "EOF in read_double");
+    std::memcpy(&val, ptr_, sizeof(val));
+    ptr_ += sizeof(val);
     return val;
 }
 
 void QshDecoder::read_header() {
-    char buf[19];
-    input_stream().read(buf, sizeof(buf));
-    if(input_stream().fail() || 
-        0!=std::memcmp("Qscalp History Data", buf, sizeof(buf)))
+    constexpr std::string_view signature = "QScalp History Data";
+    require(signature.size()+1, "not qscalp file");
+    if(0!=std::memcmp(signature.data(), ptr_, signature.size()))
         throw std::runtime_error("not qscalp file");
-    int v = input_stream().get();
+    ptr_ += signature.size();
+    int v = read_byte<true>();
     if(v!=4)
         throw std::runtime_error("only qscalp version 4 is supported");
     state_.app = read_string();
     state_.comment = read_string();
     state_.frame_ts = state_.ctime = read_datetime();
     FT_TRACE("ctime: " << state_.ctime.to_string())
-    state_.nstreams = read_byte();
-    for(int i=0;i<state_.nstreams;i++) {
-        int stream_id = read_byte();
-        if(stream_id != Stream::Messages) {
-            state_.stream_ids[i] = stream_id;
-            std::size_t stream_index =  (stream_id >> 4) - 1;
-            if(stream_index<0 || stream_index>=7)
-                throw std::runtime_error("invalid stream id");
-            state_.instruments[stream_index] = read_string();
-            FT_TRACE("stream 0x"<<std::hex<<stream_id<<" ins "<<state_.instruments[stream_index]);
+    state_.nstreams = read_byte<true>();
+    state_.streams.resize(state_.nstreams);
+    for(auto& st: state_.streams) {
+        st.id = read_byte<true>();
+        if(st.id<Quotes || st.id>OrdLog || (st.id & 0x0F))
+            throw std::runtime_error("invalid stream id");
+        if(st.id != Stream::Messages) {
+            st.instrument = read_string();
+            FT_TRACE("stream 0x"<<std::hex<<st.id<<" ins "<<st.instrument);
         }
     }
+    for(std::size_t i=0; i<state_.streams.size(); i++) {
+        auto& st = state_.streams[i];
+        if(st.instrument.empty())
+            continue;
+        auto same = std::find_if(state_.streams.begin(), state_.streams.begin()+i,
+            [&](auto& prev) { return prev.instrument==st.instrument; });
+        if(same != state_.streams.begin()+i)
+            st.venue_instrument_id = same->venue_instrument_id;     // announced already
+        else
+            emit_instrument(st);
+    }
+}
+
+void QshDecoder::emit_instrument(StreamState& st) {
+    constexpr std::size_t MaxSymbolSize = 256;
+    auto id = std::hash<std::string>{}(st.instrument);
+    st.venue_instrument_id = Identifier(id);
+    std::string_view symbol = std::string_view(st.instrument).substr(0, MaxSymbolSize);
+    core::BasicInstrumentUpdate<2*MaxSymbolSize> u;
+    u.topic(core::StreamTopic::Instrument);
+    u.symbol(symbol);
+    u.venue_symbol(symbol);
+    u.instrument_id(Identifier(id));
+    u.venue_instrument_id(Identifier(id));
+    instruments_.invoke(u.as_size<0>());
+}
+
+QshTick& QshDecoder::new_tick(std::size_t n) {
+    static_cast<ft_tick_t&>(tick_) = ft_tick_t {};
+    for(std::size_t i=0; i<n; i++)
+        tick_[i] = core::TickElement {};
+    return tick_;
 }
 
-bool QshDecoder::read_frame_header() {
-    if(input_stream().eof())
-        return false;
-    FT_TRACE("ofs "<<input_stream().tellg()<<" last frame ts "<<state_.frame_ts);
-    state_.ts = state_.frame_ts = read_grow_datetime(state_.frame_ts);
-    if(state_.nstreams>1)
-        state_.cur_stream = read_byte();
+void QshDecoder::emit(QshTick& ti, const StreamState& st, core::StreamTopic topic, ft::HundredNanos ts) {
+    ti.topic(topic);
+    ti.event(core::Event::Update);
+    ti.venue_instrument_id(st.venue_instrument_id);
+    ti.recv_time(to_wall_time(ts));
+    ti.send_time(to_wall_time(ts));
+    auto& signal = topic==core::StreamTopic::Statistics ? statistics_ : ticks_;
+    signal.invoke(ti.as_size<1>());
+}
+
+template<bool CheckedI>
+void QshDecoder::read_frame() {
+    FT_TRACE("ofs "<<offset()<<" last frame ts "<<state_.frame_ts);
+    state_.frame_ts = read_grow_datetime<CheckedI>(state_.frame_ts);
+    if(state_.nstreams>1) {
+        state_.cur_stream = read_byte<CheckedI>();
+        if(state_.cur_stream >= state_.streams.size())
+            throw std::runtime_error("invalid stream index");
+    }
     FT_TRACE("frame: frame_ts "<<frame_ts<< " cur_stream "<<std::hex<<cur_stream)
+    switch(state_.streams[state_.cur_stream].id) {
+        case OrdLog: read_order_log<CheckedI>(); break;
+        case Quotes: read_quotes<CheckedI>(); break;
+        case Deals: read_deals<CheckedI>(); break;
+        case AuxInfo: read_aux_info<CheckedI>(); break;
+        case Messages: {
+            // service messages are not published
+            ensure(MaxFrameSize);
+            read_datetime();
+            read_byte<true>();
+            auto text = read_string();
+            FT_TRACE("message "<<text);
+        } break;
+        default: throw std::runtime_error("unsupported stream id");
+    }
+    ticks().stats().on_received();
+    if(state_.frame_ts >= next_checkpoint_)
+        checkpoint();
+}
+
+void QshDecoder::checkpoint() {
+    QshIndex::Entry e;
+    e.time = state_.frame_ts;
+    e.offset = offset();
+    save_state(e.state);
+    index_->add(std::move(e));
+    next_checkpoint_ = state_.frame_ts + index_->interval();
+}
+
+namespace {
+    template<typename T>
+    void put(std::string& out, T val) {
+        out.append(reinterpret_cast<const char*>(&val), sizeof(val));
+    }
+    template<typename T>
+    T get(std::string_view& in) {
+        T val;
+        if(in.size() < sizeof(val))
+            throw std::runtime_error("qsh: truncated checkpoint");
+        std::memcpy(&val, in.data(), sizeof(val));
+        in.remove_prefix(sizeof(val));
+        return val;
+    }
+}
+
+void QshDecoder::snapshot(ft::HundredNanos ts) {
+    std::vector<std::pair<Price, Qty>> levels;
+    for(auto& st: state_.streams) {
+        if(st.id!=Quotes)
+            continue;
+        levels.assign(st.levels.begin(), st.levels.end());
+        std::sort(levels.begin(), levels.end());
+        auto& ti = new_tick(0);
+        std::size_t n = 0;
+        ti[n] = core::TickElement {};
+        ti[n].event(core::TickEvent::Clear);
+        ti[n++].side(core::TickSide::Empty);
+        for(auto& [price, volume]: levels) {
+            if(n==ti.capacity()) {
+                ti.resize(n);
+                emit(ti, st, core::StreamTopic::BestPrice, ts);
+                n = 0;
+            }
+            auto& e = ti[n++];
+            e = core::TickElement {};
+            e.event(core::TickEvent::Add);
+            e.side(volume>0 ? core::TickSide::Sell : core::TickSide::Buy);
+            e.price(price);
+            e.qty(std::abs(volume));
+        }
+        ti.resize(n);
+        emit(ti, st, core::StreamTopic::BestPrice, ts);
+    }
+}
+
+void QshDecoder::save_state(std::string& out) const {
+    out.clear();
+    put<std::int64_t>(out, state_.frame_ts.count());
+    put<std::uint64_t>(out, state_.cur_stream);
+    put<std::uint64_t>(out, state_.streams.size());
+    for(auto& st: state_.streams) {
+        put<std::int64_t>(out, st.ts.count());
+        put(out, st.price);
+        put(out, st.exchange_id.low());
+        put(out, st.order_id.low());
+        put(out, st.fill_id.low());
+        put(out, st.fill_price);
+        put(out, st.qty);
+        put(out, st.qty_left);
+        put(out, st.open_interest);
+        put(out, st.ask_total);
+        put(out, st.bid_total);
+        put(out, st.high_limit);
+        put(out, st.low_limit);
+        put<std::uint64_t>(out, st.levels.size());
+        for(auto& level: st.levels) {
+            put(out, level.first);
+            put(out, level.second);
+        }
+    }
+}
+
+void QshDecoder::load_state(std::string_view in) {
+    state_.frame_ts = ft::HundredNanos(get<std::int64_t>(in));
+    state_.cur_stream = get<std::uint64_t>(in);
+    if(get<std::uint64_t>(in) != state_.streams.size())
+        throw std::runtime_error("qsh: checkpoint does not match file header");
+    for(auto& st: state_.streams) {
+        st.ts = ft::HundredNanos(get<std::int64_t>(in));
+        st.price = get<Price>(in);
+        st.exchange_id = Identifier(get<std::uint64_t>(in));
+        st.order_id = Identifier(get<std::uint64_t>(in));
+        st.fill_id = Identifier(get<std::uint64_t>(in));
+        st.fill_price = get<Price>(in);
+        st.qty = get<Qty>(in);
+        st.qty_left = get<Qty>(in);
+        st.open_interest = get<Qty>(in);
+        st.ask_total = get<Qty>(in);
+        st.bid_total = get<Qty>(in);
+        st.high_limit = get<Price>(in);
+        st.low_limit = get<Price>(in);
+        st.levels.clear();
+        for(auto n = get<std::uint64_t>(in); n>0; n--) {
+            auto price = get<Price>(in);
+            st.levels[price] = get<Qty>(in);
+        }
+    }
+}
+
+void QshDecoder::seek(const QshIndex::Entry& checkpoint) {
+    if(checkpoint.offset < offset())
+        throw std::runtime_error("qsh: seek backwards");
+    if(source_) {
+        // compressed stream is inflated up to the offset without decoding frames
+        while(base_offset_ + static_cast<std::size_t>(end_ - begin_) <= checkpoint.offset) {
+            ptr_ = end_;
+            if(!refill(0))
+                throw std::runtime_error("qsh: checkpoint is past the end");
+        }
+        ptr_ = begin_ + (checkpoint.offset - base_offset_);
+    } else {
+        if(checkpoint.offset > static_cast<std::size_t>(end_ - begin_))
+            throw std::runtime_error("qsh: checkpoint is past the end");
+        ptr_ = begin_ + checkpoint.offset;
+    }
+    load_state(checkpoint.state);
+    if(index_)
+        next_checkpoint_ = state_.frame_ts + index_->interval();
+}
+
+bool QshDecoder::refill(std::size_t size) {
+    while(static_cast<std::size_t>(end_ - ptr_) <= size) {
+        // unconsumed tail is copied in front of the next block
+        auto block = source_->next({ptr_, static_cast<std::size_t>(end_ - ptr_)});
+        if(block.empty())
+            return false;
+        base_offset_ += ptr_ - begin_;
+        begin_ = ptr_ = block.data();
+        end_ = block.data() + block.size();
+    }
     return true;
 }
 
 void QshDecoder::run() {
-    input_stream().exceptions(std::ios::eofbit | std::ios::failbit | std::ios::badbit);
-    try {
-        read_header();
-        while(read_frame_header()) {
-            int stream_id = state_.stream_ids[state_.cur_stream];
-            switch(stream_id) {
-                case OrdLog: read_order_log(); break;
-                default: throw std::runtime_error("invalid stream id");
-            }
-            ticks().stats().on_received();
+    start();
+    while(poll(std::numeric_limits<std::size_t>::max()));
+}
+
+void QshDecoder::start() {
+    state_ = State {};
+    if(source_)
+        refill(MaxHeaderSize);
+    read_header();
+}
+
+bool QshDecoder::poll(std::size_t max_frames) {
+    std::size_t n = 0;
+    for(;;) {
+        // bulk of frames is far enough from the end of data to skip bounds checks
+        for(; ptr_ < safe_end(); n++) {
+            if(n==max_frames)
+                return true;
+            read_frame<false>();
         }
-    }catch(std::ios_base::failure& fail) {
-        // rethrow everything except eof
-        if(input_stream().bad())
-            throw fail;
+        if(!source_ || !refill(MaxFrameSize))
+            break;
+    }
+    for(; ptr_ < end_; n++) {
+        if(n==max_frames)
+            return true;
+        read_frame<true>();
     }
+    return false;
 }
 
+template<bool CheckedI>
 void QshDecoder::read_order_log() {
-
-    int flags = read_byte();
-    std::uint16_t plaza_flags = read_uint16();
-    QshTick ti {};
+    auto& st = state_.streams[state_.cur_stream];
+    int flags = read_byte<CheckedI>();
+    std::uint16_t plaza_flags = read_uint16<CheckedI>();
+    auto& ti = new_tick(2);
     auto& order = ti[0];
     auto& fill = ti[1];
     FT_TRACE("flags 0x"<<std::hex<<flags<<" plaza_flags 0x"<<plaza_flags);
@@ -166,7 +384,8 @@ void QshDecoder::read_order_log() {
         ti.event(core::Event::Update);
         order.event(core::TickEvent::Add);
     }
-    if(plaza_flags & (PLAZA_CANCEL|PLAZA_MOVE)) {
+    // moved order is reported as removal of old one and add of new one, both flagged as moved
+    if((plaza_flags & PLAZA_CANCEL) || (plaza_flags & (PLAZA_MOVE|PLAZA_ADD))==PLAZA_MOVE) {
         ti.event(core::Event::Update);
         order.event(core::TickEvent::Delete);
     }
@@ -174,58 +393,220 @@ void QshDecoder::read_order_log() {
         ti.event(core::Event::Update);
         order.event(core::TickEvent::Fill);
     }
+    if(plaza_flags & PLAZA_BUY)
+        order.side(core::TickSide::Buy);
+    else if(plaza_flags & PLAZA_SELL)
+        order.side(core::TickSide::Sell);
+    ti.resize(1);
     if(flags & OL_TIMESTAMP) {
-        state_.ts = read_grow_datetime(state_.ts);
+        st.ts = read_grow_datetime<CheckedI>(st.ts);
         FT_TRACE("exchange_timestamp "<<e.timestamp)
     }
-    Timestamp ts(state_.ts);
-    ti.recv_time(ts);
-    ti.send_time(ts);
     if(flags & OL_ID) {
         if(plaza_flags & PLAZA_ADD) {
-            state_.exchange_id = Identifier(read_growing(state_.exchange_id.low()));
-            order.server_id(state_.exchange_id);
+            st.exchange_id = Identifier(read_growing<CheckedI>(st.exchange_id.low()));
+            order.server_id(st.exchange_id);
         } else {
-            order.server_id(Identifier(read_relative(state_.exchange_id.low())));
+            order.server_id(Identifier(read_relative<CheckedI>(st.exchange_id.low())));
         }
         FT_TRACE("exchange_id "<<e.exchange_id)
     } else {
-        order.server_id(state_.exchange_id);
+        order.server_id(st.exchange_id);
     }
     if(flags&OL_PRICE) {
-        state_.price = read_relative(state_.price);
+        st.price = read_relative<CheckedI>(st.price);
         FT_TRACE("price "<<e.price)
     }
-    order.price(state_.price);
+    order.price(st.price);
     if(flags&OL_AMOUNT) {
-        order.qty(read_leb128());
+        st.qty = read_relative<CheckedI>(st.qty);
         FT_TRACE("qty "<<e.qty)
     }
+    order.qty(st.qty);
+    bool open_interest = false;
     if(plaza_flags & PLAZA_FILL) {
         if(flags&OL_AMOUNT_LEFT) {
-            fill.qty(read_leb128());
+            st.qty_left = read_relative<CheckedI>(st.qty_left);
             FT_TRACE("qty_left "<<e.qty_left)
         }
+        fill.qty(st.qty_left);
         if(flags&OL_FILL_ID) {
-            state_.fill_id = Identifier(read_growing(state_.fill_id.low()));
+            st.fill_id = Identifier(read_growing<CheckedI>(st.fill_id.low()));
             FT_TRACE("trade_id "<<d.fill_id)
         }
-        fill.server_id(state_.fill_id);        
+        fill.server_id(st.fill_id);        
         if(flags&OL_FILL_PRICE) {
-            state_.fill_price = read_relative(state_.fill_price);
+            st.fill_price = read_relative<CheckedI>(st.fill_price);
             FT_TRACE("trade_price "<<e.fill_price)
         }
-        fill.price(state_.fill_price);
+        fill.price(st.fill_price);
+        fill.side(order.side());
+        fill.event(core::TickEvent::Fill);
+        ti.resize(2);
         if(flags&OL_OPEN_INTEREST) {
-            state_.open_interest = read_relative(state_.open_interest);
+            st.open_interest = read_relative<CheckedI>(st.open_interest);
+            open_interest = true;
             FT_TRACE("open_interest "<<e.open_interest)
         }
-        //fill.open_interest(state_.open_interest);
     }
     if(ti.empty()) {
         TOOLBOX_WARNING<<"qsh: invalid flags "<<std::hex<<flags<<" plaza "<<std::hex<<plaza_flags;
         ticks().stats().on_rejected(flags);
     }else {
-        ticks().invoke(ti.as_size<1>());
+        emit(ti, st, core::StreamTopic::BestPrice, st.ts);
+    }
+    if(open_interest)
+        emit_open_interest(st);
+}
+
+void QshDecoder::emit_open_interest(const StreamState& st) {
+    auto& ti = new_tick(1);
+    ti[0].event(core::TickEvent::Modify).field(core::Field::OpenInterest);
+    ti[0].qty(st.open_interest);
+    ti.resize(1);
+    emit(ti, st, core::StreamTopic::Statistics, st.ts);
+}
+
+template<bool CheckedI>
+void QshDecoder::read_quotes() {
+    constexpr std::int64_t MaxQuotes = 100000;
+    std::int64_t count = read_leb128<CheckedI>();
+    if(count<0 || count>MaxQuotes)
+        throw std::runtime_error("invalid quotes count");
+    // levels are decoded without bounds checks only if the longest encoding fits
+    std::size_t bound = count * 2 * leb128::MaxSize + leb128::Padding;
+    ensure(std::min(bound, MaxHeaderSize));
+    if(static_cast<std::size_t>(end_ - ptr_) >= bound)
+        read_quote_levels<false>(count);
+    else
+        read_quote_levels<true>(count);
+}
+
+/// changed levels of aggregated book are published as deltas
+template<bool CheckedI>
+void QshDecoder::read_quote_levels(std::size_t count) {
+    auto& st = state_.streams[state_.cur_stream];
+    st.ts = state_.frame_ts;
+    auto& ti = new_tick(0);
+    std::size_t n = 0;
+    auto add = [&](core::TickEvent event, Qty volume) {
+        if(n==ti.capacity()) {
+            ti.resize(n);
+            emit(ti, st, core::StreamTopic::BestPrice, st.ts);
+            n = 0;
+        }
+        auto& e = ti[n++];
+        e = core::TickElement {};
+        e.event(event);
+        e.side(volume>0 ? core::TickSide::Sell : core::TickSide::Buy);
+        e.price(st.price);
+        e.qty(event==core::TickEvent::Delete ? 0 : std::abs(volume));
+    };
+    for(std::size_t i=0; i<count; i++) {
+        if constexpr(CheckedI)
+            ensure(2 * leb128::MaxSize);   // frame could be longer than head room of the block
+        st.price = read_relative<CheckedI>(st.price);
+        Qty volume = read_leb128<CheckedI>();
+        auto it = st.levels.find(st.price);
+        Qty prev = it!=st.levels.end() ? it->second : 0;
+        if(volume==0) {
+            if(prev!=0) {
+                add(core::TickEvent::Delete, prev);
+                st.levels.erase(it);
+            }
+            continue;
+        }
+        if(prev!=0 && (prev>0)!=(volume>0)) {
+            add(core::TickEvent::Delete, prev);     // level moved to other side
+            prev = 0;
+        }
+        add(prev==0 ? core::TickEvent::Add : core::TickEvent::Modify, volume);
+        st.levels[st.price] = volume;
+    }
+    if(n>0) {
+        ti.resize(n);
+        emit(ti, st, core::StreamTopic::BestPrice, st.ts);
+    }
+}
+
+template<bool CheckedI>
+void QshDecoder::read_deals() {
+    auto& st = state_.streams[state_.cur_stream];
+    int flags = read_byte<CheckedI>();
+    if(flags & DL_TIMESTAMP)
+        st.ts = read_grow_datetime<CheckedI>(st.ts);
+    if(flags & DL_ID)
+        st.exchange_id = Identifier(read_growing<CheckedI>(st.exchange_id.low()));
+    if(flags & DL_ORDER_ID)
+        st.order_id = Identifier(read_relative<CheckedI>(st.order_id.low()));
+    if(flags & DL_PRICE)
+        st.price = read_relative<CheckedI>(st.price);
+    if(flags & DL_VOLUME)
+        st.qty = read_leb128<CheckedI>();
+    if(flags & DL_OPEN_INTEREST)
+        st.open_interest = read_relative<CheckedI>(st.open_interest);
+    auto& ti = new_tick(1);
+    auto& fill = ti[0];
+    fill.event(core::TickEvent::Fill);
+    switch(flags & DL_TYPE) {
+        case 1: fill.side(core::TickSide::Buy); break;
+        case 2: fill.side(core::TickSide::Sell); break;
+        default: break;
+    }
+    fill.price(st.price);
+    fill.qty(st.qty);
+    fill.server_id(st.exchange_id);
+    ti.resize(1);
+    emit(ti, st, core::StreamTopic::BestPrice, st.ts);
+    if(flags & DL_OPEN_INTEREST)
+        emit_open_interest(st);
+}
+
+template<bool CheckedI>
+void QshDecoder::read_aux_info() {
+    auto& st = state_.streams[state_.cur_stream];
+    int flags = read_byte<CheckedI>();
+    if(flags & AI_TIMESTAMP)
+        st.ts = read_grow_datetime<CheckedI>(st.ts);
+    auto& ti = new_tick(0);
+    std::size_t n = 0;
+    auto add = [&](core::Field field) -> core::TickElement& {
+        auto& e = ti[n++];
+        e = core::TickElement {};
+        e.event(core::TickEvent::Modify).field(field);
+        return e;
+    };
+    if(flags & AI_PRICE) {
+        st.price = read_relative<CheckedI>(st.price);
+        add(core::Field::LastPrice).price(st.price);
+    }
+    if(flags & AI_ASK_TOTAL) {
+        st.ask_total = read_relative<CheckedI>(st.ask_total);
+        add(core::Field::AskTotal).qty(st.ask_total);
+    }
+    if(flags & AI_BID_TOTAL) {
+        st.bid_total = read_relative<CheckedI>(st.bid_total);
+        add(core::Field::BidTotal).qty(st.bid_total);
+    }
+    if(flags & AI_OPEN_INTEREST) {
+        st.open_interest = read_relative<CheckedI>(st.open_interest);
+        add(core::Field::OpenInterest).qty(st.open_interest);
+    }
+    if(flags & AI_SESSION_INFO) {
+        st.high_limit = read_relative<CheckedI>(st.high_limit);
+        st.low_limit = read_relative<CheckedI>(st.low_limit);
+        read_double<CheckedI>();    // deposit
+        add(core::Field::HighLimit).price(st.high_limit);
+        add(core::Field::LowLimit).price(st.low_limit);
+    }
+    if(flags & AI_RATE)
+        read_double<CheckedI>();
+    if(flags & AI_MESSAGE) {
+        auto text = read_string();
+        FT_TRACE("aux message "<<text);
+    }
+    if(n>0) {
+        ti.resize(n);
+        emit(ti, st, core::StreamTopic::Statistics, st.ts);
     }
 }
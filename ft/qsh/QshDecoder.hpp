@@ -4,6 +4,7 @@
 #include "ft/core/StreamStats.hpp"
 #include "toolbox/util/Slot.hpp"
 #include "toolbox/net/Packet.hpp"
+#include <algorithm>
 #include <csignal>
 #include <ctime>
 #include <fstream>
@@ -11,14 +12,20 @@
 #include <sstream>
 #include <stdexcept>
 #include <iomanip>
+#include <limits>
 #include <string_view>
 #include "ft/utils/TimeUtils.hpp"
+#include "ft/utils/MappedFile.hpp"
+#include "ft/utils/GzipReader.hpp"
+#include "ft/qsh/QshIndex.hpp"
 #include "ft/core/Tick.hpp"
 #include "toolbox/util.hpp"
+#include <vector>
 
 namespace ft::qsh {
     
-using QshTick = ft::core::Ticks<2>;
+/// ticks are invoked as core::Tick referring to QshTick, so elements beyond first could be read
+using QshTick = ft::core::Ticks<8>;
 using Timestamp = ft::core::Timestamp;
 
 class QshDecoder
@@ -62,64 +69,207 @@ public:
         OL_OPEN_INTEREST = 1<<7
     };
 
+    enum DealFlags {
+        DL_TYPE = 0x03,     // 1 = buy, 2 = sell aggressor
+        DL_TIMESTAMP = 1<<2,
+        DL_ID = 1<<3,
+        DL_ORDER_ID = 1<<4,
+        DL_PRICE = 1<<5,
+        DL_VOLUME = 1<<6,
+        DL_OPEN_INTEREST = 1<<7
+    };
+
+    enum AuxInfoFlags {
+        AI_TIMESTAMP = 1<<0,
+        AI_ASK_TOTAL = 1<<1,
+        AI_BID_TOTAL = 1<<2,
+        AI_OPEN_INTEREST = 1<<3,
+        AI_PRICE = 1<<4,
+        AI_SESSION_INFO = 1<<5,     // hi limit, lo limit, deposit
+        AI_RATE = 1<<6,
+        AI_MESSAGE = 1<<7
+    };
+
     using Qty = ft::core::Qty;
     using Price = ft::core::Price;
     using ExchangeId = ft::core::ExchangeId;
     
+    /// values previous frames of the stream are relative to
+    struct StreamState {
+        int id {0};
+        std::string instrument;
+        VenueInstrumentId venue_instrument_id {};
+        ft::HundredNanos ts {0};
+        Price price {0};
+        ExchangeId exchange_id {};      // OrdLog order, Deals deal
+        ExchangeId order_id {};         // Deals
+        ExchangeId fill_id {};
+        Price fill_price {0};
+        Qty qty {0};                    // OrdLog amount, Deals volume
+        Qty qty_left {0};               // OrdLog amount left in filled order
+        Qty open_interest {0};
+        Qty ask_total {0};              // AuxInfo
+        Qty bid_total {0};
+        Price high_limit {0};
+        Price low_limit {0};
+        ft::unordered_map<Price, Qty> levels;  // Quotes: ask volume > 0, bid volume < 0
+    };
+
     struct State {
         std::string app;
         std::string comment;
         ft::HundredNanos ctime {0};
         int nstreams {0};
         std::size_t cur_stream {0};
-        std::array<std::string, 7> instruments;
-        std::array<int, 7> stream_ids;
         ft::HundredNanos frame_ts {0};
-        ft::HundredNanos ts {0};
-        Price price {0};
-        ExchangeId fill_id {0};
-        Price fill_price {0};
-        Qty open_interest {0};
-        ExchangeId exchange_id;
+        std::vector<StreamState> streams;
     };
 
+    /// upper bound of encoded frame size (with padding for word reads).
+    /// frames which start farther than this from the end of data are decoded without bounds checks
+    static constexpr std::size_t MaxFrameSize = 256;
+    /// upper bound of file header size
+    static constexpr std::size_t MaxHeaderSize = ft::GzipReader::HeadRoom / 2;
 public:
+    explicit QshDecoder(std::size_t gzip_block_size = ft::GzipReader::DefaultBlockSize)
+    : gzip_(gzip_block_size) {}
+
+    /// decode uncompressed bytes in memory, data should outlive decoding
+    void input(const char* data, std::size_t size) {
+        source_ = nullptr;
+        base_offset_ = 0;
+        begin_ = ptr_ = data;
+        end_ = data + size;
+    }
+    /// decode blocks inflated by source while it decompresses the next ones
+    void input(ft::GzipReader& source) {
+        source_ = &source;
+        base_offset_ = 0;
+        begin_ = ptr_ = end_ = nullptr;
+    }
+    /// map file into memory, gzip-compressed file is inflated in background
+    void open(const std::string& path) {
+        file_.open(path);
+        input_any(file_.data(), file_.size());
+    }
+    /// releases mapped file and stops decompression
+    void close() {
+        gzip_.close();
+        file_.close();
+        buffer_.clear();
+        buffer_.shrink_to_fit();
+        input(nullptr, 0);
+    }
+    /// reads whole stream into memory
     void input(std::istream &is) {
-        input_stream_ = &is;
+        buffer_.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+        input_any(buffer_.data(), buffer_.size());
     }
-    auto& input_stream(){ return *input_stream_;}
+    /// uncompressed bytes decoded so far
+    std::size_t offset() const { return base_offset_ + (ptr_ - begin_); }
 
     core::Stream& stream(core::StreamTopic topic) {
         switch(topic) {
             case core::StreamTopic::BestPrice:
                 return ticks();
+            case core::StreamTopic::Statistics:
+                return statistics();
             case core::StreamTopic::Instrument:
                 return instruments();
             default: throw std::logic_error("no such stream");
         }
     }
-    core::Stream::Signal<Tick>& ticks() { return ticks_; }
-    core::Stream::Signal<InstrumentUpdate>& instruments() { return instruments_; }
+    /// order log, quotes deltas and deals
+    core::Stream::Signal<const Tick&>& ticks() { return ticks_; }
+    /// open interest, totals and limits, element field() tells which value it carries
+    core::Stream::Signal<const Tick&>& statistics() { return statistics_; }
+    /// one update for each instrument of file header, invoked by start()
+    core::Stream::Signal<const InstrumentUpdate&>& instruments() { return instruments_; }
     /// decode stream until EOF
     void run();
+    /// reads file header, then frames are decoded by poll()
+    void start();
+    /// decodes up to max_frames frames
+    /// @returns false at the end of input
+    bool poll(std::size_t max_frames);
+
+    /// adds checkpoints to index while decoding, at most one per index interval
+    void index(QshIndex* index) {
+        index_ = index;
+        next_checkpoint_ = index ? ft::HundredNanos{std::numeric_limits<std::int64_t>::min()} : ft::HundredNanos::max();
+    }
+    /// continues decoding from checkpoint, should be called after start()
+    /// @throws std::runtime_error if checkpoint does not match the file
+    void seek(const QshIndex::Entry& checkpoint);
+    /// publishes aggregated book of every Quotes stream as Clear followed by Add per level,
+    /// so consumers of deltas could start after seek() or in the middle of the stream
+    void snapshot(ft::HundredNanos ts);
+    /// serializes everything frames are decoded relative to
+    void save_state(std::string& out) const;
+    void load_state(std::string_view in);
 private:
-    void read_order_log();
+    void input_any(const char* data, std::size_t size) {
+        if(ft::GzipReader::is_gzip(data, size)) {
+            gzip_.open(data, size);
+            input(gzip_);
+        } else {
+            input(data, size);
+        }
+    }
+    void checkpoint();
+    /// fetches next blocks from source until more than size bytes are available
+    /// @returns false at the end of input
+    bool refill(std::size_t size);
+    template<bool CheckedI> void read_frame();
+    template<bool CheckedI> void read_order_log();
+    template<bool CheckedI> void read_quotes();
+    template<bool CheckedI> void read_quote_levels(std::size_t count);
+    template<bool CheckedI> void read_deals();
+    template<bool CheckedI> void read_aux_info();
     void read_header();
-    bool read_frame_header();
+    void emit_instrument(StreamState& st);
+    void emit_open_interest(const StreamState& st);
+    void emit(QshTick& ti, const StreamState& st, core::StreamTopic topic, ft::HundredNanos ts);
+    /// scratch tick with cleared header and first n elements: value-initializing whole packed QshTick
+    /// costs more than decoding of a frame
+    QshTick& new_tick(std::size_t n);
     std::string read_string();
-    std::int64_t read_leb128();
-    std::uint64_t read_uleb128();
-    std::uint64_t read_growing(std::uint64_t previous);
-    std::uint64_t read_relative(std::uint64_t previous);
+    template<bool CheckedI> std::int64_t read_leb128();
+    template<bool CheckedI> std::uint64_t read_uleb128();
+    template<bool CheckedI> std::uint64_t read_growing(std::uint64_t previous);
+    template<bool CheckedI> std::uint64_t read_relative(std::uint64_t previous);
     ft::HundredNanos read_datetime();
-    ft::HundredNanos read_grow_datetime(ft::HundredNanos previous);
-    int read_byte();
-    std::uint16_t read_uint16();
+    template<bool CheckedI> ft::HundredNanos read_grow_datetime(ft::HundredNanos previous);
+    template<bool CheckedI> int read_byte();
+    template<bool CheckedI> std::uint16_t read_uint16();
+    template<bool CheckedI> double read_double();
+    void require(std::size_t size, const char* what) {
+        if(static_cast<std::size_t>(end_ - ptr_) < size)
+            throw std::runtime_error(what);
+    }
+    /// frames longer than MaxFrameSize may continue in the next block
+    void ensure(std::size_t size) {
+        if(source_ && static_cast<std::size_t>(end_ - ptr_) < size)
+            refill(size);
+    }
+    /// frames before it could be decoded without bounds checks
+    const char* safe_end() const { return end_ - std::min<std::size_t>(end_ - ptr_, MaxFrameSize); }
 private:
     State state_;
-    std::istream* input_stream_;
-    core::Stream::Signal<Tick> ticks_;
-    core::Stream::Signal<InstrumentUpdate> instruments_;
+    QshIndex* index_ {};
+    ft::HundredNanos next_checkpoint_ {ft::HundredNanos::max()};
+    const char* begin_ {};
+    const char* ptr_ {};
+    const char* end_ {};
+    std::size_t base_offset_ {0};   // offset of begin_ in uncompressed stream
+    ft::GzipReader* source_ {};
+    ft::GzipReader gzip_;
+    ft::MappedFile file_;
+    std::vector<char> buffer_;
+    QshTick tick_ {};
+    core::Stream::Signal<const Tick&> ticks_;
+    core::Stream::Signal<const Tick&> statistics_;
+    core::Stream::Signal<const InstrumentUpdate&> instruments_;
 };
 
 }
\ No newline at end of file
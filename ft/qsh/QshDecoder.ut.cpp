@@ -0,0 +1,758 @@
+#include "QshDecoder.hpp"
+#include "QshReplay.hpp"
+#include "QshWriter.hpp"
+#include "ft/core/L2Book.hpp"
+#include "ft/utils/Leb128.hpp"
+#include "ft/utils/UnitTest.hpp"
+#include "toolbox/sys/Log.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+#include <zlib.h>
+#include <unistd.h>
+
+using namespace ft;
+using namespace ft::qsh;
+
+namespace {
+
+constexpr std::size_t BENCH = 0;
+
+/// minimal qsh v4 encoder
+struct QshEncoder {
+    std::string buf;
+    std::size_t nstreams {0};
+    std::uint64_t frame_ms {0};
+    // OrdLog
+    std::uint64_t ts_ms {0};
+    std::int64_t id {0};
+    std::int64_t price {0};
+    std::int64_t amount {0};
+    // Quotes
+    std::int64_t quote_price {0};
+    // Deals
+    std::uint64_t deal_ms {0};
+    std::uint64_t deal_id {0};
+    std::int64_t deal_price {0};
+    // AuxInfo
+    std::uint64_t aux_ms {0};
+    std::int64_t aux_price {0};
+    std::int64_t aux_oi {0};
+
+    void byte(int val) { buf.push_back(static_cast<char>(val)); }
+    void u16(std::uint16_t val) { buf.append(reinterpret_cast<const char*>(&val), sizeof(val)); }
+    void i64(std::int64_t val) { buf.append(reinterpret_cast<const char*>(&val), sizeof(val)); }
+    void uleb(std::uint64_t val) { char tmp[leb128::MaxSize]; buf.append(tmp, leb128::write_unsigned(tmp, val)); }
+    void leb(std::int64_t val) { char tmp[leb128::MaxSize]; buf.append(tmp, leb128::write_signed(tmp, val)); }
+    void str(std::string_view val) { uleb(val.size()); buf.append(val); }
+    void growing(std::uint64_t& prev, std::uint64_t val) {
+        std::int64_t delta = val - prev;
+        if(delta>=0 && delta<268435455) {
+            uleb(delta);
+        } else {
+            uleb(268435455);
+            leb(delta);
+        }
+        prev = val;
+    }
+    void header(std::initializer_list<std::pair<int, std::string_view>> streams) {
+        buf.append("QScalp History Data");
+        byte(4);
+        str("test");
+        str("");
+        i64(0);
+        nstreams = streams.size();
+        byte(nstreams);
+        for(auto& [stream_id, symbol]: streams) {
+            byte(stream_id);
+            str(symbol);
+        }
+    }
+    void header(std::string_view symbol) { header({{QshDecoder::OrdLog, symbol}}); }
+    void frame(std::uint64_t ms, int stream_index) {
+        growing(frame_ms, ms);
+        if(nstreams>1)
+            byte(stream_index);
+    }
+    void order(std::uint64_t ms, std::uint16_t plaza, std::int64_t order_id, std::int64_t order_price, std::int64_t qty, int stream_index=0) {
+        frame(ms, stream_index);
+        byte(QshDecoder::OL_TIMESTAMP | QshDecoder::OL_ID | QshDecoder::OL_PRICE | QshDecoder::OL_AMOUNT);
+        u16(plaza);
+        growing(ts_ms, ms);
+        if(plaza & QshDecoder::PLAZA_ADD) {
+            std::uint64_t prev = id;
+            growing(prev, order_id);
+            id = order_id;
+        } else {
+            leb(order_id - id);
+        }
+        leb(order_price - price);
+        price = order_price;
+        leb(qty - amount);
+        amount = qty;
+    }
+    /// volume > 0 for ask, < 0 for bid, 0 removes level
+    void quotes(std::uint64_t ms, int stream_index, const std::vector<std::pair<std::int64_t, std::int64_t>>& levels) {
+        frame(ms, stream_index);
+        leb(levels.size());
+        for(auto& [level_price, volume]: levels) {
+            leb(level_price - quote_price);
+            quote_price = level_price;
+            leb(volume);
+        }
+    }
+    void deal(std::uint64_t ms, int stream_index, int type, std::uint64_t id, std::int64_t price, std::int64_t qty) {
+        frame(ms, stream_index);
+        byte(type | QshDecoder::DL_TIMESTAMP | QshDecoder::DL_ID | QshDecoder::DL_PRICE | QshDecoder::DL_VOLUME);
+        growing(deal_ms, ms);
+        growing(deal_id, id);
+        leb(price - deal_price);
+        deal_price = price;
+        leb(qty);
+    }
+    void aux_info(std::uint64_t ms, int stream_index, std::int64_t price, std::int64_t oi) {
+        frame(ms, stream_index);
+        byte(QshDecoder::AI_TIMESTAMP | QshDecoder::AI_PRICE | QshDecoder::AI_OPEN_INTEREST);
+        growing(aux_ms, ms);
+        leb(price - aux_price);
+        aux_price = price;
+        leb(oi - aux_oi);
+        aux_oi = oi;
+    }
+};
+
+/// gzip member with the whole input
+std::string gzip(std::string_view data) {
+    z_stream zs {};
+    if(deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        throw std::runtime_error("deflateInit2 failed");
+    std::string out(deflateBound(&zs, data.size()), '\0');
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.avail_in = data.size();
+    zs.next_out = reinterpret_cast<Bytef*>(out.data());
+    zs.avail_out = out.size();
+    deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return out;
+}
+
+/// byte-at-a-time std::istream reader of single stream OrdLog file, as QshDecoder was before
+/// decoding from memory: baseline for the benchmark
+struct IstreamOrdLogReader {
+    std::istream& is;
+    core::Stream::Signal<const core::Tick&> ticks;
+    std::uint64_t ts {0};
+    std::int64_t exchange_id {0};
+    std::int64_t price {0};
+    std::int64_t amount {0};
+
+    int byte() {
+        int val = is.get();
+        if(val==EOF)
+            throw std::runtime_error("EOF in read_byte");
+        return val;
+    }
+    std::uint64_t uleb() {
+        std::uint64_t result = 0;
+        int shift = 0;
+        int val;
+        do {
+            val = byte();
+            result |= std::uint64_t(val & 0x7F) << shift;
+            shift += 7;
+        } while(val & 0x80);
+        return result;
+    }
+    std::int64_t leb() {
+        std::uint64_t result = 0;
+        int shift = 0;
+        int val;
+        do {
+            val = byte();
+            result |= std::uint64_t(val & 0x7F) << shift;
+            shift += 7;
+        } while(val & 0x80);
+        if(shift<64 && (val & 0x40))
+            result |= -1ULL << shift;
+        return result;
+    }
+    std::uint64_t growing(std::uint64_t previous) {
+        std::uint64_t delta = uleb();
+        return delta==268435455 ? previous + leb() : previous + delta;
+    }
+    void skip(std::size_t n) { is.ignore(n); }
+
+    void run() {
+        skip(19+1);
+        skip(uleb());   // app
+        skip(uleb());   // comment
+        skip(8);        // ctime
+        int nstreams = byte();
+        for(int i=0; i<nstreams; i++) {
+            byte();
+            skip(uleb());
+        }
+        std::uint64_t frame_ts = 0;
+        while(is.peek()!=EOF) {
+            frame_ts = growing(frame_ts);
+            int flags = byte();
+            std::uint16_t plaza_flags = byte();
+            plaza_flags |= byte() << 8;
+            QshTick ti {};
+            auto& order = ti[0];
+            ti.event(core::Event::Update);
+            order.event((plaza_flags & QshDecoder::PLAZA_ADD) ? core::TickEvent::Add : core::TickEvent::Delete);
+            order.side((plaza_flags & QshDecoder::PLAZA_BUY) ? core::TickSide::Buy : core::TickSide::Sell);
+            ti.resize(1);
+            if(flags & QshDecoder::OL_TIMESTAMP)
+                ts = growing(ts);
+            if(flags & QshDecoder::OL_ID) {
+                if(plaza_flags & QshDecoder::PLAZA_ADD) {
+                    exchange_id = growing(exchange_id);
+                    order.server_id(Identifier(exchange_id));
+                } else {
+                    order.server_id(Identifier(exchange_id + leb()));
+                }
+            }
+            if(flags & QshDecoder::OL_PRICE)
+                price += leb();
+            order.price(price);
+            if(flags & QshDecoder::OL_AMOUNT)
+                amount += leb();
+            order.qty(amount);
+            auto time = to_wall_time(HundredNanos(ts*10000));
+            ti.recv_time(time);
+            ti.send_time(time);
+            ticks.invoke(ti.as_size<1>());
+        }
+    }
+};
+
+} // anonymous
+
+BOOST_AUTO_TEST_SUITE(QshDecoderSuite)
+
+BOOST_AUTO_TEST_CASE(Leb128)
+{
+    std::mt19937_64 gen(42);
+    std::vector<std::int64_t> values {0, 1, -1, 63, 64, -64, -65, 127, 128, 8191, 8192, -8193,
+        std::numeric_limits<std::int64_t>::max(), std::numeric_limits<std::int64_t>::min()};
+    for(int i=0; i<10000; i++)
+        values.push_back(static_cast<std::int64_t>(gen() >> (gen()%64)) * ((gen() & 1) ? 1 : -1));
+    for(auto val: values) {
+        char buf[leb128::MaxSize + leb128::Padding] {};
+        auto n = leb128::write_signed(buf, val);
+        const char* p = buf;
+        BOOST_CHECK_EQUAL(leb128::read_signed(p), val);
+        BOOST_CHECK_EQUAL(p - buf, n);
+        p = buf;
+        BOOST_CHECK_EQUAL(leb128::read_signed_checked(p, buf + n), val);
+
+        std::uint64_t uval = static_cast<std::uint64_t>(val);
+        n = leb128::write_unsigned(buf, uval);
+        p = buf;
+        BOOST_CHECK_EQUAL(leb128::read_unsigned(p), uval);
+        BOOST_CHECK_EQUAL(p - buf, n);
+        p = buf;
+        BOOST_CHECK_EQUAL(leb128::read_unsigned_checked(p, buf + n), uval);
+    }
+    char truncated[] = "\x80\x80";
+    const char* p = truncated;
+    BOOST_CHECK_THROW(leb128::read_unsigned_checked(p, truncated + 2), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(OrdLog)
+{
+    QshEncoder enc;
+    enc.header("Si-3.21");
+    enc.order(1000, QshDecoder::PLAZA_ADD | QshDecoder::PLAZA_BUY, 5, 73000, 10);
+    enc.order(1001, QshDecoder::PLAZA_ADD | QshDecoder::PLAZA_SELL, 6, 73010, 3);
+    enc.order(1500, QshDecoder::PLAZA_CANCEL | QshDecoder::PLAZA_BUY, 5, 73000, 10);
+    enc.order(1600, QshDecoder::PLAZA_MOVE | QshDecoder::PLAZA_SELL, 6, 73010, 3);
+    enc.order(1600, QshDecoder::PLAZA_ADD | QshDecoder::PLAZA_MOVE | QshDecoder::PLAZA_SELL, 7, 73005, 3);
+
+    std::vector<core::Tick> ticks;
+    QshDecoder decoder;
+    decoder.ticks().connect(tb::bind([&](const core::Tick& e) {
+        ticks.push_back(e);
+    }));
+    decoder.input(enc.buf.data(), enc.buf.size());
+    decoder.run();
+
+    BOOST_REQUIRE_EQUAL(ticks.size(), 5);
+    BOOST_CHECK_EQUAL(decoder.offset(), enc.buf.size());
+    BOOST_CHECK(ticks[0][0].event() == core::TickEvent::Add);
+    BOOST_CHECK(ticks[0][0].side() == core::TickSide::Buy);
+    BOOST_CHECK_EQUAL(ticks[0][0].price(), 73000);
+    BOOST_CHECK_EQUAL(ticks[0][0].qty(), 10);
+    BOOST_CHECK_EQUAL(ticks[0][0].server_id().low(), 5);
+    BOOST_CHECK(ticks[1][0].side() == core::TickSide::Sell);
+    BOOST_CHECK_EQUAL(ticks[1][0].price(), 73010);
+    BOOST_CHECK_EQUAL(ticks[1][0].server_id().low(), 6);
+    BOOST_CHECK(ticks[2][0].event() == core::TickEvent::Delete);
+    BOOST_CHECK_EQUAL(ticks[2][0].price(), 73000);
+    BOOST_CHECK_EQUAL(ticks[2][0].server_id().low(), 5);
+    BOOST_CHECK(ticks[2].send_time() > ticks[0].send_time());
+    // move
+    BOOST_CHECK(ticks[3][0].event() == core::TickEvent::Delete);
+    BOOST_CHECK_EQUAL(ticks[3][0].server_id().low(), 6);
+    BOOST_CHECK(ticks[4][0].event() == core::TickEvent::Add);
+    BOOST_CHECK_EQUAL(ticks[4][0].server_id().low(), 7);
+    BOOST_CHECK_EQUAL(ticks[4][0].price(), 73005);
+}
+
+BOOST_AUTO_TEST_CASE(Streams)
+{
+    QshEncoder enc;
+    enc.header({{QshDecoder::Quotes, "Si-3.21"}, {QshDecoder::Deals, "Si-3.21"},
+        {QshDecoder::AuxInfo, "Si-3.21"}, {QshDecoder::OrdLog, "RTS-3.21"}});
+    enc.quotes(1000, 0, {{73010, 5}, {73000, -3}});
+    enc.quotes(1001, 0, {{73010, 0}, {73000, -4}});
+    enc.deal(1002, 1, 1, 7, 73010, 2);
+    enc.aux_info(1003, 2, 73010, 1000);
+    enc.order(1004, QshDecoder::PLAZA_ADD | QshDecoder::PLAZA_SELL, 5, 150000, 1, 3);
+
+    std::vector<std::string> symbols;
+    std::vector<core::VenueInstrumentId> ids;
+    std::vector<QshTick> ticks, stats;
+    QshDecoder decoder;
+    decoder.instruments().connect(tb::bind([&](const core::InstrumentUpdate& u) {
+        symbols.emplace_back(u.symbol());
+        ids.push_back(u.venue_instrument_id());
+    }));
+    decoder.ticks().connect(tb::bind([&](const core::Tick& e) {
+        ticks.push_back(e.as_size<QshTick::capacity()>());
+    }));
+    decoder.statistics().connect(tb::bind([&](const core::Tick& e) {
+        stats.push_back(e.as_size<QshTick::capacity()>());
+    }));
+    decoder.input(enc.buf.data(), enc.buf.size());
+    decoder.run();
+
+    BOOST_REQUIRE_EQUAL(symbols.size(), 2);
+    BOOST_CHECK_EQUAL(symbols[0], "Si-3.21");
+    BOOST_CHECK_EQUAL(symbols[1], "RTS-3.21");
+
+    BOOST_REQUIRE_EQUAL(ticks.size(), 4);
+    // first quotes frame adds both levels
+    BOOST_REQUIRE_EQUAL(ticks[0].size(), 2);
+    BOOST_CHECK(ticks[0].venue_instrument_id() == ids[0]);
+    BOOST_CHECK(ticks[0][0].event() == core::TickEvent::Add);
+    BOOST_CHECK(ticks[0][0].side() == core::TickSide::Sell);
+    BOOST_CHECK_EQUAL(ticks[0][0].price(), 73010);
+    BOOST_CHECK_EQUAL(ticks[0][0].qty(), 5);
+    BOOST_CHECK(ticks[0][1].side() == core::TickSide::Buy);
+    BOOST_CHECK_EQUAL(ticks[0][1].qty(), 3);
+    // second one removes ask and modifies bid
+    BOOST_REQUIRE_EQUAL(ticks[1].size(), 2);
+    BOOST_CHECK(ticks[1][0].event() == core::TickEvent::Delete);
+    BOOST_CHECK(ticks[1][0].side() == core::TickSide::Sell);
+    BOOST_CHECK(ticks[1][1].event() == core::TickEvent::Modify);
+    BOOST_CHECK_EQUAL(ticks[1][1].price(), 73000);
+    BOOST_CHECK_EQUAL(ticks[1][1].qty(), 4);
+    // deal
+    BOOST_CHECK(ticks[2][0].event() == core::TickEvent::Fill);
+    BOOST_CHECK(ticks[2][0].side() == core::TickSide::Buy);
+    BOOST_CHECK_EQUAL(ticks[2][0].price(), 73010);
+    BOOST_CHECK_EQUAL(ticks[2][0].qty(), 2);
+    BOOST_CHECK_EQUAL(ticks[2][0].server_id().low(), 7);
+    // order log of other instrument
+    BOOST_CHECK(ticks[3].venue_instrument_id() == ids[1]);
+    BOOST_CHECK_EQUAL(ticks[3][0].price(), 150000);
+
+    BOOST_REQUIRE_EQUAL(stats.size(), 1);
+    BOOST_CHECK(stats[0].topic() == core::StreamTopic::Statistics);
+    BOOST_REQUIRE_EQUAL(stats[0].size(), 2);
+    BOOST_CHECK(stats[0][0].field() == core::Field::LastPrice);
+    BOOST_CHECK_EQUAL(stats[0][0].price(), 73010);
+    BOOST_CHECK(stats[0][1].field() == core::Field::OpenInterest);
+    BOOST_CHECK_EQUAL(stats[0][1].qty(), 1000);
+}
+
+BOOST_AUTO_TEST_CASE(Truncated)
+{
+    QshEncoder enc;
+    enc.header("Si-3.21");
+    enc.order(1000, QshDecoder::PLAZA_ADD | QshDecoder::PLAZA_BUY, 5, 73000, 10);
+    enc.buf.pop_back();
+    QshDecoder decoder;
+    decoder.input(enc.buf.data(), enc.buf.size());
+    BOOST_CHECK_THROW(decoder.run(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(Gzip)
+{
+    constexpr std::size_t N = 10000;
+    QshEncoder enc;
+    enc.header("Si-3.21");
+    for(std::size_t i=0; i<N; i++)
+        enc.order(1000 + i, QshDecoder::PLAZA_ADD | QshDecoder::PLAZA_BUY, 5 + i, 73000 + i%7, 1 + i%10);
+    auto half = enc.buf.size()/2;
+    // two concatenated members
+    std::string compressed = gzip(std::string_view(enc.buf).substr(0, half)) + gzip(std::string_view(enc.buf).substr(half));
+    BOOST_REQUIRE(GzipReader::is_gzip(compressed.data(), compressed.size()));
+
+    // small blocks make frames span block boundaries
+    for(std::size_t block_size: {std::size_t(1000), std::size_t(1)<<20}) {
+        std::vector<core::Tick> ticks;
+        QshDecoder decoder;
+        decoder.ticks().connect(tb::bind([&](const core::Tick& e) {
+            ticks.push_back(e);
+        }));
+        GzipReader gz(block_size);
+        gz.open(compressed.data(), compressed.size());
+        decoder.input(gz);
+        decoder.run();
+        BOOST_REQUIRE_EQUAL(ticks.size(), N);
+        BOOST_CHECK_EQUAL(decoder.offset(), enc.buf.size());
+        BOOST_CHECK_EQUAL(gz.total_out(), enc.buf.size());
+        BOOST_CHECK_EQUAL(ticks[N-1][0].server_id().low(), 5 + N - 1);
+        BOOST_CHECK_EQUAL(ticks[N-1][0].price(), 73000 + (N-1)%7);
+    }
+
+    GzipReader gz;
+    compressed.resize(compressed.size()/2);
+    gz.open(compressed.data(), compressed.size());
+    QshDecoder decoder;
+    decoder.input(gz);
+    BOOST_CHECK_THROW(decoder.run(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(GzipLargeQuotes)
+{
+    // quotes frame longer than head room of gzip blocks is decoded across several blocks
+    constexpr std::size_t N = 20000;
+    std::vector<std::pair<std::int64_t, std::int64_t>> levels;
+    for(std::size_t i=0; i<N; i++)
+        levels.emplace_back(1000000000 + 1000*i, i<N/2 ? -1000000 - std::int64_t(i) : 1000000 + std::int64_t(i));
+    QshEncoder enc;
+    enc.header({{QshDecoder::Quotes, "Si-3.21"}});
+    enc.quotes(1000, 0, levels);
+    enc.quotes(1001, 0, {{1000000000, 0}});
+    BOOST_REQUIRE_GT(enc.buf.size(), GzipReader::HeadRoom);
+    std::string compressed = gzip(enc.buf);
+
+    std::size_t adds = 0, deletes = 0;
+    core::Price last_price = 0;
+    QshDecoder decoder;
+    decoder.ticks().connect(tb::bind([&](const core::Tick& e) {
+        for(auto& el: e) {
+            adds += el.event()==core::TickEvent::Add;
+            deletes += el.event()==core::TickEvent::Delete;
+            last_price = el.price();
+        }
+    }));
+    GzipReader gz(4096);
+    gz.open(compressed.data(), compressed.size());
+    decoder.input(gz);
+    decoder.run();
+    BOOST_CHECK_EQUAL(adds, N);
+    BOOST_CHECK_EQUAL(deletes, 1);
+    BOOST_CHECK_EQUAL(last_price, 1000000000);
+    BOOST_CHECK_EQUAL(decoder.offset(), enc.buf.size());
+}
+
+BOOST_AUTO_TEST_CASE(Replay)
+{
+    constexpr std::size_t N = 5000, Files = 3;
+    char dir[] = "/tmp/qsh_replay_XXXXXX";
+    BOOST_REQUIRE(::mkdtemp(dir));
+    std::vector<std::string> paths;
+    for(std::size_t k=0; k<Files; k++) {
+        // file k has ticks at 3*i+k ms, so merged stream interleaves files
+        QshEncoder enc;
+        enc.header("Si-3.21");
+        for(std::size_t i=0; i<N; i++)
+            enc.order(1000 + 3*i + k, QshDecoder::PLAZA_ADD | QshDecoder::PLAZA_BUY, k*1000000 + i, 73000, 1);
+        paths.push_back(std::string(dir) + "/" + std::to_string(k) + ".qsh");
+        std::ofstream os(paths.back(), std::ios::binary);
+        os << (k==1 ? gzip(enc.buf) : enc.buf);
+    }
+    BOOST_CHECK_EQUAL(QshReplay::expand(dir).size(), Files);
+
+    QshReplay replay;
+    replay.inputs(paths);
+    replay.workers(2);
+    replay.buffer_size(512);    // much less than file size
+    std::vector<std::int64_t> ids;
+    Timestamp last = Timestamp::min();   // test files have no creation time, ticks are before the epoch
+    bool ordered = true;
+    replay.ticks().connect(tb::bind([&](const core::Tick& e) {
+        ordered = ordered && e.send_time() >= last;
+        last = e.send_time();
+        ids.push_back(e[0].server_id().low());
+    }));
+    replay.run();
+    BOOST_REQUIRE_EQUAL(ids.size(), N*Files);
+    BOOST_CHECK(ordered);
+    std::size_t mismatches = 0;
+    for(std::size_t j=0; j<ids.size(); j++)
+        mismatches += ids[j] != static_cast<std::int64_t>((j%Files)*1000000 + j/Files);
+    BOOST_CHECK_EQUAL(mismatches, 0);
+
+    for(auto& path: paths)
+        std::remove(path.c_str());
+    ::rmdir(dir);
+}
+
+BOOST_AUTO_TEST_CASE(Index)
+{
+    constexpr std::size_t N = 1200;
+    QshEncoder enc;
+    enc.header({{QshDecoder::Quotes, "Si-3.21"}, {QshDecoder::OrdLog, "Si-3.21"}});
+    for(std::size_t i=0; i<N; i++) {
+        // one frame of each stream per second, 20 minutes
+        enc.quotes(i*1000, 0, {{std::int64_t(73000 + i%5), std::int64_t(1 + i%3)}, {std::int64_t(72990 - i%5), -std::int64_t(1 + i%4)}});
+        enc.order(i*1000 + 1, QshDecoder::PLAZA_ADD | QshDecoder::PLAZA_BUY, 100 + i, 72990 - i%7, 1 + i%9, 1);
+    }
+    auto record = [](std::vector<QshTick>& out) {
+        return tb::bind([&out](const core::Tick& e) { out.push_back(e.as_size<QshTick::capacity()>()); });
+    };
+    auto same = [](const QshTick& a, const QshTick& b) {
+        if(a.size()!=b.size() || a.send_time()!=b.send_time())
+            return false;
+        for(std::size_t i=0; i<a.size(); i++) {
+            if(a[i].event()!=b[i].event() || a[i].price()!=b[i].price() || a[i].qty()!=b[i].qty()
+                || a[i].side()!=b[i].side() || !(a[i].server_id()==b[i].server_id()))
+                return false;
+        }
+        return true;
+    };
+
+    QshIndex index;
+    index.interval(std::chrono::duration_cast<HundredNanos>(std::chrono::minutes(1)));
+    std::vector<QshTick> all;
+    {
+        QshDecoder decoder;
+        decoder.ticks().connect(record(all));
+        decoder.input(enc.buf.data(), enc.buf.size());
+        decoder.index(&index);
+        decoder.run();
+    }
+    BOOST_REQUIRE_EQUAL(all.size(), 2*N);
+    BOOST_CHECK_GE(index.size(), 19);
+    BOOST_CHECK_LE(index.size(), 21);
+
+    char path[] = "/tmp/qsh_index_XXXXXX";
+    int fd = ::mkstemp(path);
+    BOOST_REQUIRE(fd>=0);
+    ::close(fd);
+    index.save(QshIndex::path_for(path), path);
+    QshIndex loaded;
+    BOOST_REQUIRE(loaded.load(QshIndex::path_for(path), path));
+    BOOST_CHECK_EQUAL(loaded.size(), index.size());
+    std::remove(QshIndex::path_for(path).c_str());
+    std::remove(path);
+
+    // seek to 10.5 minutes and compare with full decoding
+    auto time = std::chrono::duration_cast<HundredNanos>(std::chrono::milliseconds(630500));
+    auto* checkpoint = loaded.find(time);
+    BOOST_REQUIRE(checkpoint);
+    BOOST_CHECK(checkpoint->time <= time);
+    std::vector<QshTick> part;
+    QshDecoder decoder;
+    decoder.ticks().connect(record(part));
+    decoder.input(enc.buf.data(), enc.buf.size());
+    decoder.start();
+    decoder.seek(*checkpoint);
+    while(decoder.poll(100));
+    BOOST_REQUIRE_GT(part.size(), 0);
+    BOOST_REQUIRE_LT(part.size(), all.size());
+    std::size_t skipped = all.size() - part.size();
+    std::size_t mismatches = 0;
+    for(std::size_t i=0; i<part.size(); i++)
+        mismatches += !same(part[i], all[skipped + i]);
+    BOOST_CHECK_EQUAL(mismatches, 0);
+    BOOST_CHECK(all[skipped].send_time() <= to_wall_time(time));
+}
+
+BOOST_AUTO_TEST_CASE(Snapshot)
+{
+    constexpr std::size_t N = 1200;
+    QshEncoder enc;
+    enc.header({{QshDecoder::Quotes, "Si-3.21"}});
+    std::mt19937_64 gen(1);
+    for(std::size_t i=0; i<N; i++) {
+        // level is added, changed or removed every second, bids below asks
+        std::int64_t level = gen()%10;
+        std::int64_t volume = gen()%4==0 ? 0 : std::int64_t(1 + gen()%5);
+        enc.quotes(i*1000, 0, {{73000 + level, level<5 ? -volume : volume}});
+    }
+    char path[] = "/tmp/qsh_snapshot_XXXXXX";
+    int fd = ::mkstemp(path);
+    BOOST_REQUIRE(fd>=0);
+    ::close(fd);
+    {
+        std::ofstream os(path, std::ios::binary);
+        os << enc.buf;
+    }
+    auto levels = [](const core::L2Book& book, core::TickSide side) {
+        std::vector<std::pair<Price, Qty>> out;
+        for(auto& l: book.levels(side))
+            out.emplace_back(l.price, l.qty);
+        return out;
+    };
+    auto replay = [&](bool use_index, Timestamp start, core::L2Book& book) {
+        QshReplay replay;
+        replay.inputs({path});
+        replay.use_index(use_index);
+        replay.window(start, Timestamp::max());
+        std::size_t count = 0;
+        bool first_clear = false;
+        replay.ticks().connect(tb::bind([&](const core::Tick& e) {
+            if(count++==0)
+                first_clear = e[0].event()==core::TickEvent::Clear;
+            for(auto& el: e)
+                book.update(el);
+        }));
+        replay.run();
+        BOOST_CHECK(start==Timestamp::min() || first_clear);
+        return count;
+    };
+    core::L2Book full;
+    auto total = replay(true, Timestamp::min(), full);     // builds index
+    BOOST_REQUIRE(!full.empty());
+
+    // window starts in the middle: levels before it are replayed as snapshot
+    auto start = to_wall_time(std::chrono::duration_cast<HundredNanos>(std::chrono::milliseconds(630500)));
+    for(bool use_index: {true, false}) {
+        core::L2Book part;
+        auto count = replay(use_index, start, part);
+        BOOST_CHECK_LT(count, total);
+        BOOST_CHECK(levels(part, core::TickSide::Buy)==levels(full, core::TickSide::Buy));
+        BOOST_CHECK(levels(part, core::TickSide::Sell)==levels(full, core::TickSide::Sell));
+    }
+    std::remove(QshIndex::path_for(path).c_str());
+    std::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(Writer)
+{
+    char path[] = "/tmp/qsh_writer_XXXXXX";
+    int fd = ::mkstemp(path);
+    BOOST_REQUIRE(fd>=0);
+    ::close(fd);
+    std::string gz_path = std::string(path) + ".qsh.gz";
+    auto t0 = parse_time("2021-03-01 10:00:00");
+    auto ms = [&](std::int64_t val) { return t0 + std::chrono::milliseconds(val); };
+    {
+        QshWriter writer;
+        auto quotes = writer.add_stream(QshDecoder::Quotes, "Si-3.21");
+        auto deals = writer.add_stream(QshDecoder::Deals, "Si-3.21");
+        auto ordlog = writer.add_stream(QshDecoder::OrdLog, "RTS-3.21");
+        writer.open(gz_path, t0);
+        std::pair<core::Price, core::Qty> levels1[] = {{73000, -3}, {73010, 5}};
+        writer.quotes(quotes, ms(1), levels1, 2);
+        std::pair<core::Price, core::Qty> levels2[] = {{73000, -4}, {73010, 0}};
+        writer.quotes(quotes, ms(2), levels2, 2);
+        writer.deal(deals, ms(3), core::TickSide::Sell, Identifier(7), 73000, 2);
+        writer.deal(deals, ms(3), core::TickSide::Sell, Identifier(8), 73000, 2);
+        writer.order(ordlog, ms(4), QshDecoder::PLAZA_ADD | QshDecoder::PLAZA_BUY, Identifier(100), 150000, 3);
+        writer.order(ordlog, ms(5), QshDecoder::PLAZA_FILL | QshDecoder::PLAZA_BUY, Identifier(100), 150000, 1, 150000, 2, Identifier(900));
+        writer.order(ordlog, ms(6), QshDecoder::PLAZA_CANCEL | QshDecoder::PLAZA_BUY, Identifier(100), 150000, 2);
+        // same amount is not written, decoder keeps previous one
+        writer.order(ordlog, ms(7), QshDecoder::PLAZA_ADD | QshDecoder::PLAZA_SELL, Identifier(101), 150010, 2);
+        writer.flush();
+        writer.order(ordlog, ms(-1000), QshDecoder::PLAZA_ADD | QshDecoder::PLAZA_SELL, Identifier(50), 149000, 1);
+    }
+    std::vector<QshTick> ticks;
+    QshDecoder decoder;
+    decoder.ticks().connect(tb::bind([&](const core::Tick& e) {
+        ticks.push_back(e.as_size<QshTick::capacity()>());
+    }));
+    decoder.open(gz_path);
+    decoder.run();
+    decoder.close();
+    std::remove(gz_path.c_str());
+    std::remove(path);
+
+    BOOST_REQUIRE_EQUAL(ticks.size(), 9);
+    BOOST_CHECK(ticks[0].send_time() == ms(1));
+    BOOST_REQUIRE_EQUAL(ticks[0].size(), 2);
+    BOOST_CHECK(ticks[0][0].side() == core::TickSide::Buy);
+    BOOST_CHECK_EQUAL(ticks[0][0].qty(), 3);
+    BOOST_CHECK(ticks[1][1].event() == core::TickEvent::Delete);
+    BOOST_CHECK_EQUAL(ticks[1][1].price(), 73010);
+    BOOST_CHECK_EQUAL(ticks[3][0].server_id().low(), 8);
+    BOOST_CHECK_EQUAL(ticks[3][0].qty(), 2);
+    BOOST_CHECK(ticks[3].send_time() == ms(3));
+    BOOST_CHECK(ticks[4][0].event() == core::TickEvent::Add);
+    BOOST_CHECK_EQUAL(ticks[4][0].server_id().low(), 100);
+    BOOST_CHECK_EQUAL(ticks[4][0].qty(), 3);
+    BOOST_REQUIRE_EQUAL(ticks[5].size(), 2);
+    BOOST_CHECK(ticks[5][0].event() == core::TickEvent::Fill);
+    BOOST_CHECK_EQUAL(ticks[5][0].qty(), 1);
+    BOOST_CHECK_EQUAL(ticks[5][1].price(), 150000);
+    BOOST_CHECK_EQUAL(ticks[5][1].qty(), 2);     // amount left
+    BOOST_CHECK_EQUAL(ticks[5][1].server_id().low(), 900);
+    BOOST_CHECK(ticks[6][0].event() == core::TickEvent::Delete);
+    BOOST_CHECK_EQUAL(ticks[6][0].server_id().low(), 100);
+    BOOST_CHECK_EQUAL(ticks[6][0].qty(), 2);
+    BOOST_CHECK_EQUAL(ticks[7][0].server_id().low(), 101);
+    BOOST_CHECK_EQUAL(ticks[7][0].qty(), 2);
+    // time going backwards is escaped
+    BOOST_CHECK(ticks[8].send_time() == ms(-1000));
+    BOOST_CHECK_EQUAL(ticks[8][0].server_id().low(), 50);
+    BOOST_CHECK_EQUAL(ticks[8][0].price(), 149000);
+    BOOST_CHECK_EQUAL(ticks[8][0].qty(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(Benchmark)
+{
+    constexpr std::size_t N = BENCH ? 1000000 : 1000;
+    QshEncoder enc;
+    enc.header("Si-3.21");
+    std::mt19937_64 gen(1);
+    std::int64_t id = 1000000;
+    for(std::size_t i=0; i<N; i++) {
+        bool add = (i%3)!=2;
+        std::uint16_t side = (gen() & 1) ? QshDecoder::PLAZA_BUY : QshDecoder::PLAZA_SELL;
+        enc.order(1000 + i/10, (add ? QshDecoder::PLAZA_ADD : QshDecoder::PLAZA_CANCEL) | side,
+            add ? ++id : id - gen()%100, 73000 + gen()%200 - 100, 1 + gen()%50);
+    }
+    std::size_t count = 0;
+    QshDecoder decoder;
+    decoder.ticks().connect(tb::bind([&](const core::Tick& e) { count++; }));
+    auto decode = [&] {
+        decoder.input(enc.buf.data(), enc.buf.size());
+        decoder.run();
+    };
+    std::size_t baseline_count = 0, baseline_runs = 0;
+    auto decode_istream = [&] {
+        baseline_runs++;
+        std::istringstream is(enc.buf);
+        IstreamOrdLogReader reader{is};
+        reader.ticks.connect(tb::bind([&](const core::Tick& e) { baseline_count++; }));
+        reader.run();
+    };
+    std::size_t runs = 0;
+    maybe_bench("qsh_ordlog_istream", BENCH, decode_istream);
+    maybe_bench("qsh_ordlog", BENCH, [&] {
+        decode();
+        runs++;
+    });
+    BOOST_CHECK_EQUAL(count, N*runs);
+    BOOST_CHECK_EQUAL(baseline_count, N*baseline_runs);
+    if(BENCH) {
+        // same run, same input: goal is at least 5x of istream baseline
+        constexpr int Repeat = 10;
+        auto elapsed = [&](auto&& fn) {
+            auto start = tb::MonoClock::now();
+            for(int i=0; i<Repeat; i++)
+                fn();
+            return std::chrono::duration<double>(tb::MonoClock::now() - start).count();
+        };
+        double istream_s = elapsed(decode_istream);
+        double span_s = elapsed(decode);
+        TOOLBOX_INFO << "qsh_ordlog: "<<N<<" frames, "<<enc.buf.size()<<" bytes per iteration"
+            <<", istream: "<<N*Repeat/istream_s<<" frames/s, span: "<<N*Repeat/span_s<<" frames/s"
+            <<", speedup: "<<istream_s/span_s<<"x";
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,135 @@
+#pragma once
+#include "ft/utils/TimeUtils.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include <sys/stat.h>
+
+namespace ft::qsh {
+
+/// Sidecar time index of qsh file.
+/// Each checkpoint stores uncompressed offset of frame and full decoder state before it,
+/// so decoding could start from the checkpoint instead of the beginning of the file.
+class QshIndex {
+    static constexpr std::string_view Magic {"QSHIDX2\0", 8};
+public:
+    struct Entry {
+        HundredNanos time {0};      // frame time of last frame before offset
+        std::uint64_t offset {0};   // uncompressed offset of next frame
+        std::string state;          // QshDecoder::save_state()
+    };
+    static constexpr HundredNanos DefaultInterval = std::chrono::duration_cast<HundredNanos>(std::chrono::minutes(1));
+
+    static std::string path_for(const std::string& qsh_path) { return qsh_path + ".idx"; }
+
+    HundredNanos interval() const { return interval_; }
+    void interval(HundredNanos val) { interval_ = val; }
+
+    bool empty() const { return entries_.empty(); }
+    std::size_t size() const { return entries_.size(); }
+    const std::vector<Entry>& entries() const { return entries_; }
+    void clear() { entries_.clear(); }
+
+    /// entries should be added in time order
+    void add(Entry entry) { entries_.push_back(std::move(entry)); }
+
+    /// @returns latest checkpoint at or before time, nullptr if there is none
+    const Entry* find(HundredNanos time) const {
+        auto it = std::upper_bound(entries_.begin(), entries_.end(), time,
+            [](HundredNanos t, const Entry& e) { return t < e.time; });
+        return it==entries_.begin() ? nullptr : &*(it-1);
+    }
+
+    /// @returns false if index is missing or was built for other version of source file
+    bool load(const std::string& path, const std::string& source_path) {
+        entries_.clear();
+        std::ifstream is(path, std::ios::binary);
+        if(!is)
+            return false;
+        std::string magic(Magic.size(), '\0');
+        is.read(magic.data(), magic.size());
+        Source src {};
+        if(magic!=Magic || !read(is, src) || src!=source(source_path))
+            return false;
+        std::int64_t interval;
+        std::uint64_t count;
+        if(!read(is, interval) || !read(is, count))
+            return false;
+        interval_ = HundredNanos(interval);
+        for(std::uint64_t i=0; i<count; i++) {
+            Entry e;
+            std::int64_t time;
+            std::uint32_t state_size;
+            if(!read(is, time) || !read(is, e.offset) || !read(is, state_size))
+                break;
+            e.time = HundredNanos(time);
+            e.state.resize(state_size);
+            if(!is.read(e.state.data(), state_size))
+                break;
+            entries_.push_back(std::move(e));
+        }
+        if(entries_.size()!=count) {
+            entries_.clear();
+            return false;
+        }
+        return true;
+    }
+
+    /// @throws std::system_error
+    void save(const std::string& path, const std::string& source_path) const {
+        auto tmp = path + ".tmp";
+        {
+            std::ofstream os(tmp, std::ios::binary | std::ios::trunc);
+            if(!os)
+                throw std::system_error(errno, std::generic_category(), "open "+tmp);
+            os.write(Magic.data(), Magic.size());
+            write(os, source(source_path));
+            write(os, static_cast<std::int64_t>(interval_.count()));
+            write(os, static_cast<std::uint64_t>(entries_.size()));
+            for(auto& e: entries_) {
+                write(os, static_cast<std::int64_t>(e.time.count()));
+                write(os, e.offset);
+                write(os, static_cast<std::uint32_t>(e.state.size()));
+                os.write(e.state.data(), e.state.size());
+            }
+            if(!os)
+                throw std::system_error(errno, std::generic_category(), "write "+tmp);
+        }
+        // readers never see partially written index
+        if(std::rename(tmp.c_str(), path.c_str())!=0)
+            throw std::system_error(errno, std::generic_category(), "rename "+tmp);
+    }
+private:
+    /// identifies version of source file
+    struct Source {
+        std::uint64_t size {0};
+        std::int64_t mtime {0};
+        bool operator!=(const Source& rhs) const { return size!=rhs.size || mtime!=rhs.mtime; }
+    };
+    static Source source(const std::string& path) {
+        struct stat st;
+        if(::stat(path.c_str(), &st)!=0)
+            return {};
+        return {static_cast<std::uint64_t>(st.st_size), st.st_mtim.tv_sec*1000000000ll + st.st_mtim.tv_nsec};
+    }
+    template<typename T>
+    static bool read(std::istream& is, T& val) {
+        return static_cast<bool>(is.read(reinterpret_cast<char*>(&val), sizeof(val)));
+    }
+    template<typename T>
+    static void write(std::ostream& os, const T& val) {
+        os.write(reinterpret_cast<const char*>(&val), sizeof(val));
+    }
+private:
+    std::vector<Entry> entries_;
+    HundredNanos interval_ {DefaultInterval};
+};
+
+} // ft::qsh
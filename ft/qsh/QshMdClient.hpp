@@ -3,10 +3,15 @@
 #include "ft/core/Parameters.hpp"
 #include "ft/core/StreamStats.hpp"
 #include "ft/utils/Common.hpp"
-#include "QshDecoder.hpp"
+#include "QshReplay.hpp"
 #include "ft/io/Service.hpp"
 #include "ft/core/Client.hpp"
+#include "ft/core/BookAnalytics.hpp"
+#include "ft/matching/OrderLogBook.hpp"
+#include <memory>
 #include <ostream>
+#include <stdexcept>
+#include <string>
 #include <string_view>
 
 namespace ft::qsh {
@@ -22,20 +27,60 @@ class QshMdClient:  public io::BasicService<QshMdClient, io::Service>, public io
     using Base::state;
     using Base::open, Base::close;
 
+    /// "analytics": { "source": "Quotes" or "OrdLog", "levels": N }
+    ///   publishes book features on Statistics stream, computed from Quotes levels
+    ///   or from books rebuilt out of order log
+    void on_parameters_updated(const core::Parameters& params) {
+        replay_.configure(params);
+        if(params.find("analytics")!=params.end())
+            analytics(params["analytics"]);
+        Base::on_parameters_updated(params);
+    }
+
     void do_open() { run(); }
 
-    /// read input file
+    /// replay input files merged by exchange time, gzip-compressed files are inflated on the fly
     void run() {
-        std::ifstream ifs(url_);
-        decoder_.input(ifs);
-        decoder_.run();
+        TOOLBOX_INFO<<"qsh replay start: "<<replay_.inputs().size()<<" files";
+        replay_.run();
+        TOOLBOX_INFO<<"qsh replay done: "<<replay_.inputs().size()<<" files";
     }
-    core::StreamStats& stats() { return decoder_.ticks().stats(); }
+    core::StreamStats& stats() { return replay_.ticks().stats(); }
     
-    core::Stream& signal(core::StreamTopic topic) { return decoder_.stream(topic); }
+    core::Stream& signal(core::StreamTopic topic) { return replay_.stream(topic); }
+private:
+    void analytics(const core::Parameters& params) {
+        std::string_view source = params.find("source")!=params.end() ? params.strv("source") : "Quotes";
+        if(source!="Quotes" && source!="OrdLog")
+            throw std::invalid_argument("qsh: unsupported analytics source "+std::string(source));
+        if(!analytics_)
+            replay_.ticks().connect(tb::bind<&QshMdClient::on_tick>(this));
+        analytics_ = std::make_unique<core::BookAnalytics>(params.value_or("levels", 5));
+        analytics_->statistics().connect(tb::bind<&QshMdClient::on_statistics>(this));
+        ordlog_.reset();
+        if(source=="OrdLog") {
+            ordlog_ = std::make_unique<matching::OrderLogBook>();
+            ordlog_->levels().connect(tb::bind<&QshMdClient::on_levels>(this));
+        }
+        TOOLBOX_INFO << "qsh analytics source:"<<source<<", levels:"<<analytics_->levels();
+    }
+    /// Quotes levels have no order id, Deals are ignored by both stages
+    void on_tick(const core::Tick& tick) {
+        if(ordlog_)
+            ordlog_->on_tick(tick);
+        else if(!tick.empty() && tick[0].server_id().empty())
+            analytics_->update(tick);
+    }
+    void on_levels(const core::Tick& tick) {
+        analytics_->update(tick);
+    }
+    void on_statistics(const core::Tick& tick) {
+        replay_.statistics().invoke(tick);
+    }
 private:
-    QshDecoder decoder_;
-    std::string url_;
+    QshReplay replay_;
+    std::unique_ptr<core::BookAnalytics> analytics_;
+    std::unique_ptr<matching::OrderLogBook> ordlog_;
 };
 
 } // ns
\ No newline at end of file
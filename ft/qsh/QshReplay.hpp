@@ -0,0 +1,336 @@
+#pragma once
+#include "ft/core/Parameters.hpp"
+#include "ft/utils/SpscQueue.hpp"
+#include "QshDecoder.hpp"
+#include "toolbox/sys/Log.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glob.h>
+#include <sys/stat.h>
+
+namespace ft::qsh {
+
+/// Replays many qsh files (e.g. one OrdLog per ticker per day) as single stream.
+/// Files are decoded by pool of worker threads into bounded per-file queues,
+/// calling thread merges queue heads by exchange timestamp into ticks().
+class QshReplay {
+    /// state of single file
+    struct Input {
+        Input(std::string path, std::size_t capacity, std::size_t gzip_block_size, const QshReplay& replay)
+        : path(std::move(path))
+        , decoder(gzip_block_size)
+        , queue(capacity)
+        , start(replay.start_)
+        , end(replay.end_) {
+            decoder.ticks().connect(tb::bind<&Input::on_tick>(this));
+            decoder.statistics().connect(tb::bind<&Input::on_tick>(this));
+            decoder.instruments().connect(tb::bind<&Input::on_instrument>(this));
+        }
+        /// decoder invokes ticks which are QshTick underneath
+        void on_tick(const core::Tick& e) {
+            if(e.send_time() < start) {
+                skipped = true;
+                return;     // decoded from checkpoint before the window
+            }
+            if(e.send_time() > end) {
+                past_end = true;
+                return;
+            }
+            if(skipped) {
+                // deltas of Quotes are meaningless without levels restored before the window
+                skipped = false;    // snapshot comes back through on_tick
+                decoder.snapshot(from_wall_time(e.send_time()));
+            }
+            staging.push_back(e.as_size<QshTick::capacity()>());
+        }
+        void on_instrument(const core::InstrumentUpdate& u) {
+            instruments.emplace_back(reinterpret_cast<const char*>(&u), u.ft_hdr.ft_len);
+        }
+
+        /// moves decoded ticks into queue while there is room
+        /// @returns number of ticks moved
+        std::size_t flush() {
+            std::size_t n = 0;
+            while(n < staging.size() && queue.try_push(staging[n]))
+                n++;
+            staging.erase(staging.begin(), staging.begin() + n);
+            return n;
+        }
+
+        std::string path;
+        QshDecoder decoder;
+        SpscQueue<QshTick> queue;
+        std::vector<QshTick> staging;       // decoded, not yet queued
+        std::vector<std::string> instruments;   // header instruments, published before first tick
+        bool announced {false};             // instruments were published by merging thread
+        Timestamp start;
+        Timestamp end;
+        QshIndex index;
+        bool build_index {false};
+        bool started {false};
+        bool skipped {false};               // ticks before the window were not replayed
+        bool past_end {false};
+        bool eof {false};
+        std::string error;                  // read by merging thread after done
+        std::atomic<bool> busy {false};     // owned by worker
+        std::atomic<bool> done {false};     // everything decoded is queued
+    };
+public:
+    static constexpr std::size_t DefaultBufferSize = 2048;        // ticks per file
+    static constexpr std::size_t DefaultBatchSize = 256;          // frames decoded at once
+    static constexpr std::size_t DefaultGzipBlockSize = 256*1024;  // per file
+
+    /// "inputs": [file, directory or glob], "workers", "buffer", "batch", "gzip_block",
+    /// "start", "end": UTC time window, "index": seek by sidecar index, build it on first full read,
+    /// "index_interval_s"
+    void configure(const core::Parameters& params) {
+        std::vector<std::string> patterns;
+        params["inputs"].copy(patterns);
+        paths_.clear();
+        for(auto& pattern: patterns) {
+            auto paths = expand(pattern);
+            if(paths.empty())
+                TOOLBOX_WARNING << "qsh: no files match "<<pattern;
+            paths_.insert(paths_.end(), paths.begin(), paths.end());
+        }
+        workers(params.value_or("workers", std::thread::hardware_concurrency()));
+        batch_size_ = params.value_or("batch", DefaultBatchSize);
+        buffer_size(params.value_or("buffer", DefaultBufferSize));
+        gzip_block_size_ = params.value_or("gzip_block", DefaultGzipBlockSize);
+        auto start = params.find("start")!=params.end() ? parse_time(params.strv("start")) : Timestamp::min();
+        auto end = params.find("end")!=params.end() ? parse_time(params.strv("end")) : Timestamp::max();
+        window(start, end);
+        use_index_ = params.value_or("index", false);
+        index_interval_ = std::chrono::seconds(params.value_or("index_interval_s", 60));
+    }
+
+    /// only ticks within [start, end] are replayed, Quotes books at start are replayed as snapshot
+    void window(Timestamp start, Timestamp end) {
+        start_ = start;
+        end_ = end;
+    }
+    void use_index(bool val) { use_index_ = val; }
+
+    void inputs(std::vector<std::string> paths) { paths_ = std::move(paths); }
+    const std::vector<std::string>& inputs() const { return paths_; }
+    void workers(std::size_t val) { workers_ = std::max<std::size_t>(val, 1); }
+    void buffer_size(std::size_t val) {
+        buffer_size_ = val;
+        batch_size_ = std::min(batch_size_, buffer_size_);
+    }
+
+    /// directory expands to qsh files in it, pattern is expanded by glob(3)
+    static std::vector<std::string> expand(const std::string& pattern) {
+        struct stat st;
+        std::string glob_pattern = pattern;
+        if(::stat(pattern.c_str(), &st)==0) {
+            if(!S_ISDIR(st.st_mode))
+                return {pattern};
+            glob_pattern = pattern + "/*.qsh*";
+        }
+        std::vector<std::string> result;
+        glob_t gl {};
+        if(::glob(glob_pattern.c_str(), 0, nullptr, &gl)==0) {
+            for(std::size_t i=0; i<gl.gl_pathc; i++)
+                result.emplace_back(gl.gl_pathv[i]);   // sorted by glob
+        }
+        ::globfree(&gl);
+        return result;
+    }
+
+    core::Stream& stream(core::StreamTopic topic) {
+        switch(topic) {
+            case core::StreamTopic::BestPrice:
+                return ticks();
+            case core::StreamTopic::Statistics:
+                return statistics();
+            case core::StreamTopic::Instrument:
+                return instruments();
+            default: throw std::logic_error("no such stream");
+        }
+    }
+    core::Stream::Signal<const Tick&>& ticks() { return ticks_; }
+    core::Stream::Signal<const Tick&>& statistics() { return statistics_; }
+    core::Stream::Signal<const InstrumentUpdate&>& instruments() { return instruments_; }
+
+    /// decodes all inputs, invokes ticks() in timestamp order from calling thread
+    /// @throws std::runtime_error if any input could not be decoded
+    void run() {
+        inputs_.clear();
+        for(auto& path: paths_)
+            inputs_.emplace_back(std::make_unique<Input>(path, buffer_size_, gzip_block_size_, *this));
+        stop_ = false;
+        std::vector<std::thread> threads;
+        auto nthreads = std::min<std::size_t>(workers_, inputs_.size());
+        for(std::size_t i=0; i<nthreads; i++)
+            threads.emplace_back([this] { work(); });
+        try {
+            merge();
+        } catch(...) {
+            stop(threads);
+            throw;
+        }
+        stop(threads);
+        for(auto& in: inputs_) {
+            if(!in->error.empty())
+                throw std::runtime_error("qsh: "+in->path+": "+in->error);
+        }
+    }
+private:
+    void stop(std::vector<std::thread>& threads) {
+        stop_ = true;
+        work_cond_.notify_all();
+        for(auto& t: threads)
+            t.join();
+    }
+
+    /// worker thread: decodes batch from any input which is not full and not held by other worker
+    void work() {
+        while(!stop_.load(std::memory_order_relaxed)) {
+            bool progress = false;
+            for(auto& in: inputs_) {
+                if(in->done.load(std::memory_order_acquire) || in->busy.exchange(true, std::memory_order_acquire))
+                    continue;
+                progress |= pump(*in);
+                in->busy.store(false, std::memory_order_release);
+            }
+            if(progress) {
+                data_cond_.notify_one();
+            } else {
+                std::unique_lock<std::mutex> lock(mutex_);
+                work_cond_.wait_for(lock, std::chrono::milliseconds(1));
+            }
+        }
+    }
+
+    /// @returns true if any ticks were queued
+    bool pump(Input& in) {
+        std::size_t moved = in.flush();
+        try {
+            if(in.staging.empty() && !in.eof && in.queue.free() >= batch_size_) {
+                if(!in.started) {
+                    in.started = true;
+                    open(in);
+                }
+                bool more = in.decoder.poll(batch_size_);
+                moved += in.flush();
+                if(!more && in.build_index)
+                    save_index(in);
+                in.eof = !more || (in.past_end && !in.build_index);   // index is built from the whole file
+            }
+        } catch(std::exception& e) {
+            in.error = e.what();
+            in.staging.clear();
+            in.eof = true;
+        }
+        if(in.eof && in.staging.empty()) {
+            in.decoder.close();
+            in.done.store(true, std::memory_order_release);
+            return true;
+        }
+        return moved>0;
+    }
+
+    void open(Input& in) {
+        in.decoder.open(in.path);
+        if(use_index_) {
+            if(!in.index.load(QshIndex::path_for(in.path), in.path)) {
+                in.index.clear();
+                in.index.interval(index_interval_);
+                in.decoder.index(&in.index);
+                in.build_index = true;
+            }
+        }
+        in.decoder.start();
+        if(!in.build_index && start_!=Timestamp::min()) {
+            if(auto* checkpoint = in.index.find(from_wall_time(start_))) {
+                in.decoder.seek(*checkpoint);
+                in.skipped = true;
+            }
+        }
+    }
+
+    /// index is saved only when the whole file was decoded
+    void save_index(Input& in) {
+        try {
+            in.index.save(QshIndex::path_for(in.path), in.path);
+        } catch(std::exception& e) {
+            TOOLBOX_WARNING << "qsh: could not save index of "<<in.path<<": "<<e.what();
+        }
+    }
+
+    /// calling thread: k-way merge of queue heads by exchange timestamp
+    void merge() {
+        using Head = std::pair<std::int64_t, std::size_t>; // send time, input index
+        std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heap;
+        // next tick of every live input should be known before the earliest one is emitted
+        auto fetch = [&](std::size_t index) {
+            auto& in = *inputs_[index];
+            bool more = wait(in);
+            if(!in.announced) {
+                // header is decoded before any tick is queued
+                in.announced = true;
+                for(auto& u: in.instruments)
+                    instruments_.invoke(*reinterpret_cast<const core::InstrumentUpdate*>(u.data()));
+            }
+            if(!more)
+                return;
+            heap.emplace(in.queue.front().send_time().time_since_epoch().count(), index);
+        };
+        for(std::size_t i=0; i<inputs_.size(); i++)
+            fetch(i);
+        while(!heap.empty()) {
+            auto index = heap.top().second;
+            heap.pop();
+            auto& in = *inputs_[index];
+            auto& ti = in.queue.front();
+            auto& signal = ti.topic()==core::StreamTopic::Statistics ? statistics_ : ticks_;
+            signal.stats().on_received();
+            signal.invoke(ti.as_size<1>());
+            in.queue.pop();
+            if(in.queue.free() == batch_size_)
+                work_cond_.notify_one();    // room for next batch
+            fetch(index);
+        }
+    }
+
+    /// @returns false if input is exhausted
+    bool wait(Input& in) {
+        while(in.queue.empty()) {
+            if(in.done.load(std::memory_order_acquire))
+                return !in.queue.empty();   // ticks are queued before done is set
+            std::unique_lock<std::mutex> lock(mutex_);
+            data_cond_.wait_for(lock, std::chrono::microseconds(100));
+        }
+        return true;
+    }
+private:
+    std::vector<std::string> paths_;
+    std::vector<std::unique_ptr<Input>> inputs_;
+    std::size_t workers_ {1};
+    std::size_t buffer_size_ {DefaultBufferSize};
+    std::size_t batch_size_ {DefaultBatchSize};
+    std::size_t gzip_block_size_ {DefaultGzipBlockSize};
+    Timestamp start_ {Timestamp::min()};
+    Timestamp end_ {Timestamp::max()};
+    bool use_index_ {false};
+    ft::HundredNanos index_interval_ {QshIndex::DefaultInterval};
+    std::atomic<bool> stop_ {false};
+    std::mutex mutex_;
+    std::condition_variable work_cond_;
+    std::condition_variable data_cond_;
+    core::Stream::Signal<const Tick&> ticks_;
+    core::Stream::Signal<const Tick&> statistics_;
+    core::Stream::Signal<const InstrumentUpdate&> instruments_;
+};
+
+} // ft::qsh
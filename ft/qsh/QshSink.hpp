@@ -0,0 +1,242 @@
+#pragma once
+#include "ft/core/InstrumentsCache.hpp"
+#include "ft/core/Serializer.hpp"
+#include "ft/core/Tick.hpp"
+#include "ft/io/Sink.hpp"
+#include "ft/utils/TimeUtils.hpp"
+#include "QshWriter.hpp"
+#include "toolbox/sys/Log.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <sys/stat.h>
+
+namespace ft::qsh {
+
+/// Records ticks into qsh files, one file per instrument and day:
+/// <sink>/<symbol>.<YYYY-MM-DD>.<streams>.qsh[.gz]
+/// "sink": directory, "streams": ["Quotes", "Deals"] (default) or ["OrdLog"],
+/// "levels": 1 if feed publishes best prices only so Modify replaces the level of its side,
+/// "gzip": compress files (default)
+template<class ValueT, class SerializerT=FlatSerializer<core::Field>>
+class QshSink : public io::BasicSink<QshSink<ValueT, SerializerT>, ValueT, SerializerT> {
+    using Base = io::BasicSink<QshSink<ValueT, SerializerT>, ValueT, SerializerT>;
+    using Price = core::Price;
+    using Qty = core::Qty;
+    static constexpr std::size_t NoStream = std::size_t(-1);
+
+    struct File {
+        QshWriter writer;
+        int day {-1};           // days since epoch the file was opened for
+        std::size_t quotes {NoStream};
+        std::size_t deals {NoStream};
+        std::size_t ordlog {NoStream};
+        ft::unordered_map<Price, Qty> levels;      // ask volume > 0, bid volume < 0
+        Price best[2] {};                          // last price of the side in best price mode
+        bool has_best[2] {};
+    };
+public:
+    using typename Base::Type;
+    using Base::Base;
+    using Base::path, Base::serializer, Base::flush;
+
+    void configure(const core::Parameters& params) {
+        Base::configure(params);
+        streams_.clear();
+        if(params.find("streams")!=params.end()) {
+            std::vector<std::string> names;
+            params["streams"].copy(names);
+            for(auto& name: names) {
+                if(name=="Quotes") streams_.push_back(QshDecoder::Quotes);
+                else if(name=="Deals") streams_.push_back(QshDecoder::Deals);
+                else if(name=="OrdLog") streams_.push_back(QshDecoder::OrdLog);
+                else throw std::invalid_argument("qsh: unsupported stream "+name);
+            }
+        } else {
+            streams_ = {QshDecoder::Quotes, QshDecoder::Deals};
+        }
+        best_only_ = params.value_or("levels", 0) == 1;
+        gzip_ = params.value_or("gzip", true);
+    }
+
+    void open() {
+        if(::mkdir(path().c_str(), 0755)!=0 && errno!=EEXIST)
+            throw std::system_error(errno, std::generic_category(), "qsh: mkdir "+path());
+    }
+
+    void close() {
+        for(auto it = files_.begin(); it!=files_.end(); ++it)
+            it->second->writer.close();
+        files_.clear();
+    }
+
+    void do_flush() {
+        for(auto it = files_.begin(); it!=files_.end(); ++it)
+            it->second->writer.flush();
+    }
+
+    void write(const Type& ticks) {
+        auto& f = file(ticks.venue_instrument_id(), ticks.send_time());
+        auto time = ticks.send_time();
+        if(f.ordlog!=NoStream) {
+            for(std::size_t i=0; i<ticks.size(); i++)
+                write_order(f, time, ticks[i], i+1==ticks.size());
+        }
+        if(f.quotes!=NoStream) {
+            changes_.clear();
+            for(std::size_t i=0; i<ticks.size(); i++) {
+                if(ticks[i].event()!=core::TickEvent::Fill)
+                    update_level(f, ticks[i]);
+            }
+            if(!changes_.empty()) {
+                std::stable_sort(changes_.begin(), changes_.end(),
+                    [](auto& lhs, auto& rhs) { return lhs.first < rhs.first; });
+                f.writer.quotes(f.quotes, time, changes_.data(), changes_.size());
+            }
+        }
+        if(f.deals!=NoStream) {
+            for(std::size_t i=0; i<ticks.size(); i++) {
+                auto& e = ticks[i];
+                if(e.event()==core::TickEvent::Fill)
+                    f.writer.deal(f.deals, time, e.side(), e.server_id(), e.price(), e.qty());
+            }
+        }
+        flush();
+    }
+private:
+    /// opens file on first tick of the instrument and again when the day changes
+    File& file(core::VenueInstrumentId id, Timestamp time) {
+        auto it = files_.find(id);
+        if(it==files_.end())
+            it = files_.emplace(id, std::make_unique<File>()).first;
+        int day = std::chrono::duration_cast<std::chrono::hours>(time.time_since_epoch()).count() / 24;
+        if(it->second->day!=day) {
+            if(it->second->day>=0) {
+                it->second->writer.close();
+                it->second = std::make_unique<File>();
+            }
+            auto& f = *it->second;
+            f.day = day;
+            std::string symbol(serializer().instruments() ? serializer().instruments()->symbol(id) : std::string_view{});
+            if(symbol.empty())
+                symbol = std::to_string(id.low());
+            std::replace(symbol.begin(), symbol.end(), '/', '_');
+            std::string names;
+            for(auto stream: streams_) {
+                auto index = f.writer.add_stream(stream, symbol);
+                switch(stream) {
+                    case QshDecoder::Quotes: f.quotes = index; names += ".Quotes"; break;
+                    case QshDecoder::Deals: f.deals = index; names += ".Deals"; break;
+                    case QshDecoder::OrdLog: f.ordlog = index; names += ".OrdLog"; break;
+                    default: break;
+                }
+            }
+            f.writer.open(file_path(symbol, names, time), time);
+            TOOLBOX_INFO << "qsh: recording "<<f.writer.path();
+        }
+        return *it->second;
+    }
+
+    /// existing file of the same day is not overwritten
+    std::string file_path(const std::string& symbol, const std::string& names, Timestamp time) const {
+        std::time_t t = std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+        std::tm tm {};
+        ::gmtime_r(&t, &tm);
+        char date[32];
+        std::strftime(date, sizeof(date), "%Y-%m-%d", &tm);
+        std::string prefix = path() + "/" + symbol + "." + date;
+        std::string suffix = names + (gzip_ ? ".qsh.gz" : ".qsh");
+        std::string result = prefix + suffix;
+        struct stat st;
+        if(::stat(result.c_str(), &st)==0) {
+            std::strftime(date, sizeof(date), "%H%M%S", &tm);
+            result = prefix + "." + date + suffix;
+        }
+        return result;
+    }
+
+    void write_order(File& f, Timestamp time, const core::TickElement& e, bool last) {
+        std::uint16_t side = e.side()==core::TickSide::Buy ? QshDecoder::PLAZA_BUY
+            : e.side()==core::TickSide::Sell ? QshDecoder::PLAZA_SELL : 0;
+        if(last)
+            side |= QshDecoder::PLAZA_END_OF_TX;
+        switch(e.event()) {
+            case core::TickEvent::Add:
+                f.writer.order(f.ordlog, time, side|QshDecoder::PLAZA_ADD, e.server_id(), e.price(), e.qty());
+                break;
+            case core::TickEvent::Modify:
+                // order log has no in-place modification, order is replaced under the same id
+                f.writer.order(f.ordlog, time, (side & ~QshDecoder::PLAZA_END_OF_TX)|QshDecoder::PLAZA_CANCEL, e.server_id(), e.price(), 0);
+                f.writer.order(f.ordlog, time, side|QshDecoder::PLAZA_ADD, e.server_id(), e.price(), e.qty());
+                break;
+            case core::TickEvent::Delete:
+                f.writer.order(f.ordlog, time, side|QshDecoder::PLAZA_CANCEL, e.server_id(), e.price(), e.qty());
+                break;
+            case core::TickEvent::Fill:
+                f.writer.order(f.ordlog, time, side|QshDecoder::PLAZA_FILL, e.server_id(), e.price(), e.qty(), e.price());
+                break;
+            default:
+                break;
+        }
+    }
+
+    /// applies element to aggregated book, changed levels are collected into changes_
+    void update_level(File& f, const core::TickElement& e) {
+        Qty sign = e.side()==core::TickSide::Sell ? 1 : -1;
+        int s = e.side()==core::TickSide::Sell ? 1 : 0;
+        switch(e.event()) {
+            case core::TickEvent::Add:
+            case core::TickEvent::Modify:
+                if(best_only_ && f.has_best[s] && f.best[s]!=e.price())
+                    set_level(f, f.best[s], 0);
+                set_level(f, e.price(), sign*e.qty());
+                f.best[s] = e.price();
+                f.has_best[s] = e.qty()!=0;
+                break;
+            case core::TickEvent::Delete:
+                set_level(f, e.price(), 0);
+                if(f.best[s]==e.price())
+                    f.has_best[s] = false;
+                break;
+            case core::TickEvent::Clear: {
+                std::vector<Price> prices;
+                for(auto it = f.levels.begin(); it!=f.levels.end(); ++it) {
+                    if(e.side()==core::TickSide::Empty || (it->second>0)==(sign>0))
+                        prices.push_back(it->first);
+                }
+                for(auto price: prices)
+                    set_level(f, price, 0);
+                if(e.side()==core::TickSide::Empty)
+                    f.has_best[0] = f.has_best[1] = false;
+                else
+                    f.has_best[s] = false;
+            } break;
+            default:
+                break;
+        }
+    }
+
+    void set_level(File& f, Price price, Qty volume) {
+        auto it = f.levels.find(price);
+        Qty prev = it!=f.levels.end() ? it->second : 0;
+        if(prev==volume)
+            return;
+        if(volume==0)
+            f.levels.erase(it);
+        else
+            f.levels[price] = volume;
+        changes_.emplace_back(price, volume);
+    }
+private:
+    std::vector<QshDecoder::Stream> streams_ {QshDecoder::Quotes, QshDecoder::Deals};
+    bool best_only_ {false};
+    bool gzip_ {true};
+    ft::unordered_map<core::VenueInstrumentId, std::unique_ptr<File>> files_;
+    std::vector<std::pair<Price, Qty>> changes_;
+};
+
+} // ft::qsh
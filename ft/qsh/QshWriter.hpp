@@ -0,0 +1,273 @@
+#pragma once
+#include "ft/core/Tick.hpp"
+#include "ft/utils/Leb128.hpp"
+#include "ft/utils/TimeUtils.hpp"
+#include "QshDecoder.hpp"
+#include "toolbox/sys/Log.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include <zlib.h>
+
+namespace ft::qsh {
+
+/// Encodes qsh version 4 files, the inverse of QshDecoder.
+/// Every frame is delta encoded relative to the previous frame of the same stream.
+/// Files with ".gz" suffix are gzip-compressed and could be read back by QshDecoder directly.
+class QshWriter {
+public:
+    using Stream = QshDecoder::Stream;
+    using Qty = ft::core::Qty;
+    using Price = ft::core::Price;
+    using ExchangeId = ft::core::ExchangeId;
+private:
+    /// values previous frames of the stream are relative to, as the decoder sees them
+    struct StreamState {
+        int id {0};
+        std::string instrument;
+        ft::HundredNanos ts {0};
+        Price price {0};
+        std::uint64_t exchange_id {0};
+        std::uint64_t fill_id {0};
+        Price fill_price {0};
+        Qty qty {0};            // OrdLog amount, Deals volume
+        Qty qty_left {0};
+    };
+    /// escape of growing value, signed delta follows
+    static constexpr std::uint64_t GrowingEscape = 268435455;
+public:
+    /// encoded frames are handed to zlib in chunks of this size
+    static constexpr std::size_t BufferSize = 64*1024;
+
+    QshWriter() = default;
+    QshWriter(const QshWriter&) = delete;
+    QshWriter& operator=(const QshWriter&) = delete;
+    ~QshWriter() {
+        try {
+            close();
+        } catch(std::exception& e) {
+            TOOLBOX_ERROR << "qsh: "<<path_<<": "<<e.what();
+        }
+    }
+
+    /// streams should be added before open()
+    /// @returns stream index frames are written to
+    std::size_t add_stream(Stream id, std::string instrument) {
+        if(is_open())
+            throw std::logic_error("qsh: stream added after header was written");
+        streams_.push_back(StreamState{id, std::move(instrument)});
+        return streams_.size()-1;
+    }
+    std::size_t streams() const { return streams_.size(); }
+
+    /// creates file and writes header
+    /// @throws std::system_error
+    void open(const std::string& path, Timestamp ctime, std::string_view app = "freeticks", std::string_view comment = {}) {
+        close();
+        bool gzip = path.size()>3 && path.compare(path.size()-3, 3, ".gz")==0;
+        out_ = ::gzopen(path.c_str(), gzip ? "wb6" : "wbT");     // T: written as is
+        if(!out_)
+            throw std::system_error(errno, std::generic_category(), "qsh: open "+path);
+        ::gzbuffer(out_, BufferSize);
+        path_ = path;
+        buf_.clear();
+        constexpr std::string_view signature = "QScalp History Data";
+        buf_.append(signature);
+        put_byte(4);
+        put_string(app);
+        put_string(comment);
+        frame_ts_ = from_wall_time(ctime);
+        auto raw = static_cast<std::uint64_t>(frame_ts_.count());
+        buf_.append(reinterpret_cast<const char*>(&raw), sizeof(raw));
+        put_byte(streams_.size());
+        for(auto& st: streams_) {
+            st = StreamState{st.id, std::move(st.instrument)};
+            put_byte(st.id);
+            if(st.id != Stream::Messages)
+                put_string(st.instrument);
+        }
+        write_buffer();
+    }
+
+    /// flushes and finishes gzip member, streams are kept for the next open()
+    void close() {
+        if(!out_)
+            return;
+        write_buffer();
+        int rc = ::gzclose(out_);
+        out_ = nullptr;
+        if(rc!=Z_OK)
+            throw std::runtime_error("qsh: close "+path_+" failed");
+    }
+
+    bool is_open() const { return out_!=nullptr; }
+    const std::string& path() const { return path_; }
+
+    /// makes complete frames visible to readers of the file being written
+    void flush() {
+        if(!out_)
+            return;
+        write_buffer();
+        if(::gzflush(out_, Z_SYNC_FLUSH)!=Z_OK)
+            throw std::runtime_error("qsh: flush "+path_+" failed");
+    }
+
+    /// OrdLog frame, plaza_flags are QshDecoder::PlazaFlags.
+    /// Fill (PLAZA_FILL) carries its price, qty left in the order and fill id.
+    void order(std::size_t stream, Timestamp time, std::uint16_t plaza_flags, ExchangeId id, Price price, Qty qty,
+        Price fill_price = 0, Qty amount_left = 0, ExchangeId fill_id = {}) {
+        auto& st = frame(stream, time);
+        auto ts = from_wall_time(time);
+        int flags = 0;
+        if(truncate(ts) != st.ts)
+            flags |= QshDecoder::OL_TIMESTAMP;
+        if(id.low() != st.exchange_id)
+            flags |= QshDecoder::OL_ID;
+        if(price != st.price)
+            flags |= QshDecoder::OL_PRICE;
+        if(qty != st.qty)
+            flags |= QshDecoder::OL_AMOUNT;
+        bool fill = plaza_flags & QshDecoder::PLAZA_FILL;
+        if(fill) {
+            if(amount_left != st.qty_left)
+                flags |= QshDecoder::OL_AMOUNT_LEFT;
+            if(fill_id.low() != st.fill_id)
+                flags |= QshDecoder::OL_FILL_ID;
+            if(fill_price != st.fill_price)
+                flags |= QshDecoder::OL_FILL_PRICE;
+        }
+        put_byte(flags);
+        put_uint16(plaza_flags);
+        if(flags & QshDecoder::OL_TIMESTAMP)
+            put_grow_datetime(st.ts, ts);
+        if(flags & QshDecoder::OL_ID) {
+            if(plaza_flags & QshDecoder::PLAZA_ADD)
+                put_growing(st.exchange_id, id.low());
+            else
+                put_leb(static_cast<std::int64_t>(id.low() - st.exchange_id));   // not remembered by decoder
+        }
+        if(flags & QshDecoder::OL_PRICE)
+            put_relative(st.price, price);
+        if(flags & QshDecoder::OL_AMOUNT)
+            put_relative(st.qty, qty);
+        if(flags & QshDecoder::OL_AMOUNT_LEFT)
+            put_relative(st.qty_left, amount_left);
+        if(flags & QshDecoder::OL_FILL_ID)
+            put_growing(st.fill_id, fill_id.low());
+        if(flags & QshDecoder::OL_FILL_PRICE)
+            put_relative(st.fill_price, fill_price);
+        end_frame();
+    }
+
+    /// Quotes frame with changed levels of aggregated book, ask volume > 0, bid volume < 0, removed level 0.
+    /// Levels sorted by price are encoded most compactly.
+    void quotes(std::size_t stream, Timestamp time, const std::pair<Price, Qty>* levels, std::size_t count) {
+        auto& st = frame(stream, time);
+        put_leb(count);
+        for(std::size_t i=0; i<count; i++) {
+            put_relative(st.price, levels[i].first);
+            put_leb(levels[i].second);
+        }
+        end_frame();
+    }
+
+    /// Deals frame, side is aggressor side
+    void deal(std::size_t stream, Timestamp time, core::TickSide side, ExchangeId id, Price price, Qty qty) {
+        auto& st = frame(stream, time);
+        auto ts = from_wall_time(time);
+        int flags = side==core::TickSide::Buy ? 1 : side==core::TickSide::Sell ? 2 : 0;
+        if(truncate(ts) != st.ts)
+            flags |= QshDecoder::DL_TIMESTAMP;
+        if(id.low() != st.exchange_id)
+            flags |= QshDecoder::DL_ID;
+        if(price != st.price)
+            flags |= QshDecoder::DL_PRICE;
+        if(qty != st.qty)
+            flags |= QshDecoder::DL_VOLUME;
+        put_byte(flags);
+        if(flags & QshDecoder::DL_TIMESTAMP)
+            put_grow_datetime(st.ts, ts);
+        if(flags & QshDecoder::DL_ID)
+            put_growing(st.exchange_id, id.low());
+        if(flags & QshDecoder::DL_PRICE)
+            put_relative(st.price, price);
+        if(flags & QshDecoder::DL_VOLUME) {
+            put_leb(qty);
+            st.qty = qty;
+        }
+        end_frame();
+    }
+private:
+    StreamState& frame(std::size_t stream, Timestamp time) {
+        if(!out_)
+            throw std::logic_error("qsh: writer is not open");
+        auto& st = streams_.at(stream);
+        put_grow_datetime(frame_ts_, from_wall_time(time));
+        if(streams_.size()>1)
+            put_byte(stream);
+        return st;
+    }
+    void end_frame() {
+        if(buf_.size() >= BufferSize)
+            write_buffer();
+    }
+    void write_buffer() {
+        if(buf_.empty())
+            return;
+        if(::gzwrite(out_, buf_.data(), buf_.size()) != static_cast<int>(buf_.size()))
+            throw std::runtime_error("qsh: write "+path_+" failed");
+        buf_.clear();
+    }
+
+    /// timestamps are stored with millisecond precision
+    static ft::HundredNanos truncate(ft::HundredNanos ts) { return ft::HundredNanos(ts.count() / 10000 * 10000); }
+
+    void put_byte(int val) { buf_.push_back(static_cast<char>(val)); }
+    void put_uint16(std::uint16_t val) { buf_.append(reinterpret_cast<const char*>(&val), sizeof(val)); }
+    void put_uleb(std::uint64_t val) {
+        char data[leb128::MaxSize];
+        buf_.append(data, leb128::write_unsigned(data, val));
+    }
+    void put_leb(std::int64_t val) {
+        char data[leb128::MaxSize];
+        buf_.append(data, leb128::write_signed(data, val));
+    }
+    void put_string(std::string_view val) {
+        put_uleb(val.size());
+        buf_.append(val);
+    }
+    void put_growing(std::uint64_t& previous, std::uint64_t val) {
+        std::uint64_t delta = val - previous;
+        if(val >= previous && delta < GrowingEscape) {
+            put_uleb(delta);
+        } else {
+            put_uleb(GrowingEscape);
+            put_leb(static_cast<std::int64_t>(delta));
+        }
+        previous = val;
+    }
+    template<typename T>
+    void put_relative(T& previous, T val) {
+        put_leb(static_cast<std::int64_t>(val - previous));
+        previous = val;
+    }
+    void put_grow_datetime(ft::HundredNanos& previous, ft::HundredNanos val) {
+        std::uint64_t ms = previous.count() / 10000;
+        put_growing(ms, val.count() / 10000);
+        previous = ft::HundredNanos(ms * 10000);
+    }
+private:
+    std::vector<StreamState> streams_;
+    ft::HundredNanos frame_ts_ {0};
+    std::string buf_;
+    std::string path_;
+    gzFile out_ {};
+};
+
+} // ft::qsh
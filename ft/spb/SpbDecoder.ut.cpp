@@ -2,8 +2,7 @@
 #include "ft/spb/SpbFrame.hpp"
 #include "ft/utils/Common.hpp"
 
-#include <boost/test/unit_test.hpp>
-#include "toolbox/bm/Suite.hpp"
+#include "ft/utils/UnitTest.hpp"
 #include <iostream>
 
 #include "SpbDecoder.hpp"
@@ -26,22 +25,6 @@ static_assert(OFFSET_OF(Frame, msgid) == 2);
 
 constexpr std::size_t BENCH = 0;
 
-template<typename F, typename...Args>
-void maybe_bench(const char*name, std::size_t N, F fn, Args...args) {
-    if(N>0) {
-        bm::BenchmarkSuite bm(std::cout);
-        bm.run(name, [&](auto &ctx) {
-            while(ctx) {
-                for(auto _:ctx.range(N)) {
-                    fn(std::forward<Args>(args)...);
-                }
-            }
-        });
-    } else {
-        fn(std::forward<Args>(args)...);
-    }
-}
-
 BOOST_AUTO_TEST_CASE(Parser)
 {
     class MyProtocol : public spb::SpbProtocol<IpEndpoint>::template Mixin<MyProtocol> {
@@ -18,6 +18,8 @@
 #include <system_error>
 #include "ft/utils/StringUtils.hpp"
 #include "ft/core/BestPriceCache.hpp"
+#include "ft/io/RateLimiter.hpp"
+#include "ft/io/Fanout.hpp"
 namespace ft::tbricks {
 
 // plugin mixin
@@ -30,7 +32,15 @@ public:
     using Message = tbricks::v1::Message<0>;
     using MessageOut = tbricks::v1::Message<4096>;
     using MessageType = tbricks::v1::MessageType;
+    using MDStatus = tbricks::v1::MDStatus;
     using Sequence = tbricks::v1::Sequence;
+    /// up to jumbo frame, actual datagram size is limited by "mtu" parameter
+    using Batch = tbricks::v1::MessageBatch<9000>;
+    /// keep datagram below typical ethernet MTU
+    static constexpr std::size_t DefaultMtu = 1400;
+    using RateLimiter = io::BasicRateLimiter<VenueInstrumentId>;
+    /// how often conflated updates are sent to rate limited peers
+    static constexpr tb::Duration DrainInterval = tb::Millis(10);
 
     using Base::Base;
     
@@ -59,46 +69,279 @@ public:
         }
     }
 
+    /// "batch": { "mtu": max datagram size, 0 to send each message in own datagram
+    ///          , "deadline_us": flush delay, 0 to flush when current inbound packet is processed }
+    void on_parameters_updated(const core::Parameters& params) {
+        Base::on_parameters_updated(params);
+        if(params.find("batch")!=params.end()) {
+            auto batch_pa = params["batch"];
+            batch_mtu_ = std::min<std::size_t>(batch_pa.value_or("mtu", 0), Batch::capacity());
+            if(params.find("fanout")!=params.end() && batch_mtu_ > io::FanoutMessage::MaxSize)
+                TOOLBOX_WARNING << name()<<": batch mtu:"<<batch_mtu_<<" is above fanout datagram size, fanout batches are limited to "<<io::FanoutMessage::MaxSize;
+            batch_deadline_ = tb::Micros(batch_pa.value_or("deadline_us", 0));
+            TOOLBOX_INFO << name()<<": batch mtu:"<<batch_mtu_<<", deadline:"<<std::chrono::duration_cast<tb::Micros>(batch_deadline_).count()<<"us";
+        }
+        limiters_.clear();  // limiters refer to limits and cache priorities
+        limits_ = {};
+        if(params.find("limits")!=params.end()) {
+            limits_.configure(params["limits"]);
+            TOOLBOX_INFO << name()<<": limits rate:"<<limits_.rate<<"/s, burst:"<<limits_.burst
+                <<", min_interval:"<<std::chrono::duration_cast<tb::Micros>(limits_.min_interval).count()<<"us"
+                <<", critical symbols:"<<limits_.critical.size()<<", consumers:"<<limits_.consumers.size();
+            if(params.find("fanout")!=params.end() && !limits_.consumers.empty())
+                TOOLBOX_WARNING << name()<<": fanout is limited as single consumer, consumer classes apply to unicast peers only";
+        }
+    }
+
+    void open() {
+        Base::open();
+        if(limits_.enabled()) {
+            drain_timer_ = self()->reactor()->timer(tb::MonoClock::now()+DrainInterval, DrainInterval,
+                tb::Priority::Low, tb::bind([this](tb::CyclTime now, tb::Timer& timer) {
+                    drain_limiters();
+            }));
+        }
+    }
+
+    void close() {
+        drain_timer_.cancel();
+        limiters_.clear();
+        batch_timer_.cancel();
+        batch_pending_ = false;
+        batches_.clear();
+        Base::close();
+    }
+
     template<typename ConnT, typename DoneT>
     void async_write_to(ConnT& conn, const core::Tick& ticks, DoneT done) {
-        core::BestPrice& bp = bestprice_cache_.update(ticks);
-
+        core::BestPrice& bp = this->bestprice_cache() 
+            ? (*this->bestprice_cache())[ticks.venue_instrument_id()]  // updated by the owner of shared cache
+            : local_bestprice_.update(ticks);
+        bool full = false;  // send both sides
+        if(limits_.enabled()) {
+            auto id = ticks.venue_instrument_id();
+            auto& lim = limiter(conn);
+            // TB1 subscription request has no field for priority, it is configured per consumer and symbol
+            auto prio = lim.priority(id, [this](VenueInstrumentId id) { return this->instruments_cache()->symbol(id); });
+            if(prio!=io::UpdatePriority::Critical) {
+                if(!lim.admit(id, tb::MonoClock::now())) {
+                    lim.conflate(id);
+                    done(0, {});
+                    return;
+                }
+                full = true;    // other side could be conflated before
+            }
+        }
         MessageOut msg(MessageType::MarketData);
         assert(this->instruments_cache());
         msg.symbol() = this->instruments_cache()->symbol(ticks.venue_instrument_id());
         msg.marketdata().time() = tbricks::v1::Timestamp { ticks.send_time() };
-        for(auto& e: ticks) {
-            switch(e.side()) {
-                case core::TickSide::Buy: {
-                    double price = bp.price_conv().to_double(bp.bid_price());
-                    bool empty = !bp.test(core::Field::BidPrice);
-                    msg.marketdata().bid().value = empty ? NAN:price;
-                    msg.marketdata().bid().empty = empty;
-                } break;
-                case core::TickSide::Sell:
-                    double price = bp.price_conv().to_double(bp.ask_price());
-                    bool empty = !bp.test(core::Field::AskPrice);
-                    msg.marketdata().ask().value = empty ? NAN: price;
-                    msg.marketdata().ask().empty = empty;
-                    break;
+        if(full) {
+            encode_bid(msg, bp);
+            encode_ask(msg, bp);
+        } else {
+            for(auto& e: ticks) {
+                switch(e.side()) {
+                    case core::TickSide::Buy: {
+                        encode_bid(msg, bp);
+                    } break;
+                    case core::TickSide::Sell:
+                        encode_ask(msg, bp);
+                        break;
+                }
+            }
+        }
+        msg.seq() = ++out_seq_;
+        write_message(conn, msg, done);
+    }
+
+    /// sends message immediately or appends it to connection's batch
+    template<typename ConnT, typename DoneT>
+    void write_message(ConnT& conn, const MessageOut& msg, DoneT done) {
+        if(batch_mtu_>0 || has_batch(conn)) {
+            TOOLBOX_DEBUG << name()<<": batch["<<msg.bytesize()<<"]: seq="<<msg.seq()<<"; sym="<<msg.symbol().str();
+            append_batch(conn, msg, batch_deadline_);
+            done(msg.bytesize(), {});
+        } else {
+            auto buf = tb::to_const_buffer(msg);
+            TOOLBOX_INFO << name()<<": out["<<msg.bytesize()<<"]: seq="<<msg.seq()<<"; sym="<<msg.symbol().str()<<"\n" << ft::to_hex_dump(std::string_view{(const char*)buf.data(), buf.size()});
+            conn.async_write(buf, done);
+        }
+    }
+
+    /// sends latest state of conflated instruments to rate limited peers
+    void drain_limiters() {
+        auto now = tb::MonoClock::now();
+        for(auto it = limiters_.begin(); it!=limiters_.end();) {
+            auto& lim = *it->second;
+            if(!it->first) {
+                // fanout is addressed as the peer with empty id
+                auto* fanout = self()->fanout();
+                if(fanout && lim.has_pending()) {
+                    lim.drain(now, [&](VenueInstrumentId id) {
+                        write_latest(*fanout, id);
+                    });
+                }
+            } else if(auto* peer = self()->get_peer(it->first)) {
+                if(lim.has_pending()) {
+                    lim.drain(now, [&](VenueInstrumentId id) {
+                        write_latest(*peer, id);
+                    });
+                }
+            } else {
+                it = limiters_.erase(it);   // peer is gone
+                continue;
             }
+            ++it;
+        }
+    }
+
+    template<typename ConnT>
+    void write_latest(ConnT& conn, VenueInstrumentId id) {
+        const core::BestPrice* bp = this->bestprice_cache() ? this->bestprice_cache()->find(id) : local_bestprice_.find(id);
+        if(!bp)
+            return;
+        MessageOut msg(MessageType::MarketData);
+        msg.symbol() = this->instruments_cache()->symbol(id);
+        msg.marketdata().time() = tbricks::v1::Timestamp { bp->send_time() };
+        encode_bid(msg, *bp);
+        encode_ask(msg, *bp);
+        msg.seq() = ++out_seq_;
+        write_message(conn, msg, tb::bind([](ssize_t size, std::error_code ec) {
+            if(ec)
+                TOOLBOX_ERROR << "TB1: conflated write failed, ec:"<<ec;
+        }));
+    }
+
+    template<typename ConnT>
+    RateLimiter& limiter(ConnT& conn) {
+        auto& ptr = limiters_[conn.id()];
+        if(!ptr) {
+            if constexpr(TB_IS_VALID(conn, conn.remote())) {
+                std::string remote = conn.remote().address().to_string();
+                ptr = std::make_unique<RateLimiter>(limits_, limits_.critical_for(remote));
+                TOOLBOX_INFO << name()<<": peer "<<conn.remote()<<" is rate limited";
+            } else {
+                ptr = std::make_unique<RateLimiter>(limits_, limits_.critical);
+                TOOLBOX_INFO << name()<<": fanout is rate limited";
+            }
+        }
+        return *ptr;
+    }
+
+    /// acknowledge subscription with snapshot of last known best price.
+    /// snapshots are batched per peer and sent when reactor is done with current events.
+    /// Live updates batched for fanout are flushed first, but fanout workers send from their own threads,
+    /// so with fanout an update published just before the snapshot could still reach the peer after it.
+    template<typename ConnT, typename DoneT>
+    void async_write_to(ConnT& conn, const core::StatusResponse& res, DoneT done) {
+        auto* subscribed = find_symbol(conn.id(), res.instrument_id());
+        if(!subscribed) {
+            TOOLBOX_ERROR << name()<<": response for unknown instrument "<<res.instrument_id();
+            done(-1, std::make_error_code(std::errc::invalid_argument));
+            return;
+        }
+        std::string_view symbol = *subscribed;
+        const core::BestPrice* bp = nullptr;
+        if(this->bestprice_cache() && this->instruments_cache()) {
+            if(auto* ins = this->instruments_cache()->find(symbol))
+                bp = this->bestprice_cache()->find(ins->venue_instrument_id());
+        }
+        MessageOut msg(MessageType::MarketData);
+        msg.symbol() = symbol;
+        auto& md = msg.marketdata();
+        md.bid() = {NAN, true};
+        md.ask() = {NAN, true};
+        switch(res.status()) {
+            case core::Status::Ok: {
+                if(bp) {
+                    md.status() = MDStatus::OK;
+                    md.time() = tbricks::v1::Timestamp { bp->send_time() };
+                    encode_bid(msg, *bp);
+                    encode_ask(msg, *bp);
+                } else {
+                    md.status() = MDStatus::Pending;
+                    md.time() = tbricks::v1::Timestamp { tb::WallClock::now() };
+                }
+            } break;
+            case core::Status::Failed:
+                md.status() = MDStatus::Failed;
+                md.time() = tbricks::v1::Timestamp { tb::WallClock::now() };
+                break;
+            default:
+                md.status() = MDStatus::Pending;
+                md.time() = tbricks::v1::Timestamp { tb::WallClock::now() };
         }
         msg.seq() = ++out_seq_;
-        auto buf = tb::to_const_buffer(msg);
-        TOOLBOX_INFO << name()<<": out["<<msg.bytesize()<<"]: seq="<<msg.seq()<<"; sym="<<msg.symbol().str()<<"\n" << ft::to_hex_dump(std::string_view{(const char*)buf.data(), buf.size()});
-        conn.async_write(buf, done);
+        TOOLBOX_INFO << name()<<": snapshot["<<msg.bytesize()<<"]: seq="<<msg.seq()<<"; sym="<<msg.symbol().str()<<"; status="<<(int)tb::unbox(md.status());
+        if(auto* fanout = self()->fanout()) {
+            auto fit = batches_.find(fanout->id());
+            if(fit!=batches_.end())
+                flush_batch(*fanout, fit->second);
+        }
+        append_batch(conn, msg, tb::Duration{});
+        done(msg.bytesize(), {});
+    }
+
+    /// send all pending batches
+    void flush_batches() {
+        batch_pending_ = false;
+        for(auto it = batches_.begin(); it!=batches_.end();) {
+            auto id = it->first;
+            if(!id) {
+                // fanout is addressed as the peer with empty id
+                if(auto* fanout = self()->fanout())
+                    flush_batch(*fanout, it->second);
+                ++it;
+            } else if(auto* peer = self()->get_peer(id)) {
+                flush_batch(*peer, it->second);
+                ++it;
+            } else {
+                it = batches_.erase(it);    // peer is gone
+            }
+        }
+    }
+
+    template<typename ConnT>
+    void flush_batch(ConnT& conn, Batch& batch) {
+        if(batch.empty())
+            return;
+        TOOLBOX_DEBUG << name()<<": flush "<<batch.count()<<" messages, "<<batch.size()<<" bytes to "<<conn.id();
+        conn.async_write(tb::ConstBuffer{batch.data(), batch.size()}, tb::bind([](ssize_t size, std::error_code ec) {
+            if(ec)
+                TOOLBOX_ERROR << "TB1: batch write failed, ec:"<<ec;
+        }));
+        batch.clear();
     }
 
     constexpr std::string_view name() { return "TB1"; }
     
+    /// datagram could contain several messages packed back to back
     template<class ConnT, class PacketT, class DoneT>
     void async_handle(ConnT& conn, const PacketT& e, DoneT done) { 
         std::error_code ec{};
 
         auto& buf = e.buffer();
-        const Message& msg = *reinterpret_cast<const Message*>(buf.data());        
-        TOOLBOX_DEBUG << name()<<": in["<<e.buffer().size()<<"]: t="<<(int64_t)tb::unbox(msg.msgtype())<<"\n"<<
+        TOOLBOX_DEBUG << name()<<": in["<<e.buffer().size()<<"]\n"<<
             ft::to_hex_dump(std::string_view{(const char*)buf.data(), buf.size()});
+        const char* ptr = reinterpret_cast<const char*>(buf.data());
+        const char* end = ptr + buf.size();
+        while(!ec && ptr < end) {
+            const Message& msg = *reinterpret_cast<const Message*>(ptr);
+            if(!msg.is_valid()) {
+                TOOLBOX_ERROR << "TbricksV1: unknown msgtype "<<tb::unbox(msg.msgtype());
+                ec = std::make_error_code(std::errc::invalid_argument);
+                break;
+            }
+            ec = on_message(conn, msg);
+            ptr += msg.bytesize();
+        }
+        done(ec);
+    }
+
+    template<class ConnT>
+    std::error_code on_message(ConnT& conn, const Message& msg) {
+        std::error_code ec{};
         switch(msg.msgtype()) {
             case MessageType::SubscriptionRequest: {
                 TOOLBOX_DEBUG << name()<<": in: t:"<<(int)tb::unbox(msg.msgtype())<<", sym:'"<<msg.symbol().str()<<"', seq:"<<msg.seq();
@@ -109,10 +352,13 @@ public:
                     req.topic(StreamTopic::BestPrice);
                     std::size_t id = std::hash<std::string_view>{}(msg.symbol().str());
                     req.instrument_id(InstrumentId(id));
+                    req.request_id(RequestId(id));
+                    symbols_[conn.id()].emplace(InstrumentId(id), msg.symbol().str());
                     self()->on_subscribe(conn, req);
                 //}
             } break;
             case MessageType::SubscriptionCancelRequest: {
+                unsubscribed(conn, msg.symbol().str());
                 if constexpr(TB_IS_VALID(self(), self()->subscription())) {
                     core::SubscriptionRequest req;
                     req.symbol(msg.symbol().str());
@@ -121,6 +367,7 @@ public:
                 }
             } break;
             case MessageType::ClosingEvent: {
+                unsubscribed(conn, msg.symbol().str());
                 if constexpr(TB_IS_VALID(self(), self()->subscription())) {
                     core::SubscriptionRequest req;
                     req.symbol(msg.symbol().str());
@@ -146,7 +393,10 @@ public:
                 ticks.instrument_id(InstrumentId{id});
                 ticks.venue_instrument_id(VenueInstrumentId{id});
                 ticks.send_time(msg.marketdata().time().to_core_timestamp());
-                ticks.event(core::Event::Update);
+                if(msg.marketdata().status()==MDStatus::OK || msg.marketdata().status()==MDStatus::NotSet)
+                    ticks.event(core::Event::Update);
+                else
+                    break; // subscription acknowledged, no data yet
                 if(!msg.marketdata().bid().empty) {
                     ticks[i] = {};
                     ticks[i].side(TickSide::Buy);
@@ -171,20 +421,113 @@ public:
                 TOOLBOX_ERROR << "TbricksV1: unknown msgtype "<<tb::unbox(msg.msgtype());
                 ec = std::make_error_code(std::errc::invalid_argument);
         }
-        done(ec);
+        return ec;
     }
 
     auto& stats() { return stats_; }
+
+    /// drops everything kept for the peer
+    void on_peer_closed(PeerId id) {
+        symbols_.erase(id);
+        limiters_.erase(id);
+        batches_.erase(id);
+    }
+
+    /// @returns symbol subscribed by peer or nullptr
+    const std::string* find_symbol(PeerId peer, InstrumentId id) const {
+        auto it = symbols_.find(peer);
+        if(it==symbols_.end())
+            return nullptr;
+        auto sit = it->second.find(id);
+        return sit!=it->second.end() ? &sit->second : nullptr;
+    }
+    template<class ConnT>
+    void unsubscribed(ConnT& conn, std::string_view symbol) {
+        auto it = symbols_.find(conn.id());
+        if(it==symbols_.end())
+            return;
+        it->second.erase(InstrumentId(std::hash<std::string_view>{}(symbol)));
+        if(it->second.empty())
+            symbols_.erase(it);
+    }
+
+    template<class ConnT>
+    bool has_batch(ConnT& conn) {
+        auto it = batches_.find(conn.id());
+        return it!=batches_.end() && !it->second.empty();
+    }
+
+    /// fanout workers send datagrams of up to FanoutMessage::MaxSize
+    template<class ConnT>
+    std::size_t batch_limit(ConnT& conn) {
+        std::size_t mtu = batch_mtu_>0 ? batch_mtu_ : DefaultMtu;
+        if constexpr(!TB_IS_VALID(conn, conn.remote()))
+            mtu = std::min(mtu, io::FanoutMessage::MaxSize);
+        return mtu;
+    }
+
+    /// appends message to connection's batch, batch is flushed when full or after deadline
+    template<class ConnT>
+    void append_batch(ConnT& conn, const MessageOut& msg, tb::Duration deadline) {
+        auto& batch = batches_[conn.id()];
+        batch.limit(batch_limit(conn));
+        if(!batch.append(msg)) {
+            flush_batch(conn, batch);
+            if(!batch.append(msg)) {
+                // larger than batch limit, goes in its own datagram
+                TOOLBOX_WARNING << name()<<": message of "<<msg.bytesize()<<" bytes exceeds batch limit "<<batch.limit()<<", sent unbatched";
+                conn.async_write(tb::to_const_buffer(msg), tb::bind([](ssize_t size, std::error_code ec) {
+                    if(ec)
+                        TOOLBOX_ERROR << "TB1: unbatched write failed, ec:"<<ec;
+                }));
+                return;
+            }
+        }
+        if(!batch_pending_) {
+            batch_pending_ = true;
+            batch_timer_ = self()->reactor()->timer(tb::MonoClock::now() + deadline, tb::Priority::Low,
+                tb::bind([this](tb::CyclTime now, tb::Timer& timer) {
+                    flush_batches();
+            }));
+        }
+    }
+
+    template<class BestPriceT>
+    static void encode_bid(MessageOut& msg, const BestPriceT& bp) {
+        double price = bp.price_conv().to_double(bp.bid_price());
+        bool empty = !bp.test(core::Field::BidPrice);
+        msg.marketdata().bid().value = empty ? NAN:price;
+        msg.marketdata().bid().empty = empty;
+    }
+    template<class BestPriceT>
+    static void encode_ask(MessageOut& msg, const BestPriceT& bp) {
+        double price = bp.price_conv().to_double(bp.ask_price());
+        bool empty = !bp.test(core::Field::AskPrice);
+        msg.marketdata().ask().value = empty ? NAN: price;
+        msg.marketdata().ask().empty = empty;
+    }
     
     auto& bestprice() { return bestprice_signal_; }
     auto& instruments() { return instruments_signal_; }
 protected:
-    core::BestPriceCache bestprice_cache_;
+    core::BestPriceCache local_bestprice_;
     // from server to client
     BestPriceSignal bestprice_signal_;
     InstrumentSignal instruments_signal_;
 
     core::StreamStats stats_;
+    // subscribed symbols of each peer by instrument id
+    ft::unordered_map<PeerId, ft::unordered_map<InstrumentId, std::string>> symbols_;
+    // messages pending for each peer
+    ft::unordered_map<PeerId, Batch> batches_;
+    tb::Timer batch_timer_;
+    bool batch_pending_ {false};
+    std::size_t batch_mtu_ {0};
+    tb::Duration batch_deadline_ {};
+    // per-peer outbound limits
+    io::RateLimits limits_;
+    ft::unordered_map<PeerId, std::unique_ptr<RateLimiter>> limiters_;
+    tb::Timer drain_timer_;
     // from client to server 
     Sequence out_seq_ {};
     RequestId  out_req_id_;
@@ -1,6 +1,8 @@
 #pragma once
 #include <boost/type_traits/is_detected.hpp>
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <stdexcept>
 #include "ft/core/Fields.hpp"
 #include "ft/core/Requests.hpp"
@@ -131,7 +133,7 @@ struct Message {
                 return sizeof(msgtype_);
         }
     }
-    bool is_valid() {
+    bool is_valid() const {
         switch(msgtype_) {
             case MessageType::SubscriptionRequest:
             case MessageType::SubscriptionCancelRequest: 
@@ -175,5 +177,44 @@ struct Message {
     }); 
 };
 
+
+/// several messages packed back to back into one datagram
+template<std::size_t CapacityI>
+class MessageBatch {
+public:
+    static constexpr std::size_t capacity() { return CapacityI; }
+
+    /// max datagram size, could be less than capacity
+    std::size_t limit() const { return limit_; }
+    void limit(std::size_t val) { limit_ = std::min(val, CapacityI); }
+
+    /// @returns false if message does not fit into the batch
+    template<std::size_t PadSizeI>
+    bool append(const Message<PadSizeI>& msg) {
+        std::size_t len = msg.bytesize();
+        if(size_ + len > limit_)
+            return false;
+        std::memcpy(data_ + size_, &msg, len);
+        size_ += len;
+        count_++;
+        return true;
+    }
+    void clear() {
+        size_ = 0;
+        count_ = 0;
+    }
+    bool empty() const { return count_==0; }
+    /// number of messages
+    std::size_t count() const { return count_; }
+    /// used bytes
+    std::size_t size() const { return size_; }
+    const char* data() const { return data_; }
+private:
+    std::size_t limit_ {CapacityI};
+    std::size_t size_ {0};
+    std::size_t count_ {0};
+    char data_[CapacityI];
+};
+
 #pragma pack(pop)
 } // tbricks::schema::v1
\ No newline at end of file
@@ -0,0 +1,197 @@
+#pragma once
+#include "ft/utils/MappedFile.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <zlib.h>
+
+namespace ft { inline namespace util {
+
+/// Streaming gzip decompression.
+/// Background thread inflates input into two alternating blocks while the consumer
+/// decodes the other one, so decompression and decoding overlap.
+class GzipReader {
+    struct Block {
+        std::unique_ptr<char[]> data;
+        std::size_t size {0};
+        bool full {false};
+    };
+public:
+    static constexpr std::size_t DefaultBlockSize = 1<<20;
+    /// room in front of each block for the unconsumed tail of previous block
+    static constexpr std::size_t HeadRoom = 64*1024;
+
+    explicit GzipReader(std::size_t block_size = DefaultBlockSize)
+    : block_size_(block_size) {
+        for(auto& b: blocks_)
+            b.data.reset(new char[HeadRoom + block_size_]);
+    }
+    GzipReader(const GzipReader&) = delete;
+    GzipReader& operator=(const GzipReader&) = delete;
+    ~GzipReader() { close(); }
+
+    static bool is_gzip(const char* data, std::size_t size) {
+        return size>=2 && static_cast<std::uint8_t>(data[0])==0x1f && static_cast<std::uint8_t>(data[1])==0x8b;
+    }
+
+    /// map compressed file and start inflating it
+    void open(const std::string& path) {
+        close();
+        file_.open(path);
+        start(file_.data(), file_.size());
+    }
+    /// inflate compressed bytes, data should outlive reading
+    void open(const char* data, std::size_t size) {
+        close();
+        start(data, size);
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cond_.notify_all();
+        if(thread_.joinable())
+            thread_.join();
+        file_.close();
+    }
+
+    /// @returns next decompressed block with tail of previous block copied in front of it,
+    /// or empty view at the end of input (then tail is still valid)
+    /// @throws std::runtime_error on corrupted input
+    std::string_view next(std::string_view tail = {}) {
+        if(tail.size() > HeadRoom)
+            throw std::logic_error("gzip: tail does not fit into head room");
+        std::size_t index = current_<0 ? 0 : (current_ + 1) % 2;
+        Block& block = blocks_[index];
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [&] { return block.full || done_; });
+            if(!error_.empty())
+                throw std::runtime_error(error_);
+            if(!block.full || block.size==0)
+                return {};
+        }
+        char* begin = block.data.get() + HeadRoom - tail.size();
+        if(!tail.empty())
+            std::memcpy(begin, tail.data(), tail.size());
+        if(current_>=0) {
+            // previous block could be refilled now
+            std::lock_guard<std::mutex> lock(mutex_);
+            blocks_[current_].full = false;
+        }
+        cond_.notify_all();
+        current_ = index;
+        return {begin, tail.size() + block.size};
+    }
+
+    /// total decompressed bytes
+    std::size_t total_out() const { return total_out_; }
+private:
+    void start(const char* data, std::size_t size) {
+        stop_ = false;
+        done_ = false;
+        error_.clear();
+        current_ = -1;
+        total_out_ = 0;
+        for(auto& b: blocks_) {
+            b.size = 0;
+            b.full = false;
+        }
+        thread_ = std::thread([this, data, size] { run(data, size); });
+    }
+
+    void run(const char* data, std::size_t size) {
+        z_stream zs {};
+        if(inflateInit2(&zs, 32 + MAX_WBITS) != Z_OK) {     // gzip or zlib header
+            finish("gzip: inflateInit failed");
+            return;
+        }
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        std::size_t left = size;    // input not given to zlib yet, avail_in is 32-bit
+        auto feed = [&] {
+            if(zs.avail_in==0 && left>0) {
+                zs.avail_in = static_cast<uInt>(std::min<std::size_t>(left, std::numeric_limits<uInt>::max()));
+                left -= zs.avail_in;
+            }
+        };
+        std::size_t index = 0;
+        bool eof = false;
+        std::string error;
+        while(!eof) {
+            Block& block = blocks_[index];
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [&] { return !block.full || stop_; });
+                if(stop_)
+                    break;
+            }
+            zs.next_out = reinterpret_cast<Bytef*>(block.data.get() + HeadRoom);
+            zs.avail_out = block_size_;
+            while(zs.avail_out>0) {
+                feed();
+                int rc = inflate(&zs, Z_NO_FLUSH);
+                if(rc==Z_STREAM_END) {
+                    feed();
+                    if(zs.avail_in>0) {
+                        inflateReset(&zs);  // concatenated gzip members
+                        continue;
+                    }
+                    eof = true;
+                    break;
+                }
+                if(rc!=Z_OK) {
+                    error = zs.avail_in==0 ? "gzip: truncated input" : std::string("gzip: ") + (zs.msg ? zs.msg : "inflate failed");
+                    eof = true;
+                    break;
+                }
+            }
+            total_out_ += block_size_ - zs.avail_out;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                block.size = block_size_ - zs.avail_out;
+                block.full = true;
+                if(eof) {
+                    done_ = true;
+                    error_ = error;
+                }
+            }
+            cond_.notify_all();
+            index = (index + 1) % 2;
+        }
+        inflateEnd(&zs);
+        if(!eof)
+            finish({});
+    }
+
+    void finish(std::string error) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = true;
+            error_ = std::move(error);
+        }
+        cond_.notify_all();
+    }
+private:
+    std::size_t block_size_;
+    Block blocks_[2];
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stop_ {false};
+    bool done_ {false};
+    std::string error_;
+    int current_ {-1};   // block owned by consumer
+    std::atomic<std::size_t> total_out_ {0};
+    MappedFile file_;
+};
+
+}} // ft::util
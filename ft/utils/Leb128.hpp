@@ -0,0 +1,160 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+namespace ft { inline namespace util {
+
+/// LEB128 variable length integers
+namespace leb128 {
+
+/// longest encoding of 64-bit value
+constexpr std::size_t MaxSize = 10;
+
+/// bytes which should be readable after the value for unchecked decoding
+constexpr std::size_t Padding = 8;
+
+namespace detail {
+    /// packs low 7 bits of each of n bytes of little-endian word
+    inline std::uint64_t compact7(std::uint64_t word, int n) {
+        std::uint64_t x = word & (n==8 ? ~0ULL : ((1ULL << (8*n)) - 1)) & 0x7f7f7f7f7f7f7f7fULL;
+    #if defined(__BMI2__)
+        return _pext_u64(x, 0x7f7f7f7f7f7f7f7fULL);
+    #else
+        x = ((x & 0x7f007f007f007f00ULL) >> 1) | (x & 0x007f007f007f007fULL);
+        x = ((x & 0x3fff00003fff0000ULL) >> 2) | (x & 0x00003fff00003fffULL);
+        x = ((x & 0x0fffffff00000000ULL) >> 4) | (x & 0x000000000fffffffULL);
+        return x;
+    #endif
+    }
+    inline std::uint64_t load64(const char* p) {
+        std::uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        return word;     // little-endian assumed
+    }
+}
+
+/// reads unsigned value byte by byte, never reads past end
+/// @throws std::runtime_error on truncated value
+inline std::uint64_t read_unsigned_checked(const char*& p, const char* end) {
+    std::uint64_t result = 0;
+    int shift = 0;
+    std::uint8_t byte;
+    do {
+        if(p>=end)
+            throw std::runtime_error("EOF in read_uleb128");
+        byte = static_cast<std::uint8_t>(*p++);
+        if(shift<64)
+            result |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        shift += 7;
+    } while(byte & 0x80);
+    return result;
+}
+
+/// reads signed value byte by byte, never reads past end
+/// @throws std::runtime_error on truncated value
+inline std::int64_t read_signed_checked(const char*& p, const char* end) {
+    std::uint64_t result = 0;
+    int shift = 0;
+    std::uint8_t byte;
+    do {
+        if(p>=end)
+            throw std::runtime_error("EOF in read_leb128");
+        byte = static_cast<std::uint8_t>(*p++);
+        if(shift<64)
+            result |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        shift += 7;
+    } while(byte & 0x80);
+    if(shift<64 && (byte & 0x40))
+        result |= (~0ULL) << shift;
+    return static_cast<std::int64_t>(result);
+}
+
+/// reads unsigned value a word at a time, at least Padding bytes after p should be readable
+inline std::uint64_t read_unsigned(const char*& p) {
+    auto b0 = static_cast<std::uint8_t>(*p);
+    if(!(b0 & 0x80)) {   // most values are small
+        p++;
+        return b0;
+    }
+    std::uint64_t word = detail::load64(p);
+    std::uint64_t stops = ~word & 0x8080808080808080ULL;
+    if(stops) {
+        int n = __builtin_ctzll(stops)/8 + 1;
+        p += n;
+        return detail::compact7(word, n);
+    }
+    // 9 or 10 bytes
+    std::uint64_t result = detail::compact7(word, 8);
+    p += 8;
+    auto b8 = static_cast<std::uint8_t>(*p++);
+    result |= static_cast<std::uint64_t>(b8 & 0x7F) << 56;
+    if(b8 & 0x80) {
+        auto b9 = static_cast<std::uint8_t>(*p++);
+        result |= static_cast<std::uint64_t>(b9 & 0x01) << 63;
+    }
+    return result;
+}
+
+/// reads signed value a word at a time, at least Padding bytes after p should be readable
+inline std::int64_t read_signed(const char*& p) {
+    auto b0 = static_cast<std::uint8_t>(*p);
+    if(!(b0 & 0x80)) {
+        p++;
+        return static_cast<std::int64_t>(static_cast<std::uint64_t>(b0) << 57) >> 57; // sign extend 7 bits
+    }
+    std::uint64_t word = detail::load64(p);
+    std::uint64_t stops = ~word & 0x8080808080808080ULL;
+    if(stops) {
+        int n = __builtin_ctzll(stops)/8 + 1;
+        p += n;
+        int bits = 7*n;
+        return static_cast<std::int64_t>(detail::compact7(word, n) << (64-bits)) >> (64-bits);
+    }
+    std::uint64_t result = detail::compact7(word, 8);
+    p += 8;
+    auto b8 = static_cast<std::uint8_t>(*p++);
+    result |= static_cast<std::uint64_t>(b8 & 0x7F) << 56;
+    if(b8 & 0x80) {
+        auto b9 = static_cast<std::uint8_t>(*p++);
+        result |= static_cast<std::uint64_t>(b9 & 0x01) << 63;
+    } else if(b8 & 0x40) {
+        result |= 1ULL << 63;   // 63 bits + sign
+    }
+    return static_cast<std::int64_t>(result);
+}
+
+/// @returns number of bytes written, out should have MaxSize bytes
+inline std::size_t write_unsigned(char* out, std::uint64_t val) {
+    std::size_t n = 0;
+    do {
+        std::uint8_t byte = val & 0x7F;
+        val >>= 7;
+        if(val)
+            byte |= 0x80;
+        out[n++] = static_cast<char>(byte);
+    } while(val);
+    return n;
+}
+
+/// @returns number of bytes written, out should have MaxSize bytes
+inline std::size_t write_signed(char* out, std::int64_t val) {
+    std::size_t n = 0;
+    bool more = true;
+    while(more) {
+        std::uint8_t byte = val & 0x7F;
+        val >>= 7;  // arithmetic shift
+        if((val==0 && !(byte & 0x40)) || (val==-1 && (byte & 0x40)))
+            more = false;
+        else
+            byte |= 0x80;
+        out[n++] = static_cast<char>(byte);
+    }
+    return n;
+}
+
+} // leb128
+}} // ft::util
@@ -0,0 +1,73 @@
+#pragma once
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ft { inline namespace util {
+
+/// read-only memory mapping of the whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path) { open(path); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& rhs) noexcept { swap(rhs); }
+    MappedFile& operator=(MappedFile&& rhs) noexcept { swap(rhs); return *this; }
+    ~MappedFile() { close(); }
+
+    /// @throws std::system_error
+    void open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd<0)
+            throw std::system_error(errno, std::generic_category(), "open "+path);
+        struct stat st;
+        if(::fstat(fd, &st)<0) {
+            int ec = errno;
+            ::close(fd);
+            throw std::system_error(ec, std::generic_category(), "fstat "+path);
+        }
+        size_ = st.st_size;
+        if(size_>0) {
+            void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(addr==MAP_FAILED) {
+                int ec = errno;
+                ::close(fd);
+                size_ = 0;
+                throw std::system_error(ec, std::generic_category(), "mmap "+path);
+            }
+            data_ = static_cast<const char*>(addr);
+            ::madvise(addr, size_, MADV_SEQUENTIAL);
+        }
+        ::close(fd);    // mapping keeps file referenced
+    }
+
+    void close() {
+        if(data_)
+            ::munmap(const_cast<char*>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    bool is_open() const { return data_!=nullptr; }
+    const char* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    std::string_view view() const { return {data_, size_}; }
+
+    void swap(MappedFile& rhs) noexcept {
+        std::swap(data_, rhs.data_);
+        std::swap(size_, rhs.size_);
+    }
+private:
+    const char* data_ {nullptr};
+    std::size_t size_ {0};
+};
+
+}} // ft::util
@@ -0,0 +1,107 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace ft { inline namespace util {
+
+/// Hierarchical bitset: each bit of upper layer tells whether the 64-bit word below has any bit set,
+/// so the nearest set bit is found with a few ctz/clz per layer regardless of distance.
+class OccupancyBitmap {
+    using Word = std::uint64_t;
+    static constexpr std::size_t WordBits = 64;
+public:
+    static constexpr std::size_t npos = std::size_t(-1);
+
+    OccupancyBitmap() = default;
+    explicit OccupancyBitmap(std::size_t size) { resize(size); }
+
+    /// clears all bits
+    void resize(std::size_t size) {
+        size_ = size;
+        layers_.clear();
+        do {
+            size = (size + WordBits - 1) / WordBits;
+            layers_.emplace_back(size, 0);
+        } while(size > 1);
+    }
+    std::size_t size() const { return size_; }
+
+    bool test(std::size_t i) const {
+        return layers_[0][i / WordBits] & bit(i);
+    }
+    void set(std::size_t i) {
+        for(auto& layer: layers_) {
+            Word& w = layer[i / WordBits];
+            bool was_empty = w==0;
+            w |= bit(i);
+            if(!was_empty)
+                break;
+            i /= WordBits;
+        }
+    }
+    void reset(std::size_t i) {
+        for(auto& layer: layers_) {
+            Word& w = layer[i / WordBits];
+            w &= ~bit(i);
+            if(w!=0)
+                break;
+            i /= WordBits;
+        }
+    }
+    bool any() const { return layers_.back()[0]!=0; }
+
+    /// @returns first set bit >= i or npos
+    std::size_t find_next(std::size_t i) const {
+        if(i >= size_)
+            return npos;
+        std::size_t layer = 0;
+        // go up until the rest of the word has a set bit
+        for(;; layer++) {
+            if(layer==layers_.size())
+                return npos;
+            Word w = layers_[layer][i / WordBits] & (~Word(0) << (i % WordBits));
+            if(w) {
+                i = (i & ~(WordBits - 1)) + __builtin_ctzll(w);
+                break;
+            }
+            i = i / WordBits + 1;
+            if(i >= layers_[layer].size())
+                return npos;
+        }
+        // go down to the lowest set bit
+        while(layer-- > 0)
+            i = i * WordBits + __builtin_ctzll(layers_[layer][i]);
+        return i;
+    }
+
+    /// @returns last set bit <= i or npos
+    std::size_t find_prev(std::size_t i) const {
+        if(i >= size_)
+            i = size_ - 1;
+        if(size_==0)
+            return npos;
+        std::size_t layer = 0;
+        for(;; layer++) {
+            if(layer==layers_.size())
+                return npos;
+            Word w = layers_[layer][i / WordBits] & (~Word(0) >> (WordBits - 1 - i % WordBits));
+            if(w) {
+                i = (i & ~(WordBits - 1)) + (WordBits - 1 - __builtin_clzll(w));
+                break;
+            }
+            if(i < WordBits)
+                return npos;
+            i = i / WordBits - 1;
+        }
+        while(layer-- > 0)
+            i = i * WordBits + (WordBits - 1 - __builtin_clzll(layers_[layer][i]));
+        return i;
+    }
+private:
+    static Word bit(std::size_t i) { return Word(1) << (i % WordBits); }
+private:
+    std::size_t size_ {0};
+    std::vector<std::vector<Word>> layers_;     // layers_[0] are bits themselves
+};
+
+}} // ft::util
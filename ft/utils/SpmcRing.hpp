@@ -0,0 +1,96 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+namespace ft { inline namespace util {
+
+/// Lock-free single producer, multiple consumers broadcast ring.
+/// Every consumer sees every element. Producer never waits: slow consumer which was lapped
+/// detects overrun and skips to the oldest available element.
+/// Each slot is protected by sequence lock, T should be trivially copyable.
+template<typename T, std::size_t CapacityI>
+class SpmcRing {
+    static_assert((CapacityI & (CapacityI-1))==0, "capacity should be power of 2");
+    static_assert(std::is_trivially_copyable_v<T>);
+    static constexpr std::size_t CacheLineSize = 64;
+    static constexpr std::uint64_t Mask = CapacityI - 1;
+
+    struct alignas(CacheLineSize) Slot {
+        std::atomic<std::uint64_t> seq {0};    // odd while writing, 2*(pos+1) when element pos is written
+        T value;
+    };
+public:
+    /// per-consumer read position
+    struct Cursor {
+        std::uint64_t pos {0};
+        std::uint64_t overruns {0};  // number of elements lost due to overrun
+    };
+
+    SpmcRing()
+    : slots_(new Slot[CapacityI]) {}
+
+    SpmcRing(const SpmcRing&) = delete;
+    SpmcRing& operator=(const SpmcRing&) = delete;
+
+    static constexpr std::size_t capacity() { return CapacityI; }
+
+    /// producer only. fn(T&) fills the element in place
+    template<typename FnT>
+    void push(FnT&& fn) {
+        auto pos = head_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[pos & Mask];
+        slot.seq.store(2*pos + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        fn(slot.value);
+        slot.seq.store(2*(pos + 1), std::memory_order_release);
+        head_.store(pos + 1, std::memory_order_release);
+    }
+
+    /// new consumer starts from current head
+    Cursor cursor() const { return Cursor{head_.load(std::memory_order_acquire)}; }
+
+    /// number of elements published so far
+    std::uint64_t head() const { return head_.load(std::memory_order_acquire); }
+
+    /// consumer. copies next element into val
+    /// @returns false if nothing to read
+    bool pop(Cursor& cur, T& val) {
+        for(;;) {
+            const Slot& slot = slots_[cur.pos & Mask];
+            auto expected = 2*(cur.pos + 1);
+            auto seq1 = slot.seq.load(std::memory_order_acquire);
+            if(seq1 == expected) {
+                std::memcpy(&val, &slot.value, sizeof(T));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                auto seq2 = slot.seq.load(std::memory_order_relaxed);
+                if(seq2 == seq1) {
+                    cur.pos++;
+                    return true;
+                }
+            } else if(seq1 < expected && (seq1 & 1)==0) {
+                return false;   // not yet published
+            } else if(seq1 == expected - 1) {
+                return false;   // being published right now
+            }
+            // lapped by producer
+            skip(cur);
+        }
+    }
+private:
+    void skip(Cursor& cur) {
+        auto head = head_.load(std::memory_order_acquire);
+        auto oldest = head > CapacityI/2 ? head - CapacityI/2 : 0; // leave room for producer
+        if(oldest > cur.pos) {
+            cur.overruns += oldest - cur.pos;
+            cur.pos = oldest;
+        }
+    }
+private:
+    std::unique_ptr<Slot[]> slots_;
+    alignas(CacheLineSize) std::atomic<std::uint64_t> head_ {0};
+};
+
+}} // ft::util
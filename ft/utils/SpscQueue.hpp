@@ -0,0 +1,90 @@
+#pragma once
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+
+namespace ft { inline namespace util {
+
+/// Bounded lock-free single producer, single consumer queue.
+/// Capacity is rounded up to power of 2. Producer never overwrites unread elements.
+template<typename T>
+class SpscQueue {
+    static constexpr std::size_t CacheLineSize = 64;
+public:
+    explicit SpscQueue(std::size_t capacity) {
+        std::size_t cap = 1;
+        while(cap < capacity)
+            cap <<= 1;
+        mask_ = cap - 1;
+        data_.reset(new T[cap]);
+    }
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    std::size_t capacity() const { return mask_ + 1; }
+
+    /// producer only
+    /// @returns false if queue is full
+    bool try_push(const T& val) {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        if(tail - head_cache_ > mask_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if(tail - head_cache_ > mask_)
+                return false;
+        }
+        data_[tail & mask_] = val;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// producer only, slot is filled in place and published by commit(), so buffers it owns are reused
+    /// @returns nullptr if queue is full
+    T* try_acquire() {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        if(tail - head_cache_ > mask_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if(tail - head_cache_ > mask_)
+                return nullptr;
+        }
+        return &data_[tail & mask_];
+    }
+    /// producer only, publishes slot returned by try_acquire()
+    void commit() {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /// producer only. free space, could only grow until next push
+    std::size_t free() const {
+        return capacity() - (tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_acquire));
+    }
+
+    /// consumer only
+    bool empty() const {
+        return head_.load(std::memory_order_relaxed) == tail_.load(std::memory_order_acquire);
+    }
+
+    /// consumer only, queue should not be empty
+    T& front() {
+        assert(!empty());
+        return data_[head_.load(std::memory_order_relaxed) & mask_];
+    }
+
+    /// consumer only, queue should not be empty
+    void pop() {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /// approximate number of elements
+    std::size_t size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+private:
+    std::unique_ptr<T[]> data_;
+    std::uint64_t mask_ {0};
+    alignas(CacheLineSize) std::atomic<std::uint64_t> head_ {0};    // consumer position
+    alignas(CacheLineSize) std::atomic<std::uint64_t> tail_ {0};    // producer position
+    std::uint64_t head_cache_ {0};   // producer's copy of head_
+};
+
+}} // ft::util
@@ -2,6 +2,9 @@
 #include <ctime>
 #include <iomanip>
 #include <chrono>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 
 #include "toolbox/sys/Time.hpp"
 
@@ -22,11 +25,40 @@ inline std::string format_time_point(std::chrono::system_clock::time_point ts) {
     return ss.str();
 }
 
+/// .NET DateTime ticks of unix epoch
+constexpr std::int64_t DotNetEpoch = 621355968000000000ll;
+
 inline toolbox::WallTime to_wall_time(HundredNanos value) {
     // https://stackoverflow.com/questions/39459474/convert-c-sharp-datetime-to-c-stdchronosystem-clocktime-point
-    std::int64_t val = (value.count() - 621355968000000000ull);
+    std::int64_t val = (value.count() - DotNetEpoch);
     return toolbox::WallTime(HundredNanos{val});
 }
 
+inline HundredNanos from_wall_time(toolbox::WallTime value) {
+    return std::chrono::duration_cast<HundredNanos>(value.time_since_epoch()) + HundredNanos{DotNetEpoch};
+}
+
+/// parses UTC "YYYY-MM-DD HH:MM:SS[.fraction]", 'T' separator is accepted as well
+/// @throws std::invalid_argument
+inline toolbox::WallTime parse_time(std::string_view s) {
+    std::tm tm {};
+    std::string str(s);
+    for(auto& c: str)
+        if(c=='T') c = ' ';
+    const char* rest = ::strptime(str.c_str(), "%Y-%m-%d %H:%M:%S", &tm);
+    if(!rest)
+        throw std::invalid_argument("invalid time: "+str);
+    std::int64_t nanos = 0;
+    if(*rest=='.') {
+        std::int64_t scale = 100000000;
+        for(rest++; *rest>='0' && *rest<='9'; rest++, scale/=10)
+            nanos += (*rest - '0') * scale;
+    }
+    if(*rest!='\0')
+        throw std::invalid_argument("invalid time: "+str);
+    auto secs = std::chrono::seconds(::timegm(&tm));
+    return toolbox::WallTime(std::chrono::duration_cast<toolbox::WallTime::duration>(secs + std::chrono::nanoseconds(nanos)));
+}
+
 }} // ft::util
 
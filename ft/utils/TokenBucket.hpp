@@ -0,0 +1,52 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <toolbox/sys/Time.hpp>
+
+namespace ft { inline namespace util {
+
+/// Token bucket: refills at rate tokens per second, holds up to burst tokens.
+/// Zero rate means unlimited.
+class TokenBucket {
+public:
+    TokenBucket() = default;
+    TokenBucket(double rate, double burst)
+    : rate_(rate)
+    , burst_(std::max(burst, 1.))
+    , tokens_(burst_) {}
+
+    bool enabled() const { return rate_ > 0; }
+    double rate() const { return rate_; }
+    double burst() const { return burst_; }
+
+    /// takes n tokens if available
+    bool consume(toolbox::sys::MonoTime now, double n = 1.) {
+        if(!enabled())
+            return true;
+        refill(now);
+        if(tokens_ < n)
+            return false;
+        tokens_ -= n;
+        return true;
+    }
+    /// tokens available now
+    double tokens(toolbox::sys::MonoTime now) {
+        refill(now);
+        return tokens_;
+    }
+private:
+    void refill(toolbox::sys::MonoTime now) {
+        if(last_time_ != toolbox::sys::MonoTime{}) {
+            double dt = std::chrono::duration<double>(now - last_time_).count();
+            tokens_ = std::min(burst_, tokens_ + dt * rate_);
+        }
+        last_time_ = now;
+    }
+private:
+    double rate_ {0};
+    double burst_ {1};
+    double tokens_ {1};
+    toolbox::sys::MonoTime last_time_ {};
+};
+
+}} // ft::util
@@ -1,4 +1,27 @@
 #pragma once
 
 #include <boost/test/unit_test.hpp>
-#include "toolbox/bm/Suite.hpp"
\ No newline at end of file
+#include "toolbox/bm/Suite.hpp"
+#include <cstddef>
+#include <iostream>
+
+namespace ft { inline namespace util {
+
+/// Runs fn n times per benchmark iteration, or just once if n is 0,
+/// so the same test case checks results with BENCH = 0 and measures otherwise.
+template<typename FnT>
+void maybe_bench(const char* name, std::size_t n, FnT&& fn) {
+    if(n>0) {
+        toolbox::bm::BenchmarkSuite bm(std::cout);
+        bm.run(name, [&](auto& ctx) {
+            while(ctx) {
+                for(auto _: ctx.range(n))
+                    fn();
+            }
+        });
+    } else {
+        fn();
+    }
+}
+
+}} // ft::util
@@ -358,11 +358,11 @@ class QshFile:
                 self.last_order_price = self.read_relative(self.last_order_price)
 
             if is_available(availability_mask, OrdLogEntry.DataFlag.AMOUNT):
-                self.last_amount = self.read_leb128()
+                self.last_amount = self.read_relative(self.last_amount)
 
             if is_available(actions_mask, OrdLogEntry.ActionFlag.FILL):
                 if is_available(availability_mask, OrdLogEntry.DataFlag.ORDER_AMOUNT_REST):
-                    self.last_order_amount_rest = self.read_leb128()
+                    self.last_order_amount_rest = self.read_relative(self.last_order_amount_rest)
 
                 amount_rest = self.last_order_amount_rest
 